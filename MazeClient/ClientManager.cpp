@@ -1,564 +1,705 @@
-#include <boost/thread/thread.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
-#include "MazeClient.h"
-#include "Utility.h"
-
-
-ClientManager::ClientManager() :
-	terminal_(new OSTerminal()), exiting_(false), state_(CS_INIT), 
-	player_id_(0), client_(nullptr), redraw_(true), win_(false), game_over_display_(false)
-{
-	if (!terminal_->initialize())
-		throw std::runtime_error("ClientManager::ClientManager: [Terminal initialization failed]");
-}
-
-void ClientManager::processMessage(GameMessage & game_msg)
-{
-	game_data_ptr game_data = game_msg.decodeBody();
-	if (!game_data)
-	{
-		std::cerr << "ERROR: ClientManager::processMessage [Message decode failed; code=" << game_msg.getGameCode() << "]" << std::endl;
-		return;
-	}
-
-	switch (state_)
-	{
-	case CS_INIT:
-		{
-			player_id_ptr player_id_data = std::dynamic_pointer_cast<PlayerID>(game_data);
-			if (!player_id_data)
-			{
-				std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-				return;
-			}
-			
-			player_id_ = player_id_data->getPlayerId();
-			state_ = CS_INPUT;
-		}
-		break;
-
-	case CS_INPUT:
-	case CS_WAIT:
-		{
-			game_summary_ptr summary_data = std::dynamic_pointer_cast<GameSummary>(game_data);
-			if (!summary_data)
-			{
-				std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-				return;
-			}
-
-			summary_data_ = *summary_data;
-
-			state_ = CS_INPUT;
-		}
-		break;
-
-	case CS_WAIT_START:
-		{
-			switch (game_msg.getGameCode())
-			{
-			case GameMessage::GC_GAMES_NOTIFY:
-				{
-					game_summary_ptr summary_data = std::dynamic_pointer_cast<GameSummary>(game_data);
-					if (!summary_data)
-					{
-						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-						return;
-					}
-
-					summary_data_ = *summary_data;
-				}
-				break;
-			case GameMessage::GC_SELECT_GAME_RESP:
-				{
-					select_resp_ptr select_resp = std::dynamic_pointer_cast<GameSelectResp>(game_data);
-					if (!select_resp)
-					{
-						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-						return;
-					}
-
-					if (select_resp->getSelectResp() == GameSelectResp::SR_FAIL)
-					{
-						std::cout << std::endl << "Cannot enter maze; currently occupied..." << std::endl;
-						boost::this_thread::sleep(boost::posix_time::millisec(500));
-						state_ = CS_INPUT;
-					}
-					else
-					{
-						std::cout << std::endl << "Waiting for other player..." << std::endl;
-
-						if (!terminal_->setMode(TM_GAME))
-							throw std::runtime_error("ClientManager::processMessage: [Terminal setMode failed]");
-					}
-				}
-				break;
-			case GameMessage::GC_START_NOTIFY:
-				{
-					world_map_ = std::dynamic_pointer_cast<matrix3d_u8>(game_data);
-					if (!world_map_)
-					{
-						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-						return;
-					}
-
-					redraw_ = true;
-					win_ = false;
-					if (!terminal_->setMode(TM_GAME))
-						throw std::runtime_error("ClientManager::processMessage: [Terminal setMode failed]");
-					state_ = CS_ACTIVE;
-				}
-				break;
-			default:
-				{	
-					std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-					return;
-				}
-				break;
-			}
-		}
-		break;
-
-	case CS_ACTIVE:
-		{
-			switch (game_msg.getGameCode())
-			{
-			case GameMessage::GC_GAMES_NOTIFY:
-				{
-					game_summary_ptr summary_data = std::dynamic_pointer_cast<GameSummary>(game_data);
-					if (!summary_data)
-					{
-						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-						return;
-					}
-
-					summary_data_ = *summary_data;
-				}
-				break;
-			case GameMessage::GC_UPDATE_NOTIFY:
-				{
-					const player_ptr & player_data = std::dynamic_pointer_cast<Player>(game_data);
-					if (!player_data)
-					{
-						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-						return;
-					}
-
-					uint32_t id = player_data->getPlayerId();
-					size_t ps_index = (id == player_id_ ? 0 : 1);
-					player_states_[ps_index].updateState(*player_data);
-
-					if (player_states_[0].checkAndClearChangedLevel())
-						redraw_ = true;
-				}
-				break;
-			case GameMessage::GC_WINNER_NOTIFY:
-				{
-					const winner_ptr & winner_data = std::dynamic_pointer_cast<Winner>(game_data);
-					if (!winner_data)
-					{
-						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-						return;
-					}
-
-					if (winner_data->getWinnerId() == player_id_)
-						win_ = true;
-					game_over_display_ = true;
-
-					state_ = CS_GAME_OVER;
-				}
-				break;
-			default:
-				{	
-					std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-					return;
-				}
-				break;
-			}
-		}
-		break;
-
-	case CS_GAME_OVER:
-		{
-			switch (game_msg.getGameCode())
-			{
-			case GameMessage::GC_GAMES_NOTIFY:
-				{
-					game_summary_ptr summary_data = std::dynamic_pointer_cast<GameSummary>(game_data);
-					if (!summary_data)
-					{
-						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-						return;
-					}
-
-					summary_data_ = *summary_data;
-				}
-				break;
-			default:
-				{	
-					std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-					return;
-				}
-				break;
-			}
-		}
-		break;
-
-	default:
-		{	
-			std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
-			return;
-		}
-		break;
-	}
-}
-
-void ClientManager::run(MazeClient * client)
-{
-	client_ = client;
-
-	while (!exiting_)
-	{
-		switch (state_)
-		{
-		case CS_INPUT:
-			processInput();
-			break;
-		case CS_WAIT_START:
-			processWaitInput();
-			break;
-		case CS_ACTIVE:
-		case CS_GAME_OVER:
-			processGame();
-			break;
-		}
-		boost::this_thread::sleep(boost::posix_time::millisec(10));
-	}
-}
-
-void ClientManager::processInput()
-{
-	boost::this_thread::sleep(boost::posix_time::millisec(250));
-	terminal_->clearScreen();
-	std::cout << "Welcome, Player " << player_id_ << "!" << std::endl;
-
-	bool done = false;
-	while (!done)
-	{
-		std::cout << std::endl << "Maze Game Main Menu" << std::endl <<
-			"\t1) Create maze" << std::endl <<
-			"\t2) Enter maze (1 player game)" << std::endl <<
-			"\t3) Enter maze (2 player game)" << std::endl <<
-			"\t4) Quit" << std::endl;
-	
-		std::string input;
-		int selection;
-		do
-		{
-			std::cout << "Enter selection (1-4): ";
-			std::getline(std::cin, input);
-		} while (!validateIntRange(input, selection, 1, 4));
-
-		switch (selection)
-		{
-		case 1:
-			if (createMaze())
-			{
-				state_ = CS_WAIT;
-			}
-			done = true;
-			break;
-		case 2:
-		case 3:
-			if (enterMaze(selection - 1))
-			{
-				state_ = CS_WAIT_START;
-			}
-			done = true;
-			break;
-		case 4:
-			exiting_ = done = true;
-			break;
-		}
-	}
-}
-
-void ClientManager::processWaitInput()
-{
-	kb_codes_vec kb_codes;
-	if (terminal_->pollKeys(kb_codes))
-	{
-		switch (kb_codes[0])
-		{
-		case KB_ESCAPE:
-			{
-				GameMessage msg(GameMessage::GC_CANCEL_REQ);
-				client_->write(msg);
-
-				if (!terminal_->setMode(TM_NORMAL))
-					throw std::runtime_error("ClientManager::processWaitInput: [Terminal setMode failed]");
-				state_ = CS_INPUT;
-			}
-			break;
-		}
-	}
-}
-
-bool ClientManager::createMaze()
-{
-	std::cout << std::endl << "Create New Maze" << std::endl;
-	
-	// Retrieve configuration from user.
-	MazeConfig config;
-	if (!getMazeConfiguration(config))
-		return false;
-
-	// Transmit message to server.
-	GameConfig game_data(config.width, config.height, config.levels);
-	GameMessage msg(GameMessage::GC_CREATE_REQ, &game_data);
-	client_->write(msg);
-
-	return true;
-}
-
-bool ClientManager::getMazeConfiguration(MazeConfig & config)
-{
-	// Retrieve maze parameters from user.
-	std::string input;
-	do
-	{
-		std::cout << "\tEnter width (" << MazeConfig::MIN_WIDTH << "-" << MazeConfig::MAX_WIDTH << "): ";
-		std::getline(std::cin, input);
-	} while (!validateIntRange<uint32_t>(input, config.width, MazeConfig::MIN_WIDTH, MazeConfig::MAX_WIDTH));
-
-	do
-	{
-		std::cout << "\tEnter height (" << MazeConfig::MIN_HEIGHT << "-" << MazeConfig::MAX_HEIGHT << "): ";
-		std::getline(std::cin, input);
-	} while (!validateIntRange<uint32_t>(input, config.height, MazeConfig::MIN_HEIGHT, MazeConfig::MAX_HEIGHT));
-
-	do
-	{
-		std::cout << "\tEnter number of levels (" << MazeConfig::MIN_LEVELS << "-" << MazeConfig::MAX_LEVELS << "): ";
-		std::getline(std::cin, input);
-	} while (!validateIntRange<uint32_t>(input, config.levels, MazeConfig::MIN_LEVELS, MazeConfig::MAX_LEVELS));
-
-	// Confirm with user.
-	std::cout << std::endl;
-	config.print();
-	std::cout << std::endl;
-
-	char inputChar = '\0';
-	do
-	{
-		std::cout << "Is this configuration OK?" << std::endl;
-		std::cout << "  [y]es" << std::endl;
-		std::cout << "  [n]o" << std::endl;
-		std::cout << "Enter key for selection: ";
-		std::getline(std::cin, input);
-		if (input.length() == 1)
-			inputChar = tolower(input[0]);
-	} while ( (inputChar != 'n') && (inputChar != 'y') );
-	std::cout << std::endl;
-
-	return (inputChar == 'y');
-}
-
-bool ClientManager::enterMaze(uint32_t num_players)
-{
-	std::cout << std::endl << "Select Maze" << std::endl;
-	
-	const maze_config_vec & configs = summary_data_.getConfigs();
-	uint32_t i;
-	for (i = 0; i < configs.size(); ++i)
-	{
-		std::cout << "\t" << (i + 1) << ") ";
-		configs[i].print();
-	}
-	std::cout << "\t" << (i + 1) << ") Return to Main Menu" << std::endl;
-
-	std::string input;
-	uint32_t selection;
-	do
-	{
-		std::cout << "Enter selection (1-" << (i + 1) << "): ";
-		std::getline(std::cin, input);
-	} while (!validateIntRange<uint32_t>(input, selection, 1, (i + 1)));
-
-	if (selection == (i + 1))
-		return false;
-
-	// Transmit message to server.
-	GameSelect game_data(selection, num_players);
-	GameMessage msg(GameMessage::GC_SELECT_GAME_REQ, &game_data);
-	client_->write(msg);
-
-	return true;
-}
-
-void ClientManager::processGame()
-{
-	bool force_redraw_players = false;
-
-	if (redraw_)
-	{
-		redraw_ = false;
-		force_redraw_players = true;
-
-		terminal_->clearScreen();
-		
-		std::ostringstream oss;
-		oss << world_map_->ptr(0, 0, player_states_[0].getCurrState().getPosition().z) << std::endl;
-		terminal_->output(oss);
-
-		terminal_->setCursorPos(0, world_map_->getHeight());
-		oss.str("");
-		oss << "Player " << player_id_ << ", GO!" << std::endl;
-		terminal_->output(oss);
-	}
-
-	for (size_t i = 0; i < 2; ++i)
-	{
-		PlayerState & ps = player_states_[i];
-		if (ps.checkAndClearUpdated() || force_redraw_players)
-		{
-			if (!force_redraw_players)
-			{
-				const Player & prev_state = ps.getPrevState();
-				if (!prev_state.isClear())
-				{
-					if ( (i == 0) || 
-						 (prev_state.getPosition().z == player_states_[0].getCurrState().getPosition().z) )
-					{
-						const Vertex3DEx & prev_pos = prev_state.getPosition();
-						uint8_t local_char = world_map_->at(prev_pos);
-						terminal_->setCursorPos(prev_pos.x, prev_pos.y);
-
-						std::ostringstream oss;
-						oss << local_char;
-						terminal_->output(oss);
-					}
-				}
-			}
-
-			if ( (i == 0) || 
-				 (player_states_[i].getCurrState().getPosition().z == player_states_[0].getCurrState().getPosition().z) )
-			{
-				const Player & curr_state = ps.getCurrState();
-				if (!curr_state.isClear())
-				{
-					const Vertex3DEx & curr_pos = curr_state.getPosition();
-					terminal_->setCursorPos(curr_pos.x, curr_pos.y);
-
-					std::ostringstream oss;
-					oss << static_cast<char>(curr_state.getPlayerId() + 48);
-					terminal_->output(oss);
-				}
-			}
-		}
-	}
-	terminal_->setCursorPos(0, world_map_->getHeight());
-
-	if (game_over_display_)
-	{
-		game_over_display_ = false;
-
-		std::ostringstream oss;
-		//terminal_->setCursorPos(0, world_map_->getHeight());
-		if (win_)
-			oss << "You win!  Press enter to return to menu..." << std::endl;
-		else
-			oss << "You lost.  Press enter to return to menu..." << std::endl;
-		terminal_->output(oss);
-	}
-
-	std::unique_ptr<MoveReq> req;
-	kb_codes_vec kb_codes;
-	bool quit = false;
-	if (terminal_->pollKeys(kb_codes))
-	{
-		if (state_ == CS_ACTIVE)
-		{
-			const Vertex3DEx & curr_pos = player_states_[0].getCurrState().getPosition();
-			uint8_t local_char = world_map_->at(curr_pos);
-			switch (kb_codes[0])
-			{
-			case KB_ESCAPE:
-				quit = true;
-				break;
-			case KB_A:
-				if ( (local_char == '/') || (local_char == 'X') )
-				{
-					req.reset(new MoveReq(MoveReq::MD_TOP));
-				}
-				break;
-			case KB_Z:
-				if ( (local_char == '\\') || (local_char == 'X') )
-				{
-					req.reset(new MoveReq(MoveReq::MD_BOTTOM));
-				}
-				break;
-			case KB_UP:
-				{
-					uint8_t target_char = world_map_->at(curr_pos.x, curr_pos.y - 1, curr_pos.z);
-					if ( (target_char < 127) || (target_char == 234) )
-					{
-						req.reset(new MoveReq(MoveReq::MD_UP));
-					}
-				}
-				break;
-			case KB_DOWN:
-				{
-					uint8_t target_char = world_map_->at(curr_pos.x, curr_pos.y + 1, curr_pos.z);
-					if ( (target_char < 127) || (target_char == 234) )
-					{
-						req.reset(new MoveReq(MoveReq::MD_DOWN));
-					}
-				}
-				break;
-			case KB_LEFT:
-				{
-					uint8_t target_char = world_map_->at(curr_pos.x - 2, curr_pos.y, curr_pos.z);
-					if ( (target_char < 127) || (target_char == 234) )
-					{
-						req.reset(new MoveReq(MoveReq::MD_LEFT));
-					}
-				}
-				break;
-			case KB_RIGHT:
-				{
-					uint8_t target_char = world_map_->at(curr_pos.x + 2, curr_pos.y, curr_pos.z);
-					if ( (target_char < 127) || (target_char == 234) )
-					{
-						req.reset(new MoveReq(MoveReq::MD_RIGHT));
-					}
-				}
-				break;
-			}
-		}
-		else if (state_ == CS_GAME_OVER)
-		{
-			if (kb_codes[0] == KB_ENTER)
-			{
-				if (!terminal_->setMode(TM_NORMAL))
-					throw std::runtime_error("ClientManager::processGame: [Terminal setMode failed]");
-				state_ = CS_INPUT;
-			}
-		}
-	}
-
-	if (req)
-	{
-		GameMessage msg(GameMessage::GC_MOVE_REQ, req.get());
-		client_->write(msg);
-	}
-	else if (quit)
-	{
-		GameMessage msg(GameMessage::GC_CANCEL_REQ);
-		client_->write(msg);
-
-		if (!terminal_->setMode(TM_NORMAL))
-			throw std::runtime_error("ClientManager::processGame: [Terminal setMode failed]");
-		state_ = CS_INPUT;
-	}
-}
+#include <limits>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "MazeClient.h"
+#include "Utility.h"
+#include "../MazeShared/MapCodec.h"
+#include "../MazeShared/MazeGenerator.h"
+#include "../MazeShared/WorldRenderer.h"
+
+
+ClientManager::ClientManager() :
+	terminal_(new OSTerminal()), exiting_(false), state_(CS_INIT), 
+	player_id_(0), client_(nullptr), redraw_(true), win_(false), game_over_display_(false)
+{
+	if (!terminal_->initialize())
+		throw std::runtime_error("ClientManager::ClientManager: [Terminal initialization failed]");
+}
+
+const MessageDispatcher<ClientManager> ClientManager::dispatcher_ = ClientManager::buildDispatcher();
+
+MessageDispatcher<ClientManager> ClientManager::buildDispatcher()
+{
+	MessageDispatcher<ClientManager> dispatcher;
+	dispatcher.add<PlayerSchema>(&ClientManager::processUpdate)
+		.add<UpdateFrameSchema>(&ClientManager::processUpdateFrame)
+		.add<WinnerSchema>(&ClientManager::processWinner);
+	return dispatcher;
+}
+
+void ClientManager::processMessage(GameMessage & game_msg)
+{
+	// Gameplay traffic is read in place from the receive buffer; everything else is decoded into GameData objects.
+	switch (dispatcher_.dispatch(*this, game_msg))
+	{
+	case MessageDispatcher<ClientManager>::DR_HANDLED:
+		return;
+	case MessageDispatcher<ClientManager>::DR_BAD_SIZE:
+		std::cerr << "ERROR: ClientManager::processMessage [Message decode failed; code=" << game_msg.getGameCode() <<
+			"]" << std::endl;
+		return;
+	default:
+		break;
+	}
+
+	game_data_ptr game_data = game_msg.decodeBody();
+	if (!game_data)
+	{
+		std::cerr << "ERROR: ClientManager::processMessage [Message decode failed; code=" << game_msg.getGameCode() << "]" << std::endl;
+		return;
+	}
+
+	switch (state_)
+	{
+	case CS_INIT:
+		{
+			player_id_ptr player_id_data = std::dynamic_pointer_cast<PlayerID>(game_data);
+			if (!player_id_data)
+			{
+				std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+				return;
+			}
+			
+			player_id_ = player_id_data->getPlayerId();
+			state_ = CS_INPUT;
+		}
+		break;
+
+	case CS_INPUT:
+	case CS_WAIT:
+		{
+			game_summary_ptr summary_data = std::dynamic_pointer_cast<GameSummary>(game_data);
+			if (!summary_data)
+			{
+				std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+				return;
+			}
+
+			summary_data_ = *summary_data;
+
+			state_ = CS_INPUT;
+		}
+		break;
+
+	case CS_WAIT_START:
+		{
+			switch (game_msg.getGameCode())
+			{
+			case GameMessage::GC_GAMES_NOTIFY:
+				{
+					game_summary_ptr summary_data = std::dynamic_pointer_cast<GameSummary>(game_data);
+					if (!summary_data)
+					{
+						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+						return;
+					}
+
+					summary_data_ = *summary_data;
+				}
+				break;
+			case GameMessage::GC_SELECT_GAME_RESP:
+				{
+					select_resp_ptr select_resp = std::dynamic_pointer_cast<GameSelectResp>(game_data);
+					if (!select_resp)
+					{
+						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+						return;
+					}
+
+					if (select_resp->getSelectResp() == GameSelectResp::SR_FAIL)
+					{
+						std::cout << std::endl << "Cannot enter maze; currently occupied..." << std::endl;
+						boost::this_thread::sleep(boost::posix_time::millisec(500));
+						state_ = CS_INPUT;
+					}
+					else
+					{
+						std::cout << std::endl << "Waiting for other player..." << std::endl;
+
+						if (!terminal_->setMode(TM_GAME))
+							throw std::runtime_error("ClientManager::processMessage: [Terminal setMode failed]");
+					}
+				}
+				break;
+			case GameMessage::GC_START_NOTIFY:
+			case GameMessage::GC_PACKED_START_NOTIFY:
+			case GameMessage::GC_WALLS_START_NOTIFY:
+			case GameMessage::GC_SEED_START_NOTIFY:
+				{
+					packed_map_ptr packed_map = std::dynamic_pointer_cast<PackedMap>(game_data);
+					wall_map_ptr wall_map = std::dynamic_pointer_cast<WallMap>(game_data);
+					seed_map_ptr seed_map = std::dynamic_pointer_cast<SeedMap>(game_data);
+					if (seed_map)
+					{
+						world_map_ = regenerateMap(*seed_map);
+						if (!world_map_)
+						{
+							// Fall back to having the whole map sent.
+							GameMessage msg(GameMessage::GC_MAP_REQ);
+							client_->write(msg);
+							break;
+						}
+					}
+					else if (packed_map)
+						world_map_ = packed_map->getMap();
+					else if (wall_map)
+						world_map_ = WorldRenderer::render(*wall_map->getWalls(), wall_map->getGoal());
+					else
+						world_map_ = std::dynamic_pointer_cast<matrix3d_u8>(game_data);
+
+					if (!world_map_)
+					{
+						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+						return;
+					}
+
+					redraw_ = true;
+					win_ = false;
+					if (!terminal_->setMode(TM_GAME))
+						throw std::runtime_error("ClientManager::processMessage: [Terminal setMode failed]");
+					state_ = CS_ACTIVE;
+				}
+				break;
+			default:
+				{	
+					std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+					return;
+				}
+				break;
+			}
+		}
+		break;
+
+	case CS_ACTIVE:
+		{
+			switch (game_msg.getGameCode())
+			{
+			case GameMessage::GC_GAMES_NOTIFY:
+				{
+					game_summary_ptr summary_data = std::dynamic_pointer_cast<GameSummary>(game_data);
+					if (!summary_data)
+					{
+						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+						return;
+					}
+
+					summary_data_ = *summary_data;
+				}
+				break;
+			default:
+				{	
+					std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+					return;
+				}
+				break;
+			}
+		}
+		break;
+
+	case CS_GAME_OVER:
+		{
+			switch (game_msg.getGameCode())
+			{
+			case GameMessage::GC_GAMES_NOTIFY:
+				{
+					game_summary_ptr summary_data = std::dynamic_pointer_cast<GameSummary>(game_data);
+					if (!summary_data)
+					{
+						std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+						return;
+					}
+
+					summary_data_ = *summary_data;
+				}
+				break;
+			default:
+				{	
+					std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+					return;
+				}
+				break;
+			}
+		}
+		break;
+
+	default:
+		{	
+			std::cerr << "ERROR: ClientManager::processMessage [Unexpected message received]" << std::endl << *game_data;
+			return;
+		}
+		break;
+	}
+}
+
+void ClientManager::run(MazeClient * client)
+{
+	client_ = client;
+
+	while (!exiting_)
+	{
+		switch (state_)
+		{
+		case CS_INPUT:
+			processInput();
+			break;
+		case CS_WAIT_START:
+			processWaitInput();
+			break;
+		case CS_ACTIVE:
+		case CS_GAME_OVER:
+			processGame();
+			break;
+		}
+		boost::this_thread::sleep(boost::posix_time::millisec(10));
+	}
+}
+
+void ClientManager::processInput()
+{
+	boost::this_thread::sleep(boost::posix_time::millisec(250));
+	terminal_->clearScreen();
+	std::cout << "Welcome, Player " << player_id_ << "!" << std::endl;
+
+	bool done = false;
+	while (!done)
+	{
+		std::cout << std::endl << "Maze Game Main Menu" << std::endl <<
+			"\t1) Create maze" << std::endl <<
+			"\t2) Enter maze (1 player game)" << std::endl <<
+			"\t3) Enter maze (2 player game)" << std::endl <<
+			"\t4) Quit" << std::endl;
+	
+		std::string input;
+		int selection;
+		do
+		{
+			std::cout << "Enter selection (1-4): ";
+			std::getline(std::cin, input);
+		} while (!validateIntRange(input, selection, 1, 4));
+
+		switch (selection)
+		{
+		case 1:
+			if (createMaze())
+			{
+				state_ = CS_WAIT;
+			}
+			done = true;
+			break;
+		case 2:
+		case 3:
+			if (enterMaze(selection - 1))
+			{
+				state_ = CS_WAIT_START;
+			}
+			done = true;
+			break;
+		case 4:
+			exiting_ = done = true;
+			break;
+		}
+	}
+}
+
+void ClientManager::processWaitInput()
+{
+	kb_codes_vec kb_codes;
+	if (terminal_->pollKeys(kb_codes))
+	{
+		switch (kb_codes[0])
+		{
+		case KB_ESCAPE:
+			{
+				GameMessage msg(GameMessage::GC_CANCEL_REQ);
+				client_->write(msg);
+
+				if (!terminal_->setMode(TM_NORMAL))
+					throw std::runtime_error("ClientManager::processWaitInput: [Terminal setMode failed]");
+				state_ = CS_INPUT;
+			}
+			break;
+		}
+	}
+}
+
+bool ClientManager::createMaze()
+{
+	std::cout << std::endl << "Create New Maze" << std::endl;
+	
+	// Retrieve configuration from user.
+	MazeConfig config;
+	if (!getMazeConfiguration(config))
+		return false;
+
+	// Transmit message to server.
+	GameConfig game_data(config.width, config.height, config.levels, config.algorithm, config.seed);
+	GameMessage msg(GameMessage::GC_CREATE_REQ, &game_data);
+	client_->write(msg);
+
+	return true;
+}
+
+bool ClientManager::getMazeConfiguration(MazeConfig & config)
+{
+	// Retrieve maze parameters from user.
+	std::string input;
+	do
+	{
+		std::cout << "\tEnter width (" << MazeConfig::MIN_WIDTH << "-" << MazeConfig::MAX_WIDTH << "): ";
+		std::getline(std::cin, input);
+	} while (!validateIntRange<uint32_t>(input, config.width, MazeConfig::MIN_WIDTH, MazeConfig::MAX_WIDTH));
+
+	do
+	{
+		std::cout << "\tEnter height (" << MazeConfig::MIN_HEIGHT << "-" << MazeConfig::MAX_HEIGHT << "): ";
+		std::getline(std::cin, input);
+	} while (!validateIntRange<uint32_t>(input, config.height, MazeConfig::MIN_HEIGHT, MazeConfig::MAX_HEIGHT));
+
+	do
+	{
+		std::cout << "\tEnter number of levels (" << MazeConfig::MIN_LEVELS << "-" << MazeConfig::MAX_LEVELS << "): ";
+		std::getline(std::cin, input);
+	} while (!validateIntRange<uint32_t>(input, config.levels, MazeConfig::MIN_LEVELS, MazeConfig::MAX_LEVELS));
+
+	std::cout << "\tGeneration algorithms:" << std::endl;
+	for (int i = 0; i < MazeConfig::MA_MAX; ++i)
+		std::cout << "\t\t" << (i + 1) << ") " << MazeConfig::getAlgorithmName(static_cast<MazeConfig::eAlgorithm>(i)) << std::endl;
+
+	int algorithm;
+	do
+	{
+		std::cout << "\tEnter algorithm (1-" << MazeConfig::MA_MAX << "): ";
+		std::getline(std::cin, input);
+	} while (!validateIntRange<int>(input, algorithm, 1, MazeConfig::MA_MAX));
+	config.algorithm = static_cast<MazeConfig::eAlgorithm>(algorithm - 1);
+
+	do
+	{
+		std::cout << "\tEnter seed (0 for random): ";
+		std::getline(std::cin, input);
+	} while (!validateIntRange<uint64_t>(input, config.seed, 0, std::numeric_limits<uint64_t>::max()));
+
+	// Confirm with user.
+	std::cout << std::endl;
+	config.print();
+	std::cout << std::endl;
+
+	char inputChar = '\0';
+	do
+	{
+		std::cout << "Is this configuration OK?" << std::endl;
+		std::cout << "  [y]es" << std::endl;
+		std::cout << "  [n]o" << std::endl;
+		std::cout << "Enter key for selection: ";
+		std::getline(std::cin, input);
+		if (input.length() == 1)
+			inputChar = tolower(input[0]);
+	} while ( (inputChar != 'n') && (inputChar != 'y') );
+	std::cout << std::endl;
+
+	return (inputChar == 'y');
+}
+
+bool ClientManager::enterMaze(uint32_t num_players)
+{
+	std::cout << std::endl << "Select Maze" << std::endl;
+	
+	const maze_config_vec & configs = summary_data_.getConfigs();
+	uint32_t i;
+	for (i = 0; i < configs.size(); ++i)
+	{
+		std::cout << "\t" << (i + 1) << ") ";
+		configs[i].print();
+	}
+	std::cout << "\t" << (i + 1) << ") Return to Main Menu" << std::endl;
+
+	std::string input;
+	uint32_t selection;
+	do
+	{
+		std::cout << "Enter selection (1-" << (i + 1) << "): ";
+		std::getline(std::cin, input);
+	} while (!validateIntRange<uint32_t>(input, selection, 1, (i + 1)));
+
+	if (selection == (i + 1))
+		return false;
+
+	// Transmit message to server.
+	GameSelect game_data(selection, num_players);
+	GameMessage msg(GameMessage::GC_SELECT_GAME_REQ, &game_data);
+	client_->write(msg);
+
+	return true;
+}
+
+matrix3d_u8_ptr ClientManager::regenerateMap(const SeedMap & seed_map) const
+{
+	const MazeConfig & config = seed_map.getConfig();
+	const Vertex3DEx & goal = seed_map.getGoal();
+	if ( !config.isWithin(MazeConfig(MazeConfig::MAX_WIDTH, MazeConfig::MAX_HEIGHT, MazeConfig::MAX_LEVELS)) ||
+		(static_cast<uint32_t>(config.algorithm) >= MazeConfig::MA_MAX) || !MazeGenerator::isReproducible(config.algorithm) ||
+		(goal.x >= config.width) || (goal.y >= config.height) || (goal.z >= config.levels) )
+	{
+		std::cerr << "ERROR: ClientManager::regenerateMap [Unsupported maze configuration]" << std::endl;
+		return matrix3d_u8_ptr();
+	}
+
+	WallMatrix walls(config.width, config.height, config.levels);
+	MazeGenerator::create(config.algorithm, config.seed)->generate(walls);
+	if (walls.getChecksum() != seed_map.getChecksum())
+	{
+		std::cerr << "ERROR: ClientManager::regenerateMap [Maze checksum mismatch]" << std::endl;
+		return matrix3d_u8_ptr();
+	}
+
+	return WorldRenderer::render(walls, goal);
+}
+
+void ClientManager::updatePlayer(const Player & player_data)
+{
+	uint32_t id = player_data.getPlayerId();
+	size_t ps_index = (id == player_id_ ? 0 : 1);
+	player_states_[ps_index].updateState(player_data);
+
+	if (player_states_[0].checkAndClearChangedLevel())
+		redraw_ = true;
+}
+
+void ClientManager::processUpdate(const GameMessage & game_msg)
+{
+	if ( (state_ != CS_WAIT_START) && (state_ != CS_ACTIVE) )
+	{
+		std::cerr << "ERROR: ClientManager::processUpdate [Unexpected message received]" << std::endl;
+		return;
+	}
+
+	// Starting positions can arrive while a fallback map is still on its way.
+	MessageView<PlayerSchema> view(game_msg);
+	updatePlayer(Player(view.get<PlayerSchema::PlayerId>(),
+		Vertex3DEx(view.get<PlayerSchema::X>(), view.get<PlayerSchema::Y>(), view.get<PlayerSchema::Z>())));
+}
+
+void ClientManager::processUpdateFrame(const GameMessage & game_msg)
+{
+	if ( (state_ != CS_WAIT_START) && (state_ != CS_ACTIVE) )
+	{
+		std::cerr << "ERROR: ClientManager::processUpdateFrame [Unexpected message received]" << std::endl;
+		return;
+	}
+
+	const char * data = game_msg.body();
+	const char * end = data + game_msg.bodyLength();
+	UpdateFrame::Entry entry;
+	for (size_t count = 0; data != end; ++count)
+	{
+		if ( (count == UpdateFrame::MAX_PLAYERS) || !UpdateFrame::readEntry(data, end, entry) )
+		{
+			std::cerr << "ERROR: ClientManager::processUpdateFrame [Malformed update frame]" << std::endl;
+			return;
+		}
+
+		const Player & prev_state = player_states_[entry.player_id == player_id_ ? 0 : 1].getCurrState();
+		updatePlayer(Player(entry.player_id, UpdateFrame::applyEntry(entry, prev_state.getPosition())));
+	}
+}
+
+void ClientManager::processWinner(const GameMessage & game_msg)
+{
+	if (state_ != CS_ACTIVE)
+	{
+		std::cerr << "ERROR: ClientManager::processWinner [Unexpected message received]" << std::endl;
+		return;
+	}
+
+	if (MessageView<WinnerSchema>(game_msg).get<WinnerSchema::WinnerId>() == player_id_)
+		win_ = true;
+	game_over_display_ = true;
+
+	state_ = CS_GAME_OVER;
+}
+
+bool ClientManager::isPassable(uint8_t map_char)
+{
+	// Everything below the box-drawing characters is open floor, doorway or stairwell; 234 marks the goal.
+	return ( (map_char < 127) || (map_char == 234) );
+}
+
+void ClientManager::processGame()
+{
+	bool force_redraw_players = false;
+
+	if (redraw_)
+	{
+		redraw_ = false;
+		force_redraw_players = true;
+
+		terminal_->clearScreen();
+		
+		std::ostringstream oss;
+		oss << world_map_->ptr(0, 0, player_states_[0].getCurrState().getPosition().z) << std::endl;
+		terminal_->output(oss);
+
+		terminal_->setCursorPos(0, world_map_->getHeight());
+		oss.str("");
+		oss << "Player " << player_id_ << ", GO!" << std::endl;
+		terminal_->output(oss);
+	}
+
+	for (size_t i = 0; i < 2; ++i)
+	{
+		PlayerState & ps = player_states_[i];
+		if (ps.checkAndClearUpdated() || force_redraw_players)
+		{
+			if (!force_redraw_players)
+			{
+				const Player & prev_state = ps.getPrevState();
+				if (!prev_state.isClear())
+				{
+					if ( (i == 0) || 
+						 (prev_state.getPosition().z == player_states_[0].getCurrState().getPosition().z) )
+					{
+						const Vertex3DEx & prev_pos = prev_state.getPosition();
+						uint8_t local_char = world_map_->at(prev_pos);
+						terminal_->setCursorPos(prev_pos.x, prev_pos.y);
+
+						std::ostringstream oss;
+						oss << local_char;
+						terminal_->output(oss);
+					}
+				}
+			}
+
+			if ( (i == 0) || 
+				 (player_states_[i].getCurrState().getPosition().z == player_states_[0].getCurrState().getPosition().z) )
+			{
+				const Player & curr_state = ps.getCurrState();
+				if (!curr_state.isClear())
+				{
+					const Vertex3DEx & curr_pos = curr_state.getPosition();
+					terminal_->setCursorPos(curr_pos.x, curr_pos.y);
+
+					std::ostringstream oss;
+					oss << static_cast<char>(curr_state.getPlayerId() + 48);
+					terminal_->output(oss);
+				}
+			}
+		}
+	}
+	terminal_->setCursorPos(0, world_map_->getHeight());
+
+	if (game_over_display_)
+	{
+		game_over_display_ = false;
+
+		std::ostringstream oss;
+		//terminal_->setCursorPos(0, world_map_->getHeight());
+		if (win_)
+			oss << "You win!  Press enter to return to menu..." << std::endl;
+		else
+			oss << "You lost.  Press enter to return to menu..." << std::endl;
+		terminal_->output(oss);
+	}
+
+	PathReq path;
+	kb_codes_vec kb_codes;
+	bool quit = false;
+	if (terminal_->pollKeys(kb_codes))
+	{
+		if (state_ == CS_ACTIVE)
+		{
+			// Keys that arrived together go out as one path, each checked from where the steps before it lead.  A run
+			// ends the path, since only the server knows where it stops.
+			Vertex3DEx pos = player_states_[0].getCurrState().getPosition();
+			for (size_t i = 0; (i < kb_codes.size()) && !quit && (path.getNumSteps() < PathReq::MAX_STEPS); ++i)
+			{
+				MoveReq::eMoveDir dir = MoveReq::MD_NONE;
+				bool run = false;
+				uint8_t local_char = world_map_->at(pos);
+				switch (kb_codes[i])
+				{
+				case KB_ESCAPE:
+					quit = true;
+					break;
+				case KB_A:
+					if ( (local_char == '/') || (local_char == 'X') )
+						dir = MoveReq::MD_TOP;
+					break;
+				case KB_Z:
+					if ( (local_char == '\\') || (local_char == 'X') )
+						dir = MoveReq::MD_BOTTOM;
+					break;
+				case KB_SHIFT_UP:
+					run = true; // Fall through
+				case KB_UP:
+					if (isPassable(world_map_->at(pos.x, pos.y - 1, pos.z)))
+						dir = MoveReq::MD_UP;
+					break;
+				case KB_SHIFT_DOWN:
+					run = true; // Fall through
+				case KB_DOWN:
+					if (isPassable(world_map_->at(pos.x, pos.y + 1, pos.z)))
+						dir = MoveReq::MD_DOWN;
+					break;
+				case KB_SHIFT_LEFT:
+					run = true; // Fall through
+				case KB_LEFT:
+					if (isPassable(world_map_->at(pos.x - 2, pos.y, pos.z)))
+						dir = MoveReq::MD_LEFT;
+					break;
+				case KB_SHIFT_RIGHT:
+					run = true; // Fall through
+				case KB_RIGHT:
+					if (isPassable(world_map_->at(pos.x + 2, pos.y, pos.z)))
+						dir = MoveReq::MD_RIGHT;
+					break;
+				}
+
+				if (dir == MoveReq::MD_NONE)
+					continue;
+
+				path.addStep(dir, run);
+				if (run)
+					break;
+
+				switch (dir)
+				{
+				case MoveReq::MD_LEFT: pos.x -= 2; break;
+				case MoveReq::MD_RIGHT: pos.x += 2; break;
+				case MoveReq::MD_UP: pos.y--; break;
+				case MoveReq::MD_DOWN: pos.y++; break;
+				case MoveReq::MD_BOTTOM: pos.z--; break;
+				case MoveReq::MD_TOP: pos.z++; break;
+				default: break;
+				}
+			}
+		}
+		else if (state_ == CS_GAME_OVER)
+		{
+			if (kb_codes[0] == KB_ENTER)
+			{
+				if (!terminal_->setMode(TM_NORMAL))
+					throw std::runtime_error("ClientManager::processGame: [Terminal setMode failed]");
+				state_ = CS_INPUT;
+			}
+		}
+	}
+
+	if (quit)
+	{
+		GameMessage msg(GameMessage::GC_CANCEL_REQ);
+		client_->write(msg);
+
+		if (!terminal_->setMode(TM_NORMAL))
+			throw std::runtime_error("ClientManager::processGame: [Terminal setMode failed]");
+		state_ = CS_INPUT;
+	}
+	else if ( (path.getNumSteps() == 1) && !PathReq::isRun(path.getSteps()[0]) )
+	{
+		MoveReq::eMoveDir dir = PathReq::getStepDir(path.getSteps()[0]);
+		client_->write(MessageBuilder<MoveReqSchema>().set<MoveReqSchema::MoveDir>(dir).getMessage());
+	}
+	else if (path.getNumSteps() > 0)
+	{
+		client_->write(GameMessage(GameMessage::GC_PATH_REQ, &path));
+	}
+}
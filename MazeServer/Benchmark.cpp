@@ -0,0 +1,532 @@
+#include <cstring>
+#include <iomanip>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "Benchmark.h"
+#include "MazeServer.h"
+#include "MpscQueue.h"
+#include "../MazeShared/MapCodec.h"
+#include "../MazeShared/MazeGenerator.h"
+#include "../MazeShared/MessagePool.h"
+#include "../MazeShared/WorldRenderer.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using boost::asio::ip::tcp;
+
+
+const Benchmark::Entry Benchmark::entries_[] =
+{
+	{ "generate", "Maze generation and world rendering", &Benchmark::benchGeneration },
+	{ "codec", "Packed start map size and speed", &Benchmark::benchCodec },
+	{ "frames", "Update frame size and encoding speed", &Benchmark::benchFrames },
+	{ "pool", "Message buffer pool throughput", &Benchmark::benchPool },
+	{ "memory", "Message and session memory", &Benchmark::benchMemory }
+};
+
+const size_t Benchmark::NUM_ENTRIES = sizeof(Benchmark::entries_) / sizeof(Benchmark::entries_[0]);
+
+
+// Bytes of heap in use, where the C library can tell.
+static bool getHeapInUse(size_t & bytes)
+{
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 33)))
+	bytes = mallinfo2().uordblks;
+	return true;
+#else
+	bytes = 0;
+	return false;
+#endif
+}
+
+static std::string formatSize(uint32_t width, uint32_t height, uint32_t levels)
+{
+	std::ostringstream os;
+	os << width << "x" << height << "x" << levels;
+	return os.str();
+}
+
+bool Benchmark::run(const std::vector<std::string> & names)
+{
+	std::vector<const Entry *> selected;
+	for (size_t i = 0; i < names.size(); ++i)
+	{
+		size_t j = 0;
+		while ( (j < NUM_ENTRIES) && (names[i] != entries_[j].name) )
+			++j;
+		if (j == NUM_ENTRIES)
+		{
+			std::cerr << "ERROR: Benchmark::run [Unknown benchmark " << names[i] << "]" << std::endl;
+			return false;
+		}
+		selected.push_back(&entries_[j]);
+	}
+	if (selected.empty())
+	{
+		for (size_t i = 0; i < NUM_ENTRIES; ++i)
+			selected.push_back(&entries_[i]);
+	}
+
+	bool passed = true;
+	for (size_t i = 0; i < selected.size(); ++i)
+	{
+		std::cout << "[" << selected[i]->name << "] " << selected[i]->description << std::endl;
+		if (!selected[i]->func())
+			passed = false;
+		std::cout << std::endl;
+	}
+	return passed;
+}
+
+void Benchmark::printNames(std::ostream & os)
+{
+	for (size_t i = 0; i < NUM_ENTRIES; ++i)
+	{
+		os << "\t" << std::left << std::setw(10) << entries_[i].name << std::right << entries_[i].description <<
+			std::endl;
+	}
+}
+
+
+// Prim's algorithm as it was before frontier rooms were swapped out: a room is erased from the middle of the
+// frontier, and the explored neighbours of every room go into a fresh vector.  Only the generate benchmark uses it,
+// as the baseline for the current generator.
+class QuadraticPrimGenerator : public MazeGenerator
+{
+protected:
+	virtual size_t carve();
+};
+
+size_t QuadraticPrimGenerator::carve()
+{
+	static const uint8_t ROOM_LOADED = 1 << 0;
+	static const uint8_t ROOM_EXPLORED = 1 << 1;
+
+	std::vector<uint8_t> flags(total_rooms_, 0);
+	vertex3d_vec frontier;
+	frontier.push_back(Vertex3DEx(width_ / 2, height_ / 2, levels_ / 2));
+	size_t peak_frontier = 0;
+
+	uint32_t neighbours[6];
+	uint8_t dirs[6];
+	while (frontier.size() > 0)
+	{
+		size_t index = random(static_cast<uint32_t>(frontier.size()));
+		Vertex3DEx curr_vert = frontier[index];
+		uint32_t curr_room = curr_vert.x + (curr_vert.y * row_offset_) + (curr_vert.z * level_offset_);
+		flags[curr_room] |= ROOM_EXPLORED;
+
+		std::vector<uint8_t> explored_dirs;
+		size_t num_neighbours = getNeighbours(curr_room, neighbours, dirs);
+		for (size_t i = 0; i < num_neighbours; ++i)
+		{
+			uint32_t room = neighbours[i];
+			if (flags[room] & ROOM_EXPLORED)
+			{
+				explored_dirs.push_back(dirs[i]);
+			}
+			else if ( (flags[room] & ROOM_LOADED) == 0 )
+			{
+				flags[room] |= ROOM_LOADED;
+				frontier.push_back(Vertex3DEx(room % row_offset_, (room % level_offset_) / row_offset_,
+					room / level_offset_));
+			}
+		}
+
+		if (explored_dirs.size() > 0)
+			walls_->removeWall(curr_room, explored_dirs[random(static_cast<uint32_t>(explored_dirs.size()))]);
+
+		peak_frontier = std::max(peak_frontier, frontier.size());
+		frontier.erase(frontier.begin() + index);
+	}
+
+	return (peak_frontier * sizeof(Vertex3DEx)) + flags.size();
+}
+
+
+// A perfect maze opens exactly one wall fewer than it has rooms.
+static bool isPerfect(const WallMatrix & walls)
+{
+	size_t open_walls = 0;
+	for (uint32_t room = 0; room < walls.getTotalRooms(); ++room)
+	{
+		for (int axis = 0; axis < WallMatrix::WA_MAX; ++axis)
+		{
+			if (!walls.hasWall(room, static_cast<WallMatrix::eAxis>(axis)))
+				++open_walls;
+		}
+	}
+	return (open_walls == (walls.getTotalRooms() - 1));
+}
+
+bool Benchmark::benchGeneration()
+{
+	// Prim's algorithm at every size, against the quadratic version it replaced; the rest at one size.
+	static const uint32_t sizes[][3] = { { 19, 11, 10 }, { 128, 128, 8 }, { 256, 256, 8 }, { 1000, 1000, 4 } };
+	static const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+	static const size_t common_size = 2;
+
+	bool passed = true;
+	for (int a = 0; a < MazeConfig::MA_MAX; ++a)
+	{
+		MazeConfig::eAlgorithm algorithm = static_cast<MazeConfig::eAlgorithm>(a);
+		for (size_t i = 0; i < num_sizes; ++i)
+		{
+			if ( (algorithm != MazeConfig::MA_PRIM) && (i != common_size) )
+				continue;
+
+			WallMatrix walls(sizes[i][0], sizes[i][1], sizes[i][2]);
+			double rooms = walls.getTotalRooms();
+			maze_generator_ptr generator = MazeGenerator::create(algorithm, 1);
+			generator->generate(walls);
+			double generate_ms = generator->getStats().elapsed_ms;
+
+			boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+			std::unique_ptr<matrix3d_u8> world = WorldRenderer::render(walls,
+				Vertex3DEx(sizes[i][0] - 1, sizes[i][1] - 1, sizes[i][2] - 1));
+			double render_ms = getElapsedMs(start);
+
+			std::cout << "  " << std::left << std::setw(22) << MazeConfig::getAlgorithmName(algorithm) <<
+				std::setw(14) << formatSize(sizes[i][0], sizes[i][1], sizes[i][2]) << std::right << std::fixed <<
+				std::setprecision(1) << " rooms " << std::setw(8) << walls.getTotalRooms() << "  generate " <<
+				std::setw(8) << generate_ms << " ms (" << std::setprecision(2) << std::setw(5) <<
+				(rooms / (generate_ms * 1000.0)) << "M rooms/s)  render " << std::setprecision(1) << std::setw(7) <<
+				render_ms << " ms" << std::endl;
+
+			if (!isPerfect(walls))
+			{
+				std::cerr << "ERROR: Benchmark::benchGeneration [" << MazeConfig::getAlgorithmName(algorithm) <<
+					" maze is not perfect]" << std::endl;
+				passed = false;
+			}
+
+			if (algorithm != MazeConfig::MA_PRIM)
+				continue;
+
+			WallMatrix baseline_walls(sizes[i][0], sizes[i][1], sizes[i][2]);
+			QuadraticPrimGenerator baseline;
+			baseline.setSeed(1);
+			baseline.generate(baseline_walls);
+			double baseline_ms = baseline.getStats().elapsed_ms;
+
+			std::cout << "  " << std::left << std::setw(22) << "  quadratic baseline" << std::setw(14) << "" <<
+				std::right << "               generate " << std::setw(8) << baseline_ms << " ms (" <<
+				std::setprecision(2) << std::setw(5) << (rooms / (baseline_ms * 1000.0)) << "M rooms/s)  " <<
+				std::setprecision(1) << (baseline_ms / generate_ms) << "x slower" << std::endl;
+
+			if (!isPerfect(baseline_walls))
+			{
+				std::cerr << "ERROR: Benchmark::benchGeneration [Baseline maze is not perfect]" << std::endl;
+				passed = false;
+			}
+		}
+	}
+	return passed;
+}
+
+bool Benchmark::benchCodec()
+{
+	static const uint32_t sizes[][3] = { { 100, 100, 4 }, { 1000, 1000, 2 } };
+	static const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+	bool passed = true;
+	for (size_t i = 0; i < num_sizes; ++i)
+	{
+		for (int a = 0; a < MazeConfig::MA_MAX; ++a)
+		{
+			MazeConfig::eAlgorithm algorithm = static_cast<MazeConfig::eAlgorithm>(a);
+			WallMatrix walls(sizes[i][0], sizes[i][1], sizes[i][2]);
+			MazeGenerator::create(algorithm, 3)->generate(walls);
+			std::unique_ptr<matrix3d_u8> world = WorldRenderer::render(walls,
+				Vertex3DEx(sizes[i][0] - 1, sizes[i][1] - 1, sizes[i][2] - 1));
+
+			boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+			PackedMap packed(*world);
+			double encode_ms = getElapsedMs(start);
+
+			// Decode in uneven, growing pieces, as chunks of a download would arrive.
+			const char * data = packed.serializeData();
+			size_t length = packed.getLength();
+			PackedMap received;
+			start = boost::posix_time::microsec_clock::universal_time();
+			bool decoded = received.beginStream(length);
+			for (size_t offset = 0, piece = 1; decoded && (offset < length); piece = (piece * 3) + 7)
+			{
+				size_t piece_length = std::min(piece, length - offset);
+				decoded = received.deserializeStream(data + offset, piece_length);
+				offset += piece_length;
+			}
+			decoded = decoded && received.endStream();
+			double decode_ms = getElapsedMs(start);
+
+			const matrix3d_u8_ptr & map = received.getMap();
+			bool same = ( decoded && map && (map->getWidth() == world->getWidth()) &&
+				(map->getHeight() == world->getHeight()) && (map->getDepth() == world->getDepth()) &&
+				(memcmp(map->data(), world->data(), world->getSize()) == 0) );
+
+			std::cout << "  " << std::left << std::setw(22) << MazeConfig::getAlgorithmName(algorithm) <<
+				std::setw(14) << formatSize(sizes[i][0], sizes[i][1], sizes[i][2]) << std::right << " plain " <<
+				std::setw(9) << world->getLength() << "  packed " << std::setw(7) << length << std::fixed <<
+				std::setprecision(1) << "  " << std::setw(5) << (static_cast<double>(world->getLength()) / length) <<
+				"x  encode " << std::setw(7) << encode_ms << " ms  decode " << std::setw(7) << decode_ms << " ms" <<
+				std::endl;
+
+			if (!same)
+			{
+				std::cerr << "ERROR: Benchmark::benchCodec [" << MazeConfig::getAlgorithmName(algorithm) <<
+					" map did not round-trip]" << std::endl;
+				passed = false;
+			}
+
+		}
+	}
+
+	// The decoder reports the truncation itself.
+	std::cout << "  Half of a packed map, which must be rejected:" << std::endl;
+	WallMatrix walls(sizes[0][0], sizes[0][1], sizes[0][2]);
+	MazeGenerator::create(MazeConfig::MA_PRIM, 3)->generate(walls);
+	PackedMap packed(*WorldRenderer::render(walls, Vertex3DEx()));
+	PackedMap truncated;
+	if (truncated.deserializeData(packed.serializeData(), packed.getLength() / 2))
+	{
+		std::cerr << "ERROR: Benchmark::benchCodec [Truncated map was accepted]" << std::endl;
+		passed = false;
+	}
+	return passed;
+}
+
+bool Benchmark::benchFrames()
+{
+	static const size_t player_counts[] = { 2, 8, 64 };
+	static const size_t num_counts = sizeof(player_counts) / sizeof(player_counts[0]);
+	static const size_t num_ticks = 2000;
+	static const int32_t steps[][3] = { { -2, 0, 0 }, { 2, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 },
+		{ 0, 0, 1 } };
+
+	std::cout << "  " << num_ticks << " ticks of random walks, headers included, against per-move updates and " <<
+		"fixed 16-byte entries" << std::endl;
+	bool passed = true;
+	for (size_t c = 0; c < num_counts; ++c)
+	{
+		for (uint32_t steps_per_tick = 1; steps_per_tick <= 3; steps_per_tick += 2)
+		{
+			// Walk every player first, so only encoding is timed.
+			size_t num_players = player_counts[c];
+			Random random(42);
+			std::vector<Vertex3DEx> positions(num_players * (num_ticks + 1));
+			for (size_t p = 0; p < num_players; ++p)
+			{
+				positions[p] = Vertex3DEx(4 * (random.uniform(500) + 10), 2 * (random.uniform(500) + 10),
+					random.uniform(8));
+			}
+			for (size_t t = 1; t <= num_ticks; ++t)
+			{
+				for (size_t p = 0; p < num_players; ++p)
+				{
+					Vertex3DEx pos = positions[((t - 1) * num_players) + p];
+					for (uint32_t s = 0; s < steps_per_tick; ++s)
+					{
+						// Mostly moves within a level, now and then a stair.
+						uint32_t dir = random.uniform(random.uniform(10) == 0 ? 6 : 4);
+						pos = Vertex3DEx(pos.x + steps[dir][0], pos.y + steps[dir][1], pos.z + steps[dir][2]);
+					}
+					positions[(t * num_players) + p] = pos;
+				}
+			}
+
+			// Encode as the maze does: each player once in full, then as moves, with a keyframe every so often.
+			game_message_vec frames;
+			frames.reserve(num_ticks);
+			boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+			for (size_t t = 1; t <= num_ticks; ++t)
+			{
+				UpdateFrame frame;
+				for (size_t p = 0; p < num_players; ++p)
+				{
+					const Vertex3DEx & pos = positions[(t * num_players) + p];
+					if ( (t == 1) || ((t % Maze::KEYFRAME_INTERVAL) == 0) )
+						frame.addPlayer(static_cast<uint32_t>(p + 1), pos);
+					else
+						frame.addPlayer(static_cast<uint32_t>(p + 1), pos, positions[((t - 1) * num_players) + p]);
+				}
+				frames.push_back(GameMessage(GameMessage::GC_UPDATE_FRAME_NOTIFY, &frame));
+			}
+			double encode_ms = getElapsedMs(start);
+
+			size_t frame_bytes = 0;
+			std::vector<Vertex3DEx> client(num_players);
+			bool same = true;
+			for (size_t t = 1; t <= num_ticks; ++t)
+			{
+				const GameMessage & msg = frames[t - 1];
+				frame_bytes += msg.length();
+				UpdateFrame frame;
+				same = same && frame.deserializeData(msg.body(), msg.bodyLength());
+				for (size_t i = 0; same && (i < frame.getPlayerCount()); ++i)
+				{
+					uint32_t player_id = frame.getPlayerId(i);
+					client[player_id - 1] = frame.getPosition(i, client[player_id - 1]);
+				}
+				for (size_t p = 0; same && (p < num_players); ++p)
+					same = (client[p] == positions[(t * num_players) + p]);
+			}
+
+			size_t update_bytes = num_ticks * num_players * steps_per_tick *
+				(GameMessage::HEADER_SIZE + PlayerSchema::SIZE);
+			size_t fixed_bytes = num_ticks * (GameMessage::HEADER_SIZE + 4 + (16 * num_players));
+			std::cout << "  players " << std::setw(2) << num_players << "  steps/tick " << steps_per_tick <<
+				"  frames " << std::setw(7) << frame_bytes << "  updates " << std::setw(8) << update_bytes << " (" <<
+				std::fixed << std::setprecision(1) << (static_cast<double>(update_bytes) / frame_bytes) <<
+				"x)  fixed " <<
+				std::setw(8) << fixed_bytes << " (" << (static_cast<double>(fixed_bytes) / frame_bytes) << "x)  " <<
+				std::setprecision(2) << (static_cast<double>(frame_bytes - (num_ticks * GameMessage::HEADER_SIZE)) /
+				(num_ticks * num_players)) << " B/player/tick  " << (encode_ms * 1000.0 / num_ticks) << " us/frame" <<
+				std::endl;
+
+			if (!same)
+			{
+				std::cerr << "ERROR: Benchmark::benchFrames [Decoded positions differ from the walk]" << std::endl;
+				passed = false;
+			}
+		}
+	}
+	return passed;
+}
+
+bool Benchmark::benchPool()
+{
+	static const size_t count = 1000000;
+
+	// Threads that each acquire and release their own buffers, as sessions reading messages do.
+	for (size_t num_threads = 1; num_threads <= 4; num_threads *= 2)
+	{
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+		boost::thread_group threads;
+		for (size_t i = 0; i < num_threads; ++i)
+			threads.create_thread(boost::bind(&Benchmark::poolWorker, static_cast<uint64_t>(i + 1), count));
+		threads.join_all();
+		double elapsed_ms = getElapsedMs(start);
+
+		std::cout << "  " << num_threads << " thread(s), own buffers        " << std::fixed << std::setprecision(1) <<
+			std::setw(7) << elapsed_ms << " ms  " << std::setprecision(2) <<
+			((num_threads * count) / (elapsed_ms * 1000.0)) << "M acquire/release pairs/s" << std::endl;
+	}
+
+	// One thread acquiring and another releasing, as a shard broadcasting to sessions does.
+	MpscQueue<message_buffer_ptr> queue;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	boost::thread producer(boost::bind(&Benchmark::poolProducer, boost::ref(queue), count));
+	message_buffer_ptr buffer;
+	for (size_t released = 0; released < count; )
+	{
+		if (queue.pop(buffer))
+		{
+			buffer.reset();
+			++released;
+		}
+		else
+		{
+			boost::this_thread::yield();
+		}
+	}
+	producer.join();
+	double elapsed_ms = getElapsedMs(start);
+
+	std::cout << "  2 threads, one to the other     " << std::fixed << std::setprecision(1) << std::setw(7) <<
+		elapsed_ms << " ms  " << std::setprecision(2) << (count / (elapsed_ms * 1000.0)) <<
+		"M acquire/release pairs/s" << std::endl;
+	return true;
+}
+
+void Benchmark::poolWorker(uint64_t seed, size_t count)
+{
+	// Keep a window of buffers alive, as a session's queue would.
+	static const size_t window = 64;
+	std::vector<message_buffer_ptr> live(window);
+	Random random(seed);
+	for (size_t i = 0; i < count; ++i)
+	{
+		message_buffer_ptr & slot = live[i % window];
+		slot = MessagePool::instance().acquire(16 + random.uniform(2048));
+		slot->data()[0] = static_cast<char>(i);
+	}
+}
+
+void Benchmark::poolProducer(MpscQueue<message_buffer_ptr> & queue, size_t count)
+{
+	Random random(count);
+	for (size_t i = 0; i < count; ++i)
+		queue.push(MessagePool::instance().acquire(16 + random.uniform(2048)));
+}
+
+bool Benchmark::benchMemory()
+{
+	std::cout << "  sizeof(GameMessage) " << sizeof(GameMessage) << " bytes, sizeof(MazeSession) " <<
+		sizeof(MazeSession) << " bytes" << std::endl;
+
+	size_t before = 0;
+	if (!getHeapInUse(before))
+	{
+		std::cout << "  Heap use is not available from this C library." << std::endl;
+		return true;
+	}
+
+	// Sessions are made but never connected, so what they queue stays queued.  They report on the console when
+	// they end, which is left out.
+	static const size_t num_sessions = 1000;
+	static const size_t num_updates = 1000;
+	size_t idle_bytes = 0;
+	size_t player_bytes = 0;
+	size_t move_bytes = 0;
+	std::streambuf * console = std::cout.rdbuf(nullptr);
+	{
+		boost::asio::io_service io_service;
+		MazeServer server(io_service, tcp::endpoint(tcp::v4(), 0), MazeConfig(100, 100, 10), 1, 1,
+			MazeManager::DEF_UPDATE_TICK_MS, SendLimits());
+
+		maze_session_vec sessions;
+		sessions.reserve(num_sessions);
+		getHeapInUse(before);
+		for (size_t i = 0; i < num_sessions; ++i)
+		{
+			sessions.push_back(std::make_shared<MazeSession>(io_service, static_cast<uint32_t>(i + 1),
+				server.getMazeManager(), SendLimits()));
+		}
+		size_t after = 0;
+		getHeapInUse(after);
+		idle_bytes = (after - before) / num_sessions;
+
+		// Broadcast to two sessions, as a two-player maze does: first an update for each of many players, then
+		// moves of one player, which replace each other while they wait.
+		for (size_t pass = 0; pass < 2; ++pass)
+		{
+			getHeapInUse(before);
+			for (size_t i = 0; i < num_updates; ++i)
+			{
+				Player player(static_cast<uint32_t>(pass == 0 ? (i + 1) : 1), Vertex3DEx(i, 1, 0));
+				GameMessage msg(GameMessage::GC_UPDATE_NOTIFY, &player);
+				sessions[0]->write(msg);
+				sessions[1]->write(msg);
+			}
+			getHeapInUse(after);
+			if (pass == 0)
+				player_bytes = (after - before) / num_updates;
+			else
+				move_bytes = (after - before) / num_updates;
+		}
+	}
+	std::cout.rdbuf(console);
+	std::cout.clear();
+
+	std::cout << "  idle session " << idle_bytes << " bytes" << std::endl;
+	std::cout << "  update queued to two sessions: " << player_bytes << " bytes for a new player, " << move_bytes <<
+		" bytes for a later move" << std::endl;
+	return true;
+}
+
+double Benchmark::getElapsedMs(const boost::posix_time::ptime & start)
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+}
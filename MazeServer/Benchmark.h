@@ -0,0 +1,48 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../MazeShared/MessagePool.h"
+
+template <typename T> class MpscQueue;
+
+
+// Fixed workloads behind the performance numbers quoted for the server, run with MazeServer --bench.  Sizes, seeds and
+// thread counts are constant so runs of different builds can be compared; only release builds give meaningful times.
+// Every benchmark also checks its results and fails if they are wrong.
+class Benchmark
+{
+	typedef bool (*bench_func)();
+
+	struct Entry
+	{
+		const char * name;
+		const char * description;
+		bench_func func;
+	};
+
+	static const Entry entries_[];
+	static const size_t NUM_ENTRIES;
+
+public:
+	// Run the named benchmarks in order, or all of them if names is empty.  Returns false for an unknown name or a
+	// failed check.
+	static bool run(const std::vector<std::string> & names);
+
+	static void printNames(std::ostream & os);
+
+private:
+	static bool benchGeneration();
+	static bool benchCodec();
+	static bool benchFrames();
+	static bool benchPool();
+	static bool benchMemory();
+
+	static void poolWorker(uint64_t seed, size_t count);
+	static void poolProducer(MpscQueue<message_buffer_ptr> & queue, size_t count);
+	static double getElapsedMs(const boost::posix_time::ptime & start);
+};
+
+#endif // BENCHMARK_H
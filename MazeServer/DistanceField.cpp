@@ -0,0 +1,61 @@
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "DistanceField.h"
+
+
+void DistanceField::computeAll(const WallMatrix & walls, const std::vector<uint8_t> & moves,
+	const std::vector<uint32_t> & sources, std::vector<DistanceField> & fields)
+{
+	fields.resize(sources.size());
+	if (fields.empty())
+		return;
+
+	// Each search is strictly sequential (a maze is mostly long corridors, so its BFS frontier stays tiny), but
+	// searches from different sources are independent.
+	boost::thread_group threads;
+	for (size_t i = 1; i < sources.size(); ++i)
+		threads.create_thread(boost::bind(&DistanceField::compute, &fields[i], boost::cref(walls), boost::cref(moves),
+			sources[i]));
+	fields[0].compute(walls, moves, sources[0]);
+	threads.join_all();
+}
+
+void DistanceField::compute(const WallMatrix & walls, const std::vector<uint8_t> & moves, uint32_t source)
+{
+	uint32_t total_rooms = walls.getTotalRooms();
+	int32_t row_offset = static_cast<int32_t>(walls.getWidth());
+	int32_t level_offset = static_cast<int32_t>(walls.getWidth() * walls.getHeight());
+
+	// Room offset of each WALL_* direction, indexed by bit number.
+	const int32_t offsets[6] = { -1, 1, -row_offset, row_offset, -level_offset, level_offset };
+
+	distances_.assign(total_rooms, static_cast<uint32_t>(UNREACHED));
+	if (source >= total_rooms)
+		return;
+
+	std::vector<uint32_t> queue(total_rooms);
+	size_t head = 0;
+	size_t tail = 0;
+	queue[tail++] = source;
+	distances_[source] = 0;
+
+	while (head < tail)
+	{
+		uint32_t room = queue[head++];
+		uint32_t next_distance = distances_[room] + 1;
+
+		for (uint8_t open = moves[room]; open; open &= (open - 1))
+		{
+			int bit = 0;
+			while (!(open & (1 << bit)))
+				++bit;
+
+			uint32_t adj_room = static_cast<uint32_t>(static_cast<int32_t>(room) + offsets[bit]);
+			if (distances_[adj_room] == UNREACHED)
+			{
+				distances_[adj_room] = next_distance;
+				queue[tail++] = adj_room;
+			}
+		}
+	}
+}
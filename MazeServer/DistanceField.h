@@ -0,0 +1,29 @@
+#ifndef DISTANCE_FIELD_H
+#define DISTANCE_FIELD_H
+
+#include <cstdint>
+#include <vector>
+#include "../MazeShared/WallMatrix.h"
+
+
+// Breadth-first distances (in moves between rooms) from one source room to every room of a maze.
+// The search walks a table of open directions per room (WallMatrix::WALL_* bits), so it runs in linear time and
+// touches each room exactly once.
+class DistanceField
+{
+public:
+	static const uint32_t UNREACHED = 0xFFFFFFFF;
+
+	// Compute several fields over the same maze at once, one thread per source.
+	static void computeAll(const WallMatrix & walls, const std::vector<uint8_t> & moves,
+		const std::vector<uint32_t> & sources, std::vector<DistanceField> & fields);
+
+	void compute(const WallMatrix & walls, const std::vector<uint8_t> & moves, uint32_t source);
+
+	uint32_t getDistance(uint32_t room) const { return distances_[room]; }
+
+private:
+	std::vector<uint32_t> distances_;
+};
+
+#endif // DISTANCE_FIELD_H
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include "GameShard.h"
+
+
+GameShard::GameShard(size_t index) :
+	index_(index), sleeping_(false), stopping_(false), timers_(getTimeMs()),
+	thread_(boost::bind(&GameShard::run, this))
+{
+}
+
+GameShard::~GameShard()
+{
+	// Commands already queued are run first; the stop command is the last thing the shard does.
+	post(boost::bind(&GameShard::stop, this));
+	thread_.join();
+}
+
+void GameShard::post(const command & cmd)
+{
+	commands_.push(cmd);
+
+	// Only the producer that finds the shard asleep pays for the lock.
+	if (sleeping_.exchange(false))
+	{
+		boost::mutex::scoped_lock lock(wake_mutex_);
+		wake_cond_.notify_one();
+	}
+}
+
+void GameShard::schedule(uint32_t delay_ms, const command & cmd)
+{
+	timers_.add(getTimeMs() + delay_ms, cmd);
+}
+
+uint64_t GameShard::getTimeMs()
+{
+	return boost::chrono::duration_cast<boost::chrono::milliseconds>(
+		boost::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void GameShard::run()
+{
+	while (!stopping_)
+	{
+		size_t count = runBatch();
+		count += runTimers();
+		if (count == 0)
+			sleep();
+	}
+}
+
+size_t GameShard::runBatch()
+{
+	size_t count = 0;
+	command cmd;
+	while ( (count < MAX_BATCH) && !stopping_ && commands_.pop(cmd) )
+	{
+		runCommand(cmd);
+		++count;
+	}
+	return count;
+}
+
+size_t GameShard::runTimers()
+{
+	if (timers_.getCount() == 0)
+		return 0;
+
+	timers_.advance(getTimeMs(), due_timers_);
+	size_t count = due_timers_.size();
+	for (size_t i = 0; i < count; ++i)
+		runCommand(due_timers_[i]);
+	due_timers_.clear();
+	return count;
+}
+
+void GameShard::runCommand(const command & cmd)
+{
+	try
+	{
+		cmd();
+	}
+	catch (const std::exception & e)
+	{
+		std::cerr << "ERROR: GameShard::runCommand [Shard " << index_ << ": " << e.what() << "]" << std::endl;
+	}
+}
+
+void GameShard::sleep()
+{
+	if (!commands_.isEmpty())
+	{
+		// A producer has claimed the head but not yet linked its node; it will be there in a moment.
+		boost::this_thread::yield();
+		return;
+	}
+
+	boost::mutex::scoped_lock lock(wake_mutex_);
+	sleeping_.store(true);
+	if (!commands_.isEmpty())
+	{
+		// Posted between the check above and announcing the sleep; the producer may or may not have seen the flag.
+		sleeping_.store(false);
+		return;
+	}
+
+	uint64_t next_due = timers_.getNextDue();
+	while (sleeping_.load())
+	{
+		if (next_due == TimerWheel::NO_TIMERS)
+		{
+			wake_cond_.wait(lock);
+		}
+		else if (wake_cond_.wait_until(lock, boost::chrono::steady_clock::time_point(
+			boost::chrono::milliseconds(next_due))) == boost::cv_status::timeout)
+		{
+			sleeping_.store(false);
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef GAME_SHARD_H
+#define GAME_SHARD_H
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "MpscQueue.h"
+#include "TimerWheel.h"
+
+
+// A thread that owns a share of the mazes and runs every command for them, one at a time and in the order posted.
+// Since a maze's game state is only ever touched by its shard, it needs no locks of its own.
+// Commands are posted from any thread through a lock-free MpscQueue; the shard drains it in batches and only goes
+// to sleep when it finds it empty.  Delayed commands are kept on the shard's own timer wheel, and the shard sleeps
+// until the next of them is due.
+class GameShard
+{
+public:
+	typedef boost::function<void ()> command;
+
+	static const size_t MAX_BATCH = 256; // Commands run between checks for shutdown
+
+private:
+	size_t index_;
+	MpscQueue<command> commands_;
+	boost::atomic<bool> sleeping_;
+	boost::mutex wake_mutex_;
+	boost::condition_variable wake_cond_;
+	bool stopping_;
+	TimerWheel timers_;
+	TimerWheel::callback_vec due_timers_;
+	boost::thread thread_; // Declared last so that it starts after the queue is set up
+
+public:
+	explicit GameShard(size_t index);
+	~GameShard();
+
+	size_t getIndex() const { return index_; }
+
+	// Safe from any thread.
+	void post(const command & cmd);
+
+	// Run a command on this shard after a delay.  Only for commands already running on the shard.
+	void schedule(uint32_t delay_ms, const command & cmd);
+
+	static uint64_t getTimeMs(); // Monotonic
+
+private:
+	void run();
+	size_t runBatch();
+	size_t runTimers();
+	void runCommand(const command & cmd);
+	void sleep();
+	void stop() { stopping_ = true; }
+
+	// Non-copyable.
+	GameShard(const GameShard &);
+	void operator=(const GameShard &);
+};
+
+#endif // GAME_SHARD_H
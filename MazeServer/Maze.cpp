@@ -1,513 +1,690 @@
-#include <boost/bind.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
-#include <limits>
-#include "Maze.h"
-#include "MazeSession.h"
-#include "AIAgent.h"
-
-
-Maze::Maze() :
-  maze_matrix_(nullptr), world_matrix_(nullptr), game_in_progress_(false)
-{
-}
-
-Maze::~Maze()
-{
-	delete maze_matrix_;
-	delete world_matrix_;
-}
-
-void Maze::displayWorldMatrix(int level /* = -1 */) const
-{
-	if (level == -1)
-	{
-		for (uint32_t z = 0; z < world_matrix_->getDepth(); ++z)
-			std::cout << world_matrix_->ptr(0, 0, z) << std::endl;
-	}
-	else
-	{
-		std::cout << world_matrix_->ptr(0, 0, level) << std::endl;
-	}
-}
-
-void Maze::buildMaze(const MazeConfig & config)
-{
-	config_ = config;
-
-	// Build 3D matrix with all "rooms" having all 6 walls and flagged as not explored.
-	uint8_t init_value = MAZE_LEFT | MAZE_RIGHT | MAZE_UP | MAZE_DOWN | MAZE_BOTTOM | MAZE_TOP;
-	maze_matrix_ = new matrix3d_u8(config_.width, config_.height, config_.levels, init_value);
-
-	// Load initial room and initiate modified Prim's algorithm.
-	rooms_.push_back(Vertex3DEx(config_.width / 2, config_.height / 2, config_.levels / 2));
-
-	while (rooms_.size() > 0)
-	{
-		// Randomly select next room and mark it explored.
-		int index = (rand() % rooms_.size());
-		Vertex3DEx curr_room = rooms_[index];
-		maze_matrix_->at(curr_room) |= MAZE_EXPLORED;
-
-		// Load adjacent, unexplored rooms for future processing.
-		// Also locally track adjacent, explored rooms.
-		vertex3d_vec explored_verts;
-		if (curr_room.x > 0)
-		{
-			processProspectiveRoom(Vertex3DEx(curr_room.x - 1, curr_room.y, curr_room.z, MAZE_LEFT), explored_verts);	
-		}
-		if (curr_room.x < (config_.width - 1))
-		{
-			processProspectiveRoom(Vertex3DEx(curr_room.x + 1, curr_room.y, curr_room.z, MAZE_RIGHT), explored_verts);
-		}
-		if (curr_room.y > 0)
-		{
-			processProspectiveRoom(Vertex3DEx(curr_room.x, curr_room.y - 1, curr_room.z, MAZE_UP), explored_verts);
-		}
-		if (curr_room.y < (config_.height - 1))
-		{
-			processProspectiveRoom(Vertex3DEx(curr_room.x, curr_room.y + 1, curr_room.z, MAZE_DOWN), explored_verts);
-		}
-		if (curr_room.z > 0)
-		{
-			processProspectiveRoom(Vertex3DEx(curr_room.x, curr_room.y, curr_room.z - 1, MAZE_BOTTOM), explored_verts);
-		}
-		if (curr_room.z < (config_.levels - 1))
-		{
-			processProspectiveRoom(Vertex3DEx(curr_room.x, curr_room.y, curr_room.z + 1, MAZE_TOP), explored_verts);
-		}
-		
-		if (explored_verts.size() > 0)
-		{
-			// Randomly select adjacent, explored room to connect.
-			int adj_index = (rand() % explored_verts.size());
-			Vertex3DEx & curr_adj = explored_verts[adj_index];
-
-			// Extract direction from extra field and remove the appropriate walls from both rooms.
-			uint8_t extra = static_cast<uint8_t>(curr_adj.extra);
-			uint8_t opposite_wall = getOppositeWall(extra);
-			maze_matrix_->at(curr_room) &= ~extra;
-			maze_matrix_->at(curr_adj) &= ~opposite_wall;
-		}
-
-		// Remove the room we just processed.
-		rooms_.erase(rooms_.begin() + index);
-	}
-
-	world_matrix_ = new matrix3d_u8( (config_.width * 4) + 2, (config_.height * 2) + 1, config_.levels, ' ' );
-
-	// Build edges.
-	uint8_t * ptr = nullptr;
-	for (uint32_t z = 0; z < config_.levels; ++z)
-	{
-		for (uint32_t y = 0; y < config_.height; ++y)
-		{
-			for (uint32_t x = 0; x < config_.width; ++x)
-			{
-				uint8_t curr_room = maze_matrix_->at(x, y, z);
-
-				// Top edge?
-				if ( (y == 0) || (curr_room & MAZE_UP) )
-				{
-					ptr = world_matrix_->ptr((x * 4) + 1, (y * 2), z);
-					for (int i = 0; i < 3; ++i)
-						*ptr++ = 205;
-				}
-
-				// Left edge.
-				if ( (x == 0) || (curr_room & MAZE_LEFT) )
-					world_matrix_->at((x * 4), (y * 2) + 1, z) = 186;
-
-				if (x == (config_.width - 1))
-				{
-					// Right edge.
-					world_matrix_->at(((x + 1) * 4), (y * 2) + 1, z) = 186;
-				}
-
-				if (y == (config_.height - 1))
-				{
-					// Bottom edge.
-					ptr = world_matrix_->ptr((x * 4) + 1, ((y + 1) * 2), z);
-					for (int i = 0; i < 3; ++i)
-						*ptr++ = 205;
-				}
-
-				// Staircases.
-				bool down = false;
-				bool up = false;
-				if ( (curr_room & MAZE_BOTTOM) == 0 )
-					down = true;
-				if ( (curr_room & MAZE_TOP) == 0 )
-					up = true;
-
-				if (up && down)
-					world_matrix_->at((x * 4) + 2, (y * 2) + 1, z) = 'X';
-				else if (up)
-					world_matrix_->at((x * 4) + 2, (y * 2) + 1, z) = '/';
-				else if (down)
-					world_matrix_->at((x * 4) + 2, (y * 2) + 1, z) = '\\';
-			}
-		}
-	}
-
-	// Build corners.
-	bool up, down, left, right;
-	for (uint32_t z = 0; z < world_matrix_->getDepth(); ++z)
-	{
-		for (uint32_t y = 0; y < world_matrix_->getHeight(); y += 2)
-		{
-			for (uint32_t x = 0; x < world_matrix_->getWidth(); x += 4)
-			{
-				// Collect surrounding edges.
-				if ( (x == 0) || (world_matrix_->at(x - 1, y, z) == ' ') )
-					left = false;
-				else
-					left = true;
-
-				if ( (x == (world_matrix_->getWidth() - 1)) || (world_matrix_->at(x + 1, y, z) == ' ') )
-					right = false;
-				else
-					right = true;
-
-				if ( (y == 0) || (world_matrix_->at(x, y - 1, z) == ' ') )
-					up = false;
-				else
-					up = true;
-
-				if ( (y == (world_matrix_->getHeight() - 1)) || (world_matrix_->at(x, y + 1, z) == ' ') )
-					down = false;
-				else
-					down = true;
-
-				// Select appropriate corner.
-				uint8_t corner_value = 0;
-				if (left && right && up && down)
-					corner_value = 206;
-				else if (left && right && up)
-					corner_value = 202;
-				else if (left && right && down)
-					corner_value = 203;
-				else if (left && up && down)
-					corner_value = 185;
-				else if (right && up && down)
-					corner_value = 204;
-				else if (left && up)
-					corner_value = 188;
-				else if (left && down)
-					corner_value = 187;
-				else if (right && up)
-					corner_value = 200;
-				else if (right && down)
-					corner_value = 201;
-				else if (left || right)
-					corner_value = 205;
-				else
-					corner_value = 186;
-
-				world_matrix_->at(x, y, z) = corner_value;
-			}
-
-			if (y < (world_matrix_->getHeight() - 1))
-			{
-				world_matrix_->at((config_.width * 4) + 1, y, z) = '\n';
-				world_matrix_->at((config_.width * 4) + 1, y + 1, z) = '\n';
-			}
-			else
-				world_matrix_->at((config_.width * 4) + 1, y, z) = '\0';
-		}
-	}
-
-	// Set goal.
-	// Spiral out from center until we find an empty room to avoid wiping out stairways.
-	Vertex3DEx goal(((config_.width / 2) * 4) + 2,
-					((config_.height / 2) * 2) + 1,
-					config_.levels - 1);
-	uint8_t dir = MAZE_DOWN;
-	uint8_t steps = 0;
-	uint8_t curr_step = 0;
-	while (world_matrix_->at(goal) != ' ')
-	{
-		if (!curr_step)
-		{
-			switch (dir)
-			{
-			case (MAZE_DOWN):
-				dir = MAZE_LEFT;
-				curr_step = ++steps;
-				break;
-			case (MAZE_LEFT):
-				dir = MAZE_UP;
-				curr_step = steps;
-				break;
-			case (MAZE_UP):
-				dir = MAZE_RIGHT;
-				curr_step = ++steps;
-				break;
-			case (MAZE_RIGHT):
-				dir = MAZE_DOWN;
-				curr_step = steps;
-				break;
-			}
-		}
-
-		--curr_step;
-
-		switch (dir)
-		{
-		case (MAZE_LEFT):
-			goal.x -= 4;
-			break;
-		case (MAZE_UP):
-			goal.y -= 2;
-			break;
-		case (MAZE_RIGHT):
-			goal.x += 4;
-			break;
-		case (MAZE_DOWN):
-			goal.y += 2;
-			break;
-		}
-	}
-	world_matrix_->at(goal) = 234;
-
-	goal_.x = (goal.x - 2) / 4;
-	goal_.y = (goal.y - 1) / 2;
-	goal_.z = goal.z;
-}
-
-bool Maze::joinMaze(const maze_session_ptr & session, uint32_t num_players)
-{
-	if (game_in_progress_)
-		return false;
-
-	if (sessions_.size() >= num_players)
-		return false;
-
-	sessions_.push_back(session);
-
-	Vertex3DEx pos(2, 1, 0);
-	if (sessions_.size() == MAX_PLAYERS)
-	{
-		pos.x = world_matrix_->getWidth() - 4;
-		pos.y = world_matrix_->getHeight() - 2;
-	}
-
-	uint32_t id = session->getPlayerId();
-	{
-		boost::mutex::scoped_lock lock(players_mutex_);
-		players_[id] = std::make_shared<Player>(id, pos);
-	}
-
-	if (sessions_.size() == num_players)
-	{
-		game_in_progress_ = true;
-
-		if (num_players == 1)
-		{
-			ai_thread_ = boost::thread(boost::bind(&Maze::processAI, this));
-		}
-
-		GameMessage msg(GameMessage::GC_START_NOTIFY, world_matrix_);
-		broadcast(msg);
-
-		{
-			boost::mutex::scoped_lock lock(players_mutex_);
-			for (player_map::iterator it = players_.begin(); it != players_.end(); ++it)
-			{
-				GameMessage msg(GameMessage::GC_UPDATE_NOTIFY, ((*it).second).get());
-				broadcast(msg);
-			}
-		}
-	}
-	else
-	{
-		GameSelectResp select_resp(GameSelectResp::SR_WAIT);
-		GameMessage msg(GameMessage::GC_SELECT_GAME_RESP, &select_resp);
-		session->write(msg);
-	}
-
-	return true;
-}
-
-void Maze::leaveMaze(const maze_session_ptr & session)
-{
-	{
-		boost::mutex::scoped_lock lock(players_mutex_);
-		players_.erase(session->getPlayerId());
-	}
-
-	maze_session_vec::iterator pos = std::find(sessions_.begin(), sessions_.end(), session);
-	if (pos != sessions_.end())
-		sessions_.erase(pos);
-
-	if (sessions_.size() == 0) 
-	{
-		joinAIThread();
-
-		{
-			boost::mutex::scoped_lock lock(players_mutex_);
-			players_.clear();
-		}
-
-		game_in_progress_ = false;
-	}
-}
-
-bool Maze::movePlayer(uint32_t player_id, const move_req_ptr & req, bool * won /* = nullptr */)
-{
-	Vertex3DEx pos;
-	{
-		boost::mutex::scoped_lock lock(players_mutex_);
-		if (!players_[player_id])
-			return false;
-		pos = players_[player_id]->getPosition();
-	}
-	uint8_t local_char = world_matrix_->at(pos);
-
-	switch (req->getMoveDir())
-	{
-	case MoveReq::MD_LEFT:
-		pos.x -= 2;
-		break;
-	case MoveReq::MD_RIGHT:
-		pos.x += 2;
-		break;
-	case MoveReq::MD_UP:
-		pos.y--;
-		break;
-	case MoveReq::MD_DOWN:
-		pos.y++;
-		break;
-	case MoveReq::MD_BOTTOM:
-		pos.z--;
-		if ( (local_char != '\\') && (local_char != 'X') )
-			return false;
-		break;
-	case MoveReq::MD_TOP:
-		pos.z++;
-		if ( (local_char != '/') && (local_char != 'X') )
-			return false;
-		break;
-	}
-
-	bool win_ = false;
-	if (world_matrix_->at(pos) == 234)
-		win_ = true;
-	else if (world_matrix_->at(pos) >= 127)
-		return false;
-
-	{
-		boost::mutex::scoped_lock lock(players_mutex_);
-
-		for (player_map::iterator it = players_.begin(); it != players_.end(); ++it)
-			if ( ((*it).first != player_id) && (((*it).second)->getPosition() == pos) )
-				return false;
-
-		players_[player_id]->getPosition() = pos;
-
-		GameMessage msg(GameMessage::GC_UPDATE_NOTIFY, players_[player_id].get());
-		broadcast(msg);
-	}
-
-	if (win_)
-	{
-		Winner winner(player_id);
-		GameMessage msg(GameMessage::GC_WINNER_NOTIFY, &winner);
-		broadcast(msg);
-
-		if (won)
-			*won = true;
-	}
-
-	return true;
-}
-
-void Maze::processAI()
-{
-	std::cout << "DEBUG: Starting Maze::processAI" << std::endl;
-
-	AIAgent agent(0, *this);
-
-	{
-		boost::mutex::scoped_lock lock(players_mutex_);
-		players_[agent.getPlayerId()] = agent.getPlayer();
-	}
-
-	GameMessage msg(GameMessage::GC_UPDATE_NOTIFY, agent.getPlayer().get());
-	broadcast(msg);
-
-	while (true)
-    {
-        try
-        {
-			if (agent.handleTick())
-				break;
-
-            boost::this_thread::sleep(boost::posix_time::milliseconds(100));
-        }
-        catch(boost::thread_interrupted &)
-        {
-			std::cout << "DEBUG: Ending Maze::processAI" << std::endl;
-            return;
-        }
-    }
-
-	clearSessions();
-}
-
-void Maze::joinAIThread()
-{
-	if (ai_thread_.joinable())
-	{
-		ai_thread_.interrupt();
-		ai_thread_.join();
-	}
-}
-
-uint8_t Maze::getOppositeWall(const uint8_t dir)
-{
-	switch (dir)
-	{
-	case MAZE_NONE: return MAZE_NONE;
-	case MAZE_LEFT:	return MAZE_RIGHT;
-	case MAZE_RIGHT: return MAZE_LEFT;
-	case MAZE_UP: return MAZE_DOWN;
-	case MAZE_DOWN: return MAZE_UP;
-	case MAZE_BOTTOM: return MAZE_TOP;
-	case MAZE_TOP: return MAZE_BOTTOM;
-	default:
-		throw std::runtime_error("Maze::getOppositeWall: [Unexpected input]");
-	}
-}
-
-void Maze::processProspectiveRoom(const Vertex3DEx & prospect_vert, vertex3d_vec & explored_verts)
-{
-	uint8_t & room = maze_matrix_->at(prospect_vert);
-	if (room & MAZE_EXPLORED)
-	{
-		explored_verts.push_back(prospect_vert);
-	}
-	else if ( (room & MAZE_LOADED) == 0 )
-	{
-		room |= MAZE_LOADED;
-		rooms_.push_back(prospect_vert);
-	}	
-}
-
-void Maze::broadcast(const GameMessage & msg) const
-{
-	for (size_t i = 0; i < sessions_.size(); ++i)
-	{
-		sessions_[i]->write(msg);
-	}
-}
-
-void Maze::clearSessions()
-{
-	{
-		boost::mutex::scoped_lock lock(players_mutex_);
-		players_.clear();
-	}
-	sessions_.clear();
-
-	game_in_progress_ = false;
-}
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <limits>
+#include "Maze.h"
+#include "MazeSession.h"
+#include "AIAgent.h"
+#include "DistanceField.h"
+#include "MazeFile.h"
+#include "../MazeShared/MapCodec.h"
+#include "../MazeShared/MessageSchema.h"
+#include "../MazeShared/WorldRenderer.h"
+
+
+Maze::Maze(GameShard & shard, WorkerPool & workers) :
+  maze_matrix_(nullptr), reproducible_(false), frames_since_keyframe_(0), game_in_progress_(false),
+  start_pending_(false), num_players_(0), selection_(0), shard_(shard), workers_(workers), ai_game_(0)
+{
+	for (int map = 0; map < WM_MAX; ++map)
+		world_building_[map] = false;
+}
+
+Maze::~Maze()
+{
+	delete maze_matrix_;
+}
+
+void Maze::displayWorldMatrix(int level /* = -1 */) const
+{
+	std::unique_ptr<matrix3d_u8> world_matrix = renderWorldMatrix();
+	if (level == -1)
+	{
+		for (uint32_t z = 0; z < world_matrix->getDepth(); ++z)
+			std::cout << world_matrix->ptr(0, 0, z) << std::endl;
+	}
+	else
+	{
+		std::cout << world_matrix->ptr(0, 0, level) << std::endl;
+	}
+}
+
+void Maze::buildMaze(const MazeConfig & config)
+{
+	config_ = config;
+
+	// Build 3D matrix with all "rooms" having all 6 walls.
+	maze_matrix_ = new WallMatrix(config_.width, config_.height, config_.levels);
+
+	// Carve passages with the configured algorithm.
+	maze_generator_ptr generator = MazeGenerator::create(config_.algorithm, config_.seed);
+	generator->generate(*maze_matrix_);
+	gen_stats_ = generator->getStats();
+	reproducible_ = MazeGenerator::isReproducible(config_.algorithm);
+	start_msgs_ = StartMessages();
+
+	buildMoves();
+	placeGoal();
+}
+
+bool Maze::loadMaze(const std::string & path, const MazeConfig & max_config)
+{
+	MazeFileReader reader;
+	if (!reader.open(path))
+		return false;
+
+	if (!reader.getConfig().isWithin(max_config))
+	{
+		std::cerr << "ERROR: Maze::loadMaze [" << path << " exceeds server limits]" << std::endl;
+		reader.getConfig().print();
+		return false;
+	}
+
+	// A saved maze may not match what its configuration would generate now, so it is always sent in full.
+	config_ = reader.getConfig();
+	reproducible_ = false;
+	start_msgs_ = StartMessages();
+	maze_matrix_ = new WallMatrix(config_.width, config_.height, config_.levels);
+
+	// Page the file in one level at a time and pack it into the maze matrix.  The outer walls on the +x, +y and +z
+	// sides are stored like any other, so they are forced on: a damaged file must not let a player walk off the maze.
+	uint32_t level_size = config_.width * config_.height;
+	std::vector<uint8_t> level(level_size);
+	size_t forced_walls = 0;
+	for (uint32_t z = 0; z < config_.levels; ++z)
+	{
+		if (!reader.readLevel(z, &level[0]))
+			return false;
+
+		for (uint32_t i = 0; i < level_size; ++i)
+		{
+			uint8_t walls = level[i];
+			if ((i % config_.width) == (config_.width - 1))
+				walls |= WallMatrix::WALL_RIGHT;
+			if (i >= (level_size - config_.width))
+				walls |= WallMatrix::WALL_DOWN;
+			if (z == (config_.levels - 1))
+				walls |= WallMatrix::WALL_TOP;
+			if (walls != level[i])
+				++forced_walls;
+
+			maze_matrix_->setWalls((z * level_size) + i, walls);
+		}
+	}
+	if (forced_walls)
+	{
+		std::cerr << "WARNING: Maze::loadMaze [" << path << " has " << forced_walls <<
+			" room(s) open to the outside; walls restored]" << std::endl;
+	}
+
+	buildMoves();
+	placeGoal();
+	return true;
+}
+
+void Maze::buildMoves()
+{
+	// Precompute the open directions of every room so that move validation is a single table lookup.
+	moves_.resize(maze_matrix_->getTotalRooms());
+	for (uint32_t z = 0, room = 0; z < config_.levels; ++z)
+	{
+		for (uint32_t y = 0; y < config_.height; ++y)
+		{
+			for (uint32_t x = 0; x < config_.width; ++x, ++room)
+				moves_[room] = static_cast<uint8_t>(~maze_matrix_->getWalls(x, y, z) & WallMatrix::ALL_WALLS);
+		}
+	}
+}
+
+void Maze::placeGoal()
+{
+	// Distances from both start rooms, searched concurrently.
+	std::vector<uint32_t> sources;
+	for (uint32_t i = 0; i < MAX_PLAYERS; ++i)
+	{
+		Vertex3DEx start = getStart(i);
+		sources.push_back(maze_matrix_->getIndex(start.x, start.y, start.z));
+	}
+	std::vector<DistanceField> start_distances;
+	DistanceField::computeAll(*maze_matrix_, moves_, sources, start_distances);
+
+	// The goal is the room farthest from the nearer start, preferring rooms that are equally far from both.
+	// Rooms with stairwells are skipped since the goal marker would hide the stairs.
+	uint32_t goal_room = sources[0];
+	uint32_t best_near = 0;
+	uint32_t best_gap = std::numeric_limits<uint32_t>::max();
+	for (uint32_t room = 0; room < maze_matrix_->getTotalRooms(); ++room)
+	{
+		if (moves_[room] & (MAZE_BOTTOM | MAZE_TOP))
+			continue;
+
+		uint32_t near_dist = start_distances[0].getDistance(room);
+		uint32_t far_dist = start_distances[1].getDistance(room);
+		if (near_dist > far_dist)
+			std::swap(near_dist, far_dist);
+		if (far_dist == DistanceField::UNREACHED)
+			continue;
+
+		uint32_t gap = far_dist - near_dist;
+		if ( (near_dist > best_near) || ((near_dist == best_near) && (gap < best_gap)) )
+		{
+			goal_room = room;
+			best_near = near_dist;
+			best_gap = gap;
+		}
+	}
+
+	uint32_t level_size = config_.width * config_.height;
+	goal_ = Vertex3DEx(goal_room % config_.width, (goal_room % level_size) / config_.width, goal_room / level_size);
+}
+
+Vertex3DEx Maze::getStart(uint32_t index) const
+{
+	if (index == 0)
+		return Vertex3DEx(0, 0, 0);
+	return Vertex3DEx(config_.width - 1, config_.height - 1, 0);
+}
+
+std::unique_ptr<matrix3d_u8> Maze::renderWorldMatrix() const
+{
+	return WorldRenderer::render(*maze_matrix_, goal_);
+}
+
+bool Maze::joinMaze(const maze_session_ptr & session, uint32_t selection, uint32_t num_players)
+{
+	if (game_in_progress_)
+		return false;
+
+	if (sessions_.size() >= num_players)
+		return false;
+
+	// Only a client that takes the ASCII map is limited by its size; the seed and wall maps stay small.
+	if ( needsWorldMatrix(session, true) && !fitsWorldMatrix() )
+	{
+		std::cerr << "ERROR: Maze::joinMaze [World matrix exceeds maximum message size; Player " <<
+			session->getPlayerId() << " cannot take the seed or wall map]" << std::endl;
+		return false;
+	}
+
+	sessions_.push_back(session);
+	selection_ = selection;
+
+	Vertex3DEx pos = getWorldPosition(getStart(static_cast<uint32_t>(sessions_.size() - 1)));
+
+	uint32_t id = session->getPlayerId();
+	players_[id] = std::make_shared<Player>(id, pos);
+
+	// Start on the ASCII map now, so it is likely ready by the time the game fills.
+	if (needsWorldMatrix(session, true))
+		requestWorldMap(getWorldMap(session));
+
+	if (sessions_.size() == num_players)
+	{
+		game_in_progress_ = true;
+		num_players_ = num_players;
+		if (isStartReady())
+			startGame();
+		else
+			start_pending_ = true;
+	}
+	else
+	{
+		MessageBuilder<SelectRespSchema> resp;
+		session->write(resp.set<SelectRespSchema::SelectResp>(GameSelectResp::SR_WAIT).getMessage());
+	}
+
+	return true;
+}
+
+void Maze::startGame()
+{
+	if (num_players_ == 1)
+	{
+		ai_agent_.reset(new AIAgent(0, *this));
+		players_[ai_agent_->getPlayerId()] = ai_agent_->getPlayer();
+		scheduleAIMove();
+	}
+
+	for (size_t i = 0; i < sessions_.size(); ++i)
+		sendStart(sessions_[i], true);
+
+	for (player_map::iterator it = players_.begin(); it != players_.end(); ++it)
+		queueUpdate((*it).first, ((*it).second)->getPosition());
+	sendUpdates();
+}
+
+void Maze::sendMap(const maze_session_ptr & session)
+{
+	if ( !game_in_progress_ || start_pending_ ||
+		(std::find(sessions_.begin(), sessions_.end(), session) == sessions_.end()) )
+		return;
+
+	// The client could not regenerate the maze from its seed, so this time send the map itself.
+	if ( needsWorldMatrix(session, false) && !fitsWorldMatrix() )
+	{
+		std::cerr << "ERROR: Maze::sendMap [World matrix exceeds maximum message size; Player " <<
+			session->getPlayerId() << " cannot take the wall map]" << std::endl;
+		return;
+	}
+	sendStart(session, false);
+}
+
+void Maze::leaveMaze(const maze_session_ptr & session)
+{
+	players_.erase(session->getPlayerId());
+	pending_updates_.erase(session->getPlayerId());
+	sent_positions_.erase(session->getPlayerId());
+
+	maze_session_vec::iterator pos = std::find(sessions_.begin(), sessions_.end(), session);
+	if (pos != sessions_.end())
+		sessions_.erase(pos);
+
+	if (sessions_.size() == 0) 
+	{
+		stopAI();
+
+		players_.clear();
+		pending_updates_.clear();
+		sent_positions_.clear();
+		frames_since_keyframe_ = 0;
+		game_in_progress_ = false;
+		start_pending_ = false;
+	}
+	else if (start_pending_)
+	{
+		// The game had filled but not started, so it goes back to waiting for players rather than starting short.
+		game_in_progress_ = false;
+		start_pending_ = false;
+	}
+}
+
+bool Maze::movePlayer(uint32_t player_id, MoveReq::eMoveDir dir, bool * won /* = nullptr */)
+{
+	char step = static_cast<char>(dir);
+	return movePlayer(player_id, &step, 1, won);
+}
+
+bool Maze::movePlayer(uint32_t player_id, const char * steps, size_t num_steps, bool * won /* = nullptr */)
+{
+	// The whole path is checked and applied in one pass, and the player's final position goes out as a single update.
+	Vertex3DEx goal_pos = getWorldPosition(goal_);
+	bool win = false;
+
+	player_map::iterator player = players_.find(player_id);
+	if ( (player == players_.end()) || !(*player).second )
+		return false;
+
+	Vertex3DEx start = ((*player).second)->getPosition();
+	Vertex3DEx pos = start;
+	for (size_t i = 0; (i < num_steps) && !win; ++i)
+	{
+		uint8_t dir = moveDirToMazeDir(PathReq::getStepDir(steps[i]));
+		if (!stepPlayer(player_id, pos, dir))
+			break;
+
+		if (PathReq::isRun(steps[i]))
+			runPlayer(player_id, pos, dir);
+
+		win = (pos == goal_pos);
+	}
+
+	if (pos == start)
+		return false;
+
+	((*player).second)->getPosition() = pos;
+	queueUpdate(player_id, pos);
+
+	if (win)
+	{
+		// The winning move goes out ahead of the winner notification.
+		sendUpdates();
+		broadcast(MessageBuilder<WinnerSchema>().set<WinnerSchema::WinnerId>(player_id).getMessage());
+
+		if (won)
+			*won = true;
+	}
+
+	return true;
+}
+
+uint8_t Maze::getOpenMoves(const Vertex3DEx & pos) const
+{
+	// Players move in half-room steps through world coordinates: room centres sit at (4x + 2, 2y + 1), and the
+	// doorways between rooms lie on the wall lines in between.  From a centre, any open wall of the room is a legal
+	// move; from a doorway, only the two rooms it connects are.
+	bool centre_x = ((pos.x % 4) == 2);
+	bool centre_y = ((pos.y % 2) == 1);
+	if (centre_x && centre_y)
+		return moves_[maze_matrix_->getIndex((pos.x - 2) / 4, (pos.y - 1) / 2, pos.z)];
+	else if (centre_y)
+		return (MAZE_LEFT | MAZE_RIGHT);
+	else if (centre_x)
+		return (MAZE_UP | MAZE_DOWN);
+	return MAZE_NONE;
+}
+
+bool Maze::stepPlayer(uint32_t player_id, Vertex3DEx & pos, uint8_t dir) const
+{
+	if (!(getOpenMoves(pos) & dir))
+		return false;
+
+	Vertex3DEx next = pos;
+	switch (dir)
+	{
+	case MAZE_LEFT: next.x -= 2; break;
+	case MAZE_RIGHT: next.x += 2; break;
+	case MAZE_UP: next.y--; break;
+	case MAZE_DOWN: next.y++; break;
+	case MAZE_BOTTOM: next.z--; break;
+	case MAZE_TOP: next.z++; break;
+	default:
+		return false;
+	}
+
+	for (player_map::const_iterator it = players_.begin(); it != players_.end(); ++it)
+		if ( ((*it).first != player_id) && (((*it).second)->getPosition() == next) )
+			return false;
+
+	pos = next;
+	return true;
+}
+
+void Maze::runPlayer(uint32_t player_id, Vertex3DEx & pos, uint8_t dir) const
+{
+	// Carry on through doorways and around bends; stop in any room that offers a choice, a stairwell or no way on.
+	Vertex3DEx goal_pos = getWorldPosition(goal_);
+	for (uint32_t i = 0; (i < MAX_RUN_STEPS) && (pos != goal_pos); ++i)
+	{
+		if ( ((pos.x % 4) == 2) && ((pos.y % 2) == 1) )
+		{
+			uint8_t open = static_cast<uint8_t>(getOpenMoves(pos) & ~getOppositeWall(dir));
+			if ( !open || (open & (open - 1)) || (open & (MAZE_BOTTOM | MAZE_TOP)) )
+				return;
+			dir = open;
+		}
+
+		if (!stepPlayer(player_id, pos, dir))
+			return;
+	}
+}
+
+void Maze::flushUpdates()
+{
+	sendUpdates();
+}
+
+void Maze::scheduleAIMove()
+{
+	shard_.schedule(ai_agent_->getMoveDelay(), boost::bind(&Maze::handleAIMove, this, ai_game_));
+}
+
+void Maze::handleAIMove(uint32_t ai_game)
+{
+	if ( (ai_game != ai_game_) || !ai_agent_ )
+		return;
+
+	if (ai_agent_->processMove())
+	{
+		stopAI();
+		clearSessions();
+		return;
+	}
+
+	scheduleAIMove();
+}
+
+void Maze::stopAI()
+{
+	// Shard timers cannot be cancelled, so the game count is moved on and the pending move finds itself stale.
+	ai_agent_.reset();
+	++ai_game_;
+}
+
+uint8_t Maze::getOppositeWall(const uint8_t dir)
+{
+	switch (dir)
+	{
+	case MAZE_NONE: return MAZE_NONE;
+	case MAZE_LEFT:	return MAZE_RIGHT;
+	case MAZE_RIGHT: return MAZE_LEFT;
+	case MAZE_UP: return MAZE_DOWN;
+	case MAZE_DOWN: return MAZE_UP;
+	case MAZE_BOTTOM: return MAZE_TOP;
+	case MAZE_TOP: return MAZE_BOTTOM;
+	default:
+		throw std::runtime_error("Maze::getOppositeWall: [Unexpected input]");
+	}
+}
+
+bool Maze::needsWorldMatrix(const maze_session_ptr & session, bool allow_seed) const
+{
+	if ( allow_seed && reproducible_ && session->hasCapability(Capabilities::CAP_SEED_MAP) )
+		return false;
+	return !session->hasCapability(Capabilities::CAP_WALL_MAP);
+}
+
+bool Maze::fitsWorldMatrix() const
+{
+	uint64_t world_length = matrix3d_u8::HEADER_SIZE +
+		(static_cast<uint64_t>((config_.width * 4) + 2) * ((config_.height * 2) + 1) * config_.levels);
+	return (world_length <= GameMessage::MAX_PAYLOAD_SIZE);
+}
+
+Maze::eWorldMap Maze::getWorldMap(const maze_session_ptr & session)
+{
+	return (session->hasCapability(Capabilities::CAP_PACKED_MAP) ? WM_PACKED : WM_PLAIN);
+}
+
+bool Maze::isStartReady()
+{
+	bool ready = true;
+	for (size_t i = 0; i < sessions_.size(); ++i)
+	{
+		if (!needsWorldMatrix(sessions_[i], true))
+			continue;
+
+		eWorldMap map = getWorldMap(sessions_[i]);
+		if (!start_msgs_.world[map])
+		{
+			requestWorldMap(map);
+			ready = false;
+		}
+	}
+	return ready;
+}
+
+void Maze::requestWorldMap(eWorldMap map)
+{
+	if ( start_msgs_.world[map] || world_building_[map] )
+		return;
+
+	world_building_[map] = true;
+	workers_.post(boost::bind(&Maze::buildWorldMap, shared_from_this(), map));
+}
+
+void Maze::buildWorldMap(eWorldMap map)
+{
+	// Only the wall matrix and the goal are read, and neither changes once the maze is shared.
+	message_frames_ptr frames;
+	try
+	{
+		std::unique_ptr<matrix3d_u8> world_matrix = renderWorldMatrix();
+		if (map == WM_PACKED)
+		{
+			PackedMap packed_map(*world_matrix);
+			frames = MessageChunker::split(GameMessage(GameMessage::GC_PACKED_START_NOTIFY, &packed_map));
+		}
+		else
+		{
+			frames = MessageChunker::split(GameMessage(GameMessage::GC_START_NOTIFY, world_matrix.get()));
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cerr << "ERROR: Maze::buildWorldMap [" << e.what() << "]" << std::endl;
+	}
+
+	shard_.post(boost::bind(&Maze::handleWorldMapBuilt, shared_from_this(), map, frames));
+}
+
+void Maze::handleWorldMapBuilt(eWorldMap map, message_frames_ptr frames)
+{
+	world_building_[map] = false;
+	maze_session_vec waiting;
+	waiting.swap(world_waiting_[map]);
+
+	if (!frames)
+	{
+		// Without the map, the sessions that asked for it and those of a game yet to start that need it are turned
+		// away; leaving puts a game that has not started back to waiting for players.
+		for (size_t i = 0; i < sessions_.size(); )
+		{
+			maze_session_ptr session = sessions_[i];
+			if ( (std::find(waiting.begin(), waiting.end(), session) != waiting.end()) ||
+				((!game_in_progress_ || start_pending_) && needsWorldMatrix(session, true) &&
+				(getWorldMap(session) == map)) )
+			{
+				std::cerr << "ERROR: Maze::handleWorldMapBuilt [No map for Player " << session->getPlayerId() << "]" <<
+					std::endl;
+				leaveMaze(session);
+				session->joinFailed(selection_);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+	else
+	{
+		start_msgs_.world[map] = frames;
+		for (maze_session_vec::iterator it = waiting.begin(); it != waiting.end(); ++it)
+		{
+			if (std::find(sessions_.begin(), sessions_.end(), *it) != sessions_.end())
+				(*it)->write(frames);
+		}
+	}
+
+	if ( start_pending_ && isStartReady() )
+	{
+		start_pending_ = false;
+		startGame();
+	}
+}
+
+void Maze::sendStart(const maze_session_ptr & session, bool allow_seed)
+{
+	// Clients that can regenerate the maze get only its seed, and clients that render the map themselves get just the
+	// wall bits; the ASCII map is only rendered for the rest, and only for as long as it takes to encode.
+	if ( allow_seed && reproducible_ && session->hasCapability(Capabilities::CAP_SEED_MAP) )
+	{
+		if (!start_msgs_.seed)
+		{
+			SeedMap seed_map(config_, goal_, maze_matrix_->getChecksum());
+			start_msgs_.seed = MessageChunker::split(GameMessage(GameMessage::GC_SEED_START_NOTIFY, &seed_map));
+		}
+		session->write(start_msgs_.seed);
+		return;
+	}
+
+	if (session->hasCapability(Capabilities::CAP_WALL_MAP))
+	{
+		if (!start_msgs_.walls)
+		{
+			WallMap wall_map(*maze_matrix_, goal_);
+			start_msgs_.walls = MessageChunker::split(GameMessage(GameMessage::GC_WALLS_START_NOTIFY, &wall_map));
+		}
+		session->write(start_msgs_.walls);
+		return;
+	}
+
+	eWorldMap map = getWorldMap(session);
+	if (!start_msgs_.world[map])
+	{
+		world_waiting_[map].push_back(session);
+		requestWorldMap(map);
+		return;
+	}
+	session->write(start_msgs_.world[map]);
+}
+
+void Maze::queueUpdate(uint32_t player_id, const Vertex3DEx & pos)
+{
+	// Only the latest position of each player is kept; intermediate steps are never sent.
+	pending_updates_[player_id] = pos;
+	if (pending_updates_.size() >= UpdateFrame::MAX_PLAYERS)
+		sendUpdates();
+}
+
+void Maze::sendUpdates()
+{
+	if (pending_updates_.empty())
+		return;
+
+	// Frames give each move relative to the position in the previous frame, except that every so often a keyframe
+	// restates every player's position in full.
+	bool keyframe = (++frames_since_keyframe_ >= KEYFRAME_INTERVAL);
+	if (keyframe)
+	{
+		frames_since_keyframe_ = 0;
+		for (player_map::const_iterator it = players_.begin(); it != players_.end(); ++it)
+			pending_updates_[(*it).first] = ((*it).second)->getPosition();
+	}
+
+	UpdateFrame frame;
+	std::vector<std::pair<uint32_t, Vertex3DEx> > changed;
+	for (std::map<uint32_t, Vertex3DEx>::iterator it = pending_updates_.begin(); it != pending_updates_.end(); ++it)
+	{
+		std::map<uint32_t, Vertex3DEx>::iterator sent = sent_positions_.find((*it).first);
+		if ( keyframe || (sent == sent_positions_.end()) )
+			frame.addPlayer((*it).first, (*it).second);
+		else if ((*it).second == (*sent).second)
+			continue;
+		else
+			frame.addPlayer((*it).first, (*it).second, (*sent).second);
+
+		sent_positions_[(*it).first] = (*it).second;
+		changed.push_back(*it);
+	}
+	pending_updates_.clear();
+
+	if (changed.empty())
+		return;
+
+	// Clients that take update frames get every change in one message; the rest get one update per player.
+	std::unique_ptr<GameMessage> frame_msg;
+	std::vector<GameMessage> player_msgs;
+	for (size_t i = 0; i < sessions_.size(); ++i)
+	{
+		if (sessions_[i]->hasCapability(Capabilities::CAP_UPDATE_FRAME))
+		{
+			if (!frame_msg)
+				frame_msg.reset(new GameMessage(GameMessage::GC_UPDATE_FRAME_NOTIFY, &frame));
+			sessions_[i]->write(*frame_msg);
+		}
+		else
+		{
+			if (player_msgs.empty())
+			{
+				for (size_t j = 0; j < changed.size(); ++j)
+				{
+					player_msgs.push_back(MessageBuilder<PlayerSchema>().set<PlayerSchema::PlayerId>(changed[j].first)
+						.set<PlayerSchema::X>(changed[j].second.x).set<PlayerSchema::Y>(changed[j].second.y)
+						.set<PlayerSchema::Z>(changed[j].second.z).getMessage());
+				}
+			}
+			for (size_t j = 0; j < player_msgs.size(); ++j)
+				sessions_[i]->write(player_msgs[j]);
+		}
+	}
+}
+
+void Maze::broadcast(const GameMessage & msg) const
+{
+	message_frames_ptr frames = MessageChunker::split(msg);
+	for (size_t i = 0; i < sessions_.size(); ++i)
+	{
+		sessions_[i]->write(frames);
+	}
+}
+
+void Maze::clearSessions()
+{
+	players_.clear();
+	pending_updates_.clear();
+	sent_positions_.clear();
+	frames_since_keyframe_ = 0;
+	sessions_.clear();
+
+	game_in_progress_ = false;
+	start_pending_ = false;
+}
@@ -1,107 +1,188 @@
-#ifndef MAZE_H
-#define MAZE_H
-
-#include <boost/thread/thread.hpp>
-#include "../MazeShared/GameMessage.h"
-
-
-// Forward declaration to avoid circular dependency
-class MazeSession;
-
-
-class Maze
-{
-	MazeConfig config_;
-	matrix3d_u8 * maze_matrix_;
-	matrix3d_u8 * world_matrix_;
-	vertex3d_vec rooms_;
-	Vertex3DEx goal_;
-	std::vector<std::shared_ptr<MazeSession> > sessions_;
-	player_map players_;
-	boost::thread ai_thread_;
-	bool game_in_progress_;
-	boost::mutex players_mutex_;
-
-public:
-	static const uint8_t MAZE_NONE =		0;
-	static const uint8_t MAZE_LEFT =		1 << 0;
-	static const uint8_t MAZE_RIGHT =		1 << 1;
-	static const uint8_t MAZE_UP =			1 << 2;
-	static const uint8_t MAZE_DOWN =		1 << 3;
-	static const uint8_t MAZE_BOTTOM =		1 << 4;
-	static const uint8_t MAZE_TOP =			1 << 5;
-	static const uint8_t MAZE_LOADED =		1 << 6;
-	static const uint8_t MAZE_DEADEND =		1 << 6;
-	static const uint8_t MAZE_EXPLORED =	1 << 7;
-
-	static const uint8_t MAX_PLAYERS = 2;
-
-	Maze();
-	~Maze();
-
-	static size_t countBranches(uint8_t room)
-	{
-		size_t count = 0;
-		for (size_t i = 1; i <= (1 << 5); i <<= 1)
-			if (!(room & i))
-				++count;
-		return count;
-	}
-
-	static bool hasStairwell(uint8_t room)
-	{
-		return ( !((room & (Maze::MAZE_BOTTOM | Maze::MAZE_TOP)) == (Maze::MAZE_BOTTOM | Maze::MAZE_TOP)) );
-	}
-
-	static MoveReq::eMoveDir mazeDirToMoveDir(uint8_t dir)
-	{
-		switch (dir)
-		{
-		case Maze::MAZE_LEFT: return MoveReq::MD_LEFT; break;
-		case Maze::MAZE_RIGHT: return MoveReq::MD_RIGHT; break;
-		case Maze::MAZE_UP: return MoveReq::MD_UP; break;
-		case Maze::MAZE_DOWN: return MoveReq::MD_DOWN; break;
-		case Maze::MAZE_BOTTOM: return MoveReq::MD_BOTTOM; break;
-		case Maze::MAZE_TOP: return MoveReq::MD_TOP; break;
-		default: return MoveReq::MD_NONE;
-		}
-	}
-
-	MazeConfig & getMazeConfig() { return config_; }
-	const MazeConfig & getMazeConfig() const { return config_; }
-	
-	const matrix3d_u8 * getMazeMatrix() const { return maze_matrix_; }
-
-	const matrix3d_u8 * getWorldMatrix() const { return world_matrix_; }
-	void displayWorldMatrix(int level = -1) const;
-
-	const Vertex3DEx & getGoal() const { return goal_; }
-
-	bool isReady() const { return sessions_.size() == MAX_PLAYERS; }
-
-	void buildMaze(const MazeConfig & config);
-	bool joinMaze(const std::shared_ptr<MazeSession> & session, uint32_t num_players);
-	void leaveMaze(const std::shared_ptr<MazeSession> & session);
-	void clearSessions();
-
-	bool movePlayer(uint32_t player_id, const move_req_ptr & req, bool * won = nullptr);
-
-	void processAI();
-	void joinAIThread();
-	
-	static uint8_t getOppositeWall(const uint8_t dir);
-
-private:
-	void processProspectiveRoom(const Vertex3DEx & prospect_vert, vertex3d_vec & explored_verts);
-
-	void broadcast(const GameMessage & msg) const;
-
-	// Non-copyable.
-	Maze(const Maze &);
-	void operator=(const Maze &);
-};
-
-typedef std::shared_ptr<Maze> maze_ptr;
-typedef std::vector<maze_ptr> maze_vector;
-
-#endif
+#ifndef MAZE_H
+#define MAZE_H
+
+#include <boost/thread/thread.hpp>
+#include "../MazeShared/MessageChunk.h"
+#include "../MazeShared/WallMatrix.h"
+#include "../MazeShared/MazeGenerator.h"
+#include "GameShard.h"
+#include "WorkerPool.h"
+
+
+// Forward declarations to avoid circular dependency
+class MazeSession;
+class AIAgent;
+
+
+class Maze : public std::enable_shared_from_this<Maze>
+{
+	// Encodings of the rendered ASCII map.
+	enum eWorldMap
+	{
+		WM_PACKED,
+		WM_PLAIN,
+		WM_MAX
+	};
+
+	// Encodings of the start map, each split into frames the first time a session needs it and then shared by every
+	// session it is sent to, until the maze is rebuilt.  The ASCII maps are built on the worker pool.
+	struct StartMessages
+	{
+		message_frames_ptr seed, walls;
+		message_frames_ptr world[WM_MAX];
+	};
+
+	MazeConfig config_;
+	WallMatrix * maze_matrix_;
+	std::vector<uint8_t> moves_; // Open directions (MAZE_* bits) of each room
+	Vertex3DEx goal_;
+	GenerationStats gen_stats_;
+	bool reproducible_; // Generated here by an algorithm that clients can rerun from the seed
+	StartMessages start_msgs_;
+	bool world_building_[WM_MAX]; // A build of the ASCII map is queued on the worker pool
+	std::vector<std::shared_ptr<MazeSession> > world_waiting_[WM_MAX]; // Sessions to send it to when it is built
+	std::vector<std::shared_ptr<MazeSession> > sessions_;
+	player_map players_;
+	std::map<uint32_t, Vertex3DEx> pending_updates_; // Latest unsent position of each player that moved
+	std::map<uint32_t, Vertex3DEx> sent_positions_; // Position of each player as of the last update frame
+	uint32_t frames_since_keyframe_;
+	bool game_in_progress_;
+	bool start_pending_; // The game is full but waits for an ASCII map that one of its sessions needs
+	uint32_t num_players_;
+	uint32_t selection_; // Game selection (1-based) the sessions joined by, handed back to any of them turned away
+	GameShard & shard_; // Runs every command that touches the game state; see getShard()
+	WorkerPool & workers_;
+	std::unique_ptr<AIAgent> ai_agent_;
+	uint32_t ai_game_; // Bumped when an AI game ends, so a move already scheduled for it is dropped
+
+public:
+	static const uint8_t MAZE_NONE =		WallMatrix::WALL_NONE;
+	static const uint8_t MAZE_LEFT =		WallMatrix::WALL_LEFT;
+	static const uint8_t MAZE_RIGHT =		WallMatrix::WALL_RIGHT;
+	static const uint8_t MAZE_UP =			WallMatrix::WALL_UP;
+	static const uint8_t MAZE_DOWN =		WallMatrix::WALL_DOWN;
+	static const uint8_t MAZE_BOTTOM =		WallMatrix::WALL_BOTTOM;
+	static const uint8_t MAZE_TOP =			WallMatrix::WALL_TOP;
+	static const uint8_t MAZE_DEADEND =		1 << 6; // AI branch node flags
+	static const uint8_t MAZE_EXPLORED =	1 << 7;
+
+	static const uint8_t MAX_PLAYERS = 2;
+	static const uint32_t KEYFRAME_INTERVAL = 50; // Update frames between full restatements of every position
+	static const uint32_t MAX_RUN_STEPS = 256; // Most half-room steps one PathReq::STEP_RUN covers
+
+	Maze(GameShard & shard, WorkerPool & workers);
+	~Maze();
+
+	// Sessions, players and the AI are only touched by commands posted to this shard, so none of them are locked.
+	// Building or loading the maze happens before it is shared and can run anywhere.
+	GameShard & getShard() { return shard_; }
+
+	static MoveReq::eMoveDir mazeDirToMoveDir(uint8_t dir)
+	{
+		switch (dir)
+		{
+		case Maze::MAZE_LEFT: return MoveReq::MD_LEFT; break;
+		case Maze::MAZE_RIGHT: return MoveReq::MD_RIGHT; break;
+		case Maze::MAZE_UP: return MoveReq::MD_UP; break;
+		case Maze::MAZE_DOWN: return MoveReq::MD_DOWN; break;
+		case Maze::MAZE_BOTTOM: return MoveReq::MD_BOTTOM; break;
+		case Maze::MAZE_TOP: return MoveReq::MD_TOP; break;
+		default: return MoveReq::MD_NONE;
+		}
+	}
+
+	static uint8_t moveDirToMazeDir(MoveReq::eMoveDir dir)
+	{
+		switch (dir)
+		{
+		case MoveReq::MD_LEFT: return Maze::MAZE_LEFT;
+		case MoveReq::MD_RIGHT: return Maze::MAZE_RIGHT;
+		case MoveReq::MD_UP: return Maze::MAZE_UP;
+		case MoveReq::MD_DOWN: return Maze::MAZE_DOWN;
+		case MoveReq::MD_BOTTOM: return Maze::MAZE_BOTTOM;
+		case MoveReq::MD_TOP: return Maze::MAZE_TOP;
+		default: return Maze::MAZE_NONE;
+		}
+	}
+
+	MazeConfig & getMazeConfig() { return config_; }
+	const MazeConfig & getMazeConfig() const { return config_; }
+	
+	const WallMatrix * getMazeMatrix() const { return maze_matrix_; }
+
+	// Render the ASCII map sent to clients; it is not kept, so callers own the result.
+	std::unique_ptr<matrix3d_u8> renderWorldMatrix() const;
+	void displayWorldMatrix(int level = -1) const;
+
+	// World coordinates of a room's centre.
+	static Vertex3DEx getWorldPosition(const Vertex3DEx & room)
+	{
+		return Vertex3DEx((room.x * 4) + 2, (room.y * 2) + 1, room.z);
+	}
+
+	// Room where the given player (0 or 1) starts.
+	Vertex3DEx getStart(uint32_t index) const;
+
+	const Vertex3DEx & getGoal() const { return goal_; }
+
+	const GenerationStats & getGenerationStats() const { return gen_stats_; }
+
+	bool isReady() const { return sessions_.size() == MAX_PLAYERS; }
+
+	void buildMaze(const MazeConfig & config);
+	bool loadMaze(const std::string & path, const MazeConfig & max_config); // Fails past max_config
+	bool joinMaze(const std::shared_ptr<MazeSession> & session, uint32_t selection, uint32_t num_players);
+	void leaveMaze(const std::shared_ptr<MazeSession> & session);
+	void sendMap(const std::shared_ptr<MazeSession> & session);
+	void clearSessions();
+
+	bool movePlayer(uint32_t player_id, MoveReq::eMoveDir dir, bool * won = nullptr);
+	bool movePlayer(uint32_t player_id, const char * steps, size_t num_steps, bool * won = nullptr); // PathReq steps
+
+	// Send the positions that changed since the last flush; called on every update tick.
+	void flushUpdates();
+
+	void stopAI();
+	
+	static uint8_t getOppositeWall(const uint8_t dir);
+
+private:
+	void buildMoves();
+	void placeGoal();
+
+	uint8_t getOpenMoves(const Vertex3DEx & pos) const;
+
+	bool stepPlayer(uint32_t player_id, Vertex3DEx & pos, uint8_t dir) const;
+	void runPlayer(uint32_t player_id, Vertex3DEx & pos, uint8_t dir) const;
+	void startGame();
+	void sendStart(const std::shared_ptr<MazeSession> & session, bool allow_seed);
+
+	// Whether sendStart falls back to the rendered ASCII map for the session, and whether that map can be sent at all.
+	bool needsWorldMatrix(const std::shared_ptr<MazeSession> & session, bool allow_seed) const;
+	bool fitsWorldMatrix() const;
+	static eWorldMap getWorldMap(const std::shared_ptr<MazeSession> & session);
+
+	// Rendering and encoding the ASCII map of a large maze takes long enough to hold up every other maze on the
+	// shard, so it is done on the worker pool and handed back to the shard.
+	bool isStartReady(); // Queues the builds still missing
+	void requestWorldMap(eWorldMap map);
+	void buildWorldMap(eWorldMap map); // Runs on a worker thread
+	void handleWorldMapBuilt(eWorldMap map, message_frames_ptr frames);
+
+	void queueUpdate(uint32_t player_id, const Vertex3DEx & pos);
+	void sendUpdates();
+
+	void broadcast(const GameMessage & msg) const;
+
+	void scheduleAIMove();
+	void handleAIMove(uint32_t ai_game);
+
+	// Non-copyable.
+	Maze(const Maze &);
+	void operator=(const Maze &);
+};
+
+typedef std::shared_ptr<Maze> maze_ptr;
+typedef std::vector<maze_ptr> maze_vector;
+
+#endif
@@ -0,0 +1,86 @@
+#include "MazeFile.h"
+#include "../MazeShared/MazeGenerator.h"
+
+
+bool MazeFile::generate(const std::string & path, const MazeConfig & config)
+{
+	std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cerr << "ERROR: MazeFile::generate [Cannot open " << path << "]" << std::endl;
+		return false;
+	}
+
+	char header[HEADER_SIZE];
+	*(reinterpret_cast<uint32_t *>(header)) = htonl(config.width);
+	*(reinterpret_cast<uint32_t *>(header + 4)) = htonl(config.height);
+	*(reinterpret_cast<uint32_t *>(header + 8)) = htonl(config.levels);
+	*(reinterpret_cast<uint32_t *>(header + 12)) = htonl(static_cast<uint32_t>(config.seed >> 32));
+	*(reinterpret_cast<uint32_t *>(header + 16)) = htonl(static_cast<uint32_t>(config.seed));
+	file.write(header, HEADER_SIZE);
+
+	EllerGenerator generator;
+	generator.setSeed(config.seed);
+	uint32_t width = config.width;
+	std::ofstream * out = &file;
+	size_t peak_bytes = generator.generateRows(config.width, config.height, config.levels,
+		[out, width] (uint32_t, uint32_t, const uint8_t * row)
+		{
+			out->write(reinterpret_cast<const char *>(row), width);
+		});
+
+	file.close();
+	if (!file)
+	{
+		std::cerr << "ERROR: MazeFile::generate [Write to " << path << " failed]" << std::endl;
+		return false;
+	}
+
+	std::cout << "Generated maze file " << path << " (peak generator memory " << peak_bytes << " bytes)." << std::endl;
+	return true;
+}
+
+
+bool MazeFileReader::open(const std::string & path)
+{
+	file_.open(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file_)
+	{
+		std::cerr << "ERROR: MazeFileReader::open [Cannot open " << path << "]" << std::endl;
+		return false;
+	}
+
+	char header[MazeFile::HEADER_SIZE];
+	if (!file_.read(header, MazeFile::HEADER_SIZE))
+	{
+		std::cerr << "ERROR: MazeFileReader::open [Missing header in " << path << "]" << std::endl;
+		return false;
+	}
+
+	config_ = MazeConfig(ntohl(*(reinterpret_cast<const uint32_t *>(header))),
+		ntohl(*(reinterpret_cast<const uint32_t *>(header + 4))),
+		ntohl(*(reinterpret_cast<const uint32_t *>(header + 8))),
+		MazeConfig::MA_ELLER,
+		(static_cast<uint64_t>(ntohl(*(reinterpret_cast<const uint32_t *>(header + 12)))) << 32) |
+			ntohl(*(reinterpret_cast<const uint32_t *>(header + 16))));
+
+	if (!config_.isWithin(MazeConfig(MazeConfig::MAX_WIDTH, MazeConfig::MAX_HEIGHT, MazeConfig::MAX_LEVELS)))
+	{
+		std::cerr << "ERROR: MazeFileReader::open [Invalid dimensions in " << path << "]" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool MazeFileReader::readLevel(uint32_t z, uint8_t * level)
+{
+	std::streamoff level_size = static_cast<std::streamoff>(config_.width) * config_.height;
+	file_.seekg(MazeFile::HEADER_SIZE + (level_size * z), std::ios::beg);
+	if (!file_.read(reinterpret_cast<char *>(level), level_size))
+	{
+		std::cerr << "ERROR: MazeFileReader::readLevel [Read of level " << z << " failed]" << std::endl;
+		return false;
+	}
+	return true;
+}
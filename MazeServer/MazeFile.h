@@ -0,0 +1,42 @@
+#ifndef MAZE_FILE_H
+#define MAZE_FILE_H
+
+#include <fstream>
+#include <string>
+#include "../MazeShared/GameStructs.h"
+
+
+// Maze files use the Matrix3D serialization layout: a 20-byte header of big-endian width, height, levels and the
+// 64-bit seed, followed by one byte of wall bits per room in matrix order.
+class MazeFile
+{
+public:
+	static const size_t HEADER_SIZE = 20;
+
+	// Stream a new maze to disk with Eller's algorithm without ever holding the full matrix in memory.
+	static bool generate(const std::string & path, const MazeConfig & config);
+};
+
+
+class MazeFileReader
+{
+	std::ifstream file_;
+	MazeConfig config_;
+
+public:
+	MazeFileReader() {}
+
+	bool open(const std::string & path);
+
+	const MazeConfig & getConfig() const { return config_; }
+
+	// Page in a single level (width * height rooms).
+	bool readLevel(uint32_t z, uint8_t * level);
+
+private:
+	// Non-copyable.
+	MazeFileReader(const MazeFileReader &);
+	void operator=(const MazeFileReader &);
+};
+
+#endif // MAZE_FILE_H
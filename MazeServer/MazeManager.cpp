@@ -1,61 +1,291 @@
-#include <ctime>
-#include "MazeServer.h"
-
-
-MazeManager::MazeManager(MazeServer & server) :
-	server_(server)
-{
-	srand(static_cast<unsigned int>(time(0)));
-}
-
-void MazeManager::loadNewMaze(const MazeConfig & config)
-{
-	maze_ptr maze = std::make_shared<Maze>();
-	maze->buildMaze(config);
-	maze->displayWorldMatrix();
-	mazes_.push_back(maze);	
-
-	broadcastSummaryData();
-}
-
-bool MazeManager::joinMaze(const maze_session_ptr & session, uint32_t selection, uint32_t num_players)
-{
-	if (--selection >= mazes_.size())
-	{
-		std::cerr << "ERROR: MazeManager::joinMaze [Game selection invalid: " << selection << "]" << std::endl;
-		return false;
-	}
-	
-	if (!mazes_[selection]->joinMaze(session, num_players))
-	{
-		std::cerr << "ERROR: MazeManager::joinMaze [Cannot join game]" << std::endl;
-		return false;
-	}
-
-	return true;
-}
-
-void MazeManager::leaveMaze(const maze_session_ptr & session, uint32_t selection)
-{
-	mazes_[selection]->leaveMaze(session);
-}
-
-void MazeManager::movePlayer(uint32_t maze, uint32_t player_id, move_req_ptr & req)
-{
-	bool won = false;
-	mazes_[maze]->movePlayer(player_id, req, &won);
-	if (won)
-	{
-		mazes_[maze]->joinAIThread();
-		mazes_[maze]->clearSessions();
-	}
-}
-
-void MazeManager::broadcastSummaryData() const
-{
-	GameSummary summary_data(mazes_.size());
-	for (maze_vector::const_iterator it = mazes_.begin(); it != mazes_.end(); ++it)
-		summary_data.addMazeConfig((*it)->getMazeConfig());
-	GameMessage msg(GameMessage::GC_GAMES_NOTIFY, &summary_data);
-	server_.broadcast(msg);
-}
+#include <ctime>
+#include <boost/bind.hpp>
+#include "MazeServer.h"
+
+
+MazeManager::MazeManager(MazeServer & server, boost::asio::io_service & io_service, const MazeConfig & max_config,
+	size_t num_workers, size_t num_shards, uint32_t update_tick_ms) :
+	server_(server), io_service_(io_service), max_config_(max_config), seed_gen_(static_cast<uint64_t>(time(0))),
+	update_timer_(io_service), update_tick_(update_tick_ms), next_shard_(0), workers_(num_workers)
+{
+	for (size_t i = 0; i < num_shards; ++i)
+		shards_.push_back(std::unique_ptr<GameShard>(new GameShard(i)));
+
+	startUpdateTimer();
+}
+
+bool MazeManager::loadNewMaze(const MazeConfig & requested_config)
+{
+	if (!validateConfig(requested_config))
+	{
+		std::cerr << "ERROR: MazeManager::loadNewMaze [Invalid maze configuration or exceeds server limits]" << std::endl;
+		requested_config.print();
+
+		// Refresh the requester's summary so it does not wait on a maze that will never arrive.
+		broadcastSummaryData();
+		return false;
+	}
+
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+
+		// A specific seed must be honoured, so only requests leaving it to the server can take a prebuilt maze.
+		PrebuiltPool * pool = (requested_config.seed ? nullptr : findPool(requested_config));
+		if ( !pool || pool->ready.empty() )
+		{
+			queueBuild(requested_config, false);
+			return true;
+		}
+
+		maze_ptr maze = pool->ready.front();
+		pool->ready.pop_front();
+		refillPool(*pool);
+
+		std::cout << "Serving prebuilt maze." << std::endl;
+		addMaze(maze);
+	}
+
+	broadcastSummaryData();
+	return true;
+}
+
+bool MazeManager::loadMazeFile(const std::string & path)
+{
+	maze_ptr maze = createMaze();
+	if (!maze->loadMaze(path, max_config_))
+	{
+		std::cerr << "ERROR: MazeManager::loadMazeFile [Cannot load " << path << "]" << std::endl;
+		return false;
+	}
+	maze->getMazeConfig().print();
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		mazes_.push_back(maze);
+	}
+
+	broadcastSummaryData();
+	return true;
+}
+
+bool MazeManager::addPrebuiltPool(const MazeConfig & config, size_t count)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	if (!validateConfig(config) || findPool(config))
+	{
+		std::cerr << "ERROR: MazeManager::addPrebuiltPool [Invalid, duplicate or out of limits maze configuration]" << std::endl;
+		config.print();
+		return false;
+	}
+
+	PrebuiltPool pool;
+	pool.config = config;
+	pool.config.seed = 0;
+	pool.target = count;
+	pool.pending = 0;
+	pools_.push_back(pool);
+	refillPool(pools_.back());
+	return true;
+}
+
+bool MazeManager::joinMaze(const maze_session_ptr & session, uint32_t selection, uint32_t num_players)
+{
+	maze_ptr maze = getMaze(selection - 1);
+	if (!maze)
+	{
+		std::cerr << "ERROR: MazeManager::joinMaze [Game selection invalid: " << selection << "]" << std::endl;
+		return false;
+	}
+
+	maze->getShard().post(boost::bind(&MazeManager::handleJoinMaze, this, maze, session, selection, num_players));
+	return true;
+}
+
+void MazeManager::handleJoinMaze(maze_ptr maze, maze_session_ptr session, uint32_t selection, uint32_t num_players)
+{
+	if (!maze->joinMaze(session, selection, num_players))
+	{
+		std::cerr << "ERROR: MazeManager::joinMaze [Cannot join game]" << std::endl;
+		session->joinFailed(selection);
+	}
+}
+
+void MazeManager::leaveMaze(const maze_session_ptr & session, uint32_t selection)
+{
+	maze_ptr maze = getMaze(selection);
+	maze->getShard().post(boost::bind(&Maze::leaveMaze, maze, session));
+}
+
+void MazeManager::sendMap(const maze_session_ptr & session, uint32_t selection)
+{
+	maze_ptr maze = getMaze(selection);
+	maze->getShard().post(boost::bind(&Maze::sendMap, maze, session));
+}
+
+void MazeManager::movePlayer(uint32_t maze, uint32_t player_id, MoveReq::eMoveDir dir)
+{
+	char step = static_cast<char>(dir);
+	movePlayer(maze, player_id, &step, 1);
+}
+
+void MazeManager::movePlayer(uint32_t maze, uint32_t player_id, const char * steps, size_t num_steps)
+{
+	if (num_steps > PathReq::MAX_STEPS)
+	{
+		std::cerr << "ERROR: MazeManager::movePlayer [Too many steps: " << num_steps << "]" << std::endl;
+		return;
+	}
+
+	// The steps are copied out of the session's read buffer, which is reused for the next message, into a fixed
+	// array carried by the command rather than a buffer of their own.
+	path_steps copy;
+	std::copy(steps, steps + num_steps, copy.begin());
+
+	maze_ptr target = getMaze(maze);
+	target->getShard().post(boost::bind(&MazeManager::handleMovePlayer, this, target, player_id, copy, num_steps));
+}
+
+void MazeManager::handleMovePlayer(maze_ptr maze, uint32_t player_id, const path_steps & steps, size_t num_steps)
+{
+	bool won = false;
+	maze->movePlayer(player_id, steps.data(), num_steps, &won);
+	if (won)
+	{
+		maze->stopAI();
+		maze->clearSessions();
+	}
+}
+
+void MazeManager::broadcastSummaryData() const
+{
+	std::unique_ptr<GameSummary> summary_data;
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		summary_data.reset(new GameSummary(mazes_.size()));
+		for (maze_vector::const_iterator it = mazes_.begin(); it != mazes_.end(); ++it)
+			summary_data->addMazeConfig((*it)->getMazeConfig());
+	}
+	GameMessage msg(GameMessage::GC_GAMES_NOTIFY, summary_data.get());
+	server_.broadcast(msg);
+}
+
+maze_ptr MazeManager::getMaze(uint32_t index) const
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return (index < mazes_.size() ? mazes_[index] : maze_ptr());
+}
+
+maze_ptr MazeManager::createMaze()
+{
+	// Safe from the worker threads.
+	GameShard & shard = *shards_[next_shard_++ % shards_.size()];
+	return std::make_shared<Maze>(shard, workers_);
+}
+
+bool MazeManager::validateConfig(const MazeConfig & config) const
+{
+	return ( config.isWithin(max_config_) && (static_cast<uint32_t>(config.algorithm) < MazeConfig::MA_MAX) );
+}
+
+MazeManager::PrebuiltPool * MazeManager::findPool(const MazeConfig & config)
+{
+	for (std::vector<PrebuiltPool>::iterator it = pools_.begin(); it != pools_.end(); ++it)
+	{
+		if ( ((*it).config.width == config.width) && ((*it).config.height == config.height) &&
+			 ((*it).config.levels == config.levels) && ((*it).config.algorithm == config.algorithm) )
+			return &(*it);
+	}
+	return nullptr;
+}
+
+void MazeManager::refillPool(PrebuiltPool & pool)
+{
+	while ((pool.ready.size() + pool.pending) < pool.target)
+	{
+		++pool.pending;
+		queueBuild(pool.config, true);
+	}
+}
+
+void MazeManager::queueBuild(const MazeConfig & config, bool prebuilt)
+{
+	// Seeds are drawn here, under mutex_, so the seed generator is never shared with the workers.
+	MazeConfig seeded_config(config);
+	while (!seeded_config.seed)
+		seeded_config.seed = seed_gen_.next64();
+
+	workers_.post(boost::bind(&MazeManager::buildMaze, this, seeded_config, prebuilt));
+}
+
+void MazeManager::buildMaze(const MazeConfig & config, bool prebuilt)
+{
+	maze_ptr maze = createMaze();
+	try
+	{
+		maze->buildMaze(config);
+	}
+	catch (const std::exception & e)
+	{
+		std::cerr << "ERROR: MazeManager::buildMaze [" << e.what() << "]" << std::endl;
+		maze.reset();
+	}
+
+	io_service_.post(boost::bind(&MazeManager::handleMazeBuilt, this, maze, config, prebuilt));
+}
+
+void MazeManager::handleMazeBuilt(maze_ptr maze, const MazeConfig & config, bool prebuilt)
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		if (prebuilt)
+		{
+			PrebuiltPool * pool = findPool(config);
+			--pool->pending;
+			if (maze)
+			{
+				pool->ready.push_back(maze);
+				std::cout << "Prebuilt maze ready (" << pool->ready.size() << "/" << pool->target << "): ";
+				config.print();
+			}
+			return;
+		}
+
+		if (maze)
+			addMaze(maze);
+	}
+
+	// Without a new maze, this still refreshes the requester's summary so it does not wait on one that never arrives.
+	broadcastSummaryData();
+}
+
+void MazeManager::addMaze(const maze_ptr & maze)
+{
+	const MazeConfig & config = maze->getMazeConfig();
+	config.print();
+	maze->getGenerationStats().print();
+	if (config.isWithin(MazeConfig(MazeConfig::DEF_MAX_WIDTH, MazeConfig::DEF_MAX_HEIGHT, MazeConfig::DEF_MAX_LEVELS)))
+		maze->displayWorldMatrix();
+	mazes_.push_back(maze);
+}
+
+void MazeManager::startUpdateTimer()
+{
+	update_timer_.expires_from_now(update_tick_);
+	update_timer_.async_wait(boost::bind(&MazeManager::handleUpdateTick, this, boost::asio::placeholders::error));
+}
+
+void MazeManager::handleUpdateTick(const boost::system::error_code & error)
+{
+	if (error)
+		return;
+
+	// Moves are batched per maze and sent together, so each client gets at most one update frame per tick.
+	maze_vector mazes;
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		mazes = mazes_;
+	}
+	for (maze_vector::iterator it = mazes.begin(); it != mazes.end(); ++it)
+		(*it)->getShard().post(boost::bind(&Maze::flushUpdates, *it));
+
+	startUpdateTimer();
+}
@@ -1,29 +1,90 @@
-#ifndef MAZE_MANAGER_H
-#define MAZE_MANAGER_H
-
-#include "Maze.h"
-
-
-// Forward declaration to avoid circular dependency
-class MazeServer;
-
-
-class MazeManager
-{
-	maze_vector mazes_;
-	MazeServer & server_;
-
-public:
-	MazeManager(MazeServer & server);
-
-	void loadNewMaze(const MazeConfig & config);
-	
-	bool joinMaze(const std::shared_ptr<MazeSession> & session, uint32_t selection, uint32_t num_players);
-	void leaveMaze(const std::shared_ptr<MazeSession> & session, uint32_t selection);
-
-	void movePlayer(uint32_t maze, uint32_t player_id, move_req_ptr & req);
-
-	void broadcastSummaryData() const;
-};
-
-#endif
+#ifndef MAZE_MANAGER_H
+#define MAZE_MANAGER_H
+
+#include <deque>
+#include <boost/array.hpp>
+#include "Maze.h"
+#include "WorkerPool.h"
+#include "../MazeShared/Random.h"
+
+
+// Forward declaration to avoid circular dependency
+class MazeServer;
+
+
+class MazeManager
+{
+	typedef boost::array<char, PathReq::MAX_STEPS> path_steps;
+
+	// Mazes of a popular size built ahead of time, so that requests leaving the seed to the server are answered at once.
+	struct PrebuiltPool
+	{
+		MazeConfig config;
+		size_t target;
+		size_t pending; // Builds queued on the worker pool
+		std::deque<maze_ptr> ready;
+	};
+
+	maze_vector mazes_;
+	mutable boost::mutex mutex_; // Guards mazes_, seed_gen_ and pools_, which handlers on any io thread reach
+	MazeServer & server_;
+	boost::asio::io_service & io_service_;
+	MazeConfig max_config_;
+	Random seed_gen_; // Picks seeds for mazes requested without one
+	std::vector<PrebuiltPool> pools_;
+	boost::asio::deadline_timer update_timer_;
+	boost::posix_time::milliseconds update_tick_; // Interval at which player moves are sent out
+	std::vector<std::unique_ptr<GameShard> > shards_; // Each maze is run by one of these, picked round robin
+	boost::atomic<size_t> next_shard_;
+	WorkerPool workers_; // Declared last so that running builds finish before anything they post back to is destroyed
+
+public:
+	static const uint32_t DEF_UPDATE_TICK_MS = 20;
+
+	MazeManager(MazeServer & server, boost::asio::io_service & io_service, const MazeConfig & max_config,
+		size_t num_workers, size_t num_shards, uint32_t update_tick_ms);
+
+	const MazeConfig & getMaxConfig() const { return max_config_; }
+
+	// Queue generation of a new maze on the worker pool; the lobby summary is broadcast once it is ready.
+	bool loadNewMaze(const MazeConfig & requested_config);
+	bool loadMazeFile(const std::string & path);
+	bool addPrebuiltPool(const MazeConfig & config, size_t count);
+	
+	// Requests for a maze's game are posted to the maze's shard and carried out there.  A join to a valid
+	// selection returns true at once; if the maze then turns the player away, MazeSession::joinFailed is called.
+	bool joinMaze(const std::shared_ptr<MazeSession> & session, uint32_t selection, uint32_t num_players);
+	void leaveMaze(const std::shared_ptr<MazeSession> & session, uint32_t selection);
+	void sendMap(const std::shared_ptr<MazeSession> & session, uint32_t selection);
+
+	void movePlayer(uint32_t maze, uint32_t player_id, MoveReq::eMoveDir dir);
+	void movePlayer(uint32_t maze, uint32_t player_id, const char * steps, size_t num_steps);
+
+	void broadcastSummaryData() const;
+
+private:
+	maze_ptr getMaze(uint32_t index) const;
+	maze_ptr createMaze();
+
+	// Run on the maze's shard.
+	void handleJoinMaze(maze_ptr maze, std::shared_ptr<MazeSession> session, uint32_t selection, uint32_t num_players);
+	void handleMovePlayer(maze_ptr maze, uint32_t player_id, const path_steps & steps, size_t num_steps);
+
+	bool validateConfig(const MazeConfig & config) const;
+
+	// Runs on a worker thread.
+	void buildMaze(const MazeConfig & config, bool prebuilt);
+
+	void handleMazeBuilt(maze_ptr maze, const MazeConfig & config, bool prebuilt);
+
+	// Require mutex_ to be held.
+	void addMaze(const maze_ptr & maze);
+	void refillPool(PrebuiltPool & pool);
+	void queueBuild(const MazeConfig & config, bool prebuilt);
+	PrebuiltPool * findPool(const MazeConfig & config);
+
+	void startUpdateTimer();
+	void handleUpdateTick(const boost::system::error_code & error);
+};
+
+#endif
@@ -1,103 +1,244 @@
-#include <boost/bind.hpp>
-#include "MazeServer.h"
-
-using boost::asio::ip::tcp;
-
-
-// Compiler warning can be ignored: ('this' : used in base member initializer list).
-MazeServer::MazeServer(boost::asio::io_service & io_service, const tcp::endpoint & endpoint) :
-	io_service_(io_service), acceptor_(io_service, endpoint), maze_mgr_(*this)
-{
-	startAccept();
-}
-
-void MazeServer::startAccept()
-{
-	int pos = findFreeSessionPos();
-	size_t id = static_cast<size_t>(pos + 1);
-	if (pos < 0)
-		id = sessions_.size() + 1;
-
-	maze_session_ptr newSession(new MazeSession(io_service_, static_cast<uint32_t>(id), maze_mgr_));
-	if (pos < 0)
-		sessions_.push_back(newSession);
-	else
-		sessions_[pos] = newSession;
-
-	acceptor_.async_accept(newSession->socket(),
-		boost::bind(&MazeServer::handleAccept, this, newSession,
-			boost::asio::placeholders::error));
-}
-
-void MazeServer::handleAccept(maze_session_ptr session, const boost::system::error_code & error)
-{
-	if (!error)
-	{
-		session->start();
-		std::cout << "Session established for Player " << session->getPlayerId() << "." << std::endl;
-	}
-	else
-	{
-		std::cerr << "ERROR: MazeServer::handleAccept [" << error.value() << ": " << error.message() << "]" << std::endl;
-	}
-
-	startAccept();
-}
-
-void MazeServer::broadcast(const GameMessage & msg)
-{
-	for (maze_session_weak_vec::iterator it = sessions_.begin(); it != sessions_.end(); ++it)
-	{
-		try
-        {
-            if (auto p = (*it).lock())
-			{
-				if (p->isStarted())
-					p->write(msg);
-			}
-			else
-			{
-				std::cerr << "WARNING: MazeServer::broadcast [Weak pointer lock failure]" << std::endl;
-			}
-        }
-        catch (const std::bad_weak_ptr &)
-        {
-            std::cerr << "WARNING: MazeServer::broadcast [Ignoring bad weak pointer]" << std::endl;
-        }
-	}
-}
-
-int MazeServer::findFreeSessionPos() const
-{
-	for (size_t i = 0; i < sessions_.size(); ++i)
-	{
-		if (sessions_[i].expired())
-			return static_cast<int>(i);
-	}
-	return -1;
-}
-
-
-int main(int argc, char * argv[])
-{
-	try
-	{
-		if (argc != 2)
-		{
-			std::cerr << "Usage: MazeServer <port>" << std::endl;
-			return 1;
-		}
-
-		boost::asio::io_service io_service;
-		tcp::endpoint endpoint(tcp::v4(), atoi(argv[1]));
-		MazeServer server(io_service, endpoint);
-		io_service.run();
-	}
-	catch (std::runtime_error & e)
-	{
-		std::cerr << "Exception: " << e.what() << std::endl;
-		return 1;
-	}
-
-	return 0;
-}
+#include <ctime>
+#include <boost/bind.hpp>
+#include "MazeServer.h"
+#include "Benchmark.h"
+#include "MazeFile.h"
+
+using boost::asio::ip::tcp;
+
+
+// Compiler warning can be ignored: ('this' : used in base member initializer list).
+MazeServer::MazeServer(boost::asio::io_service & io_service, const tcp::endpoint & endpoint,
+	const MazeConfig & max_config, size_t num_workers, size_t num_shards, uint32_t update_tick_ms,
+	const SendLimits & send_limits) :
+	io_service_(io_service), acceptor_(io_service, endpoint),
+	maze_mgr_(*this, io_service, max_config, num_workers, num_shards, update_tick_ms), send_limits_(send_limits)
+{
+	startAccept();
+}
+
+void MazeServer::startAccept()
+{
+	boost::mutex::scoped_lock lock(sessions_mutex_);
+	int pos = findFreeSessionPos();
+	size_t id = static_cast<size_t>(pos + 1);
+	if (pos < 0)
+		id = sessions_.size() + 1;
+
+	maze_session_ptr newSession(new MazeSession(io_service_, static_cast<uint32_t>(id), maze_mgr_,
+		send_limits_));
+	if (pos < 0)
+		sessions_.push_back(newSession);
+	else
+		sessions_[pos] = newSession;
+
+	acceptor_.async_accept(newSession->socket(),
+		boost::bind(&MazeServer::handleAccept, this, newSession,
+			boost::asio::placeholders::error));
+}
+
+void MazeServer::handleAccept(maze_session_ptr session, const boost::system::error_code & error)
+{
+	if (!error)
+	{
+		session->start();
+		std::cout << "Session established for Player " << session->getPlayerId() << "." << std::endl;
+	}
+	else
+	{
+		std::cerr << "ERROR: MazeServer::handleAccept [" << error.value() << ": " << error.message() << "]" << std::endl;
+	}
+
+	startAccept();
+}
+
+void MazeServer::broadcast(const GameMessage & msg)
+{
+	// Split once, so a large message is not chunked again for every session.
+	message_frames_ptr frames = MessageChunker::split(msg);
+	boost::mutex::scoped_lock lock(sessions_mutex_);
+	for (maze_session_weak_vec::iterator it = sessions_.begin(); it != sessions_.end(); ++it)
+	{
+		try
+        {
+            if (auto p = (*it).lock())
+			{
+				if (p->isStarted())
+					p->write(frames);
+			}
+			else
+			{
+				std::cerr << "WARNING: MazeServer::broadcast [Weak pointer lock failure]" << std::endl;
+			}
+        }
+        catch (const std::bad_weak_ptr &)
+        {
+            std::cerr << "WARNING: MazeServer::broadcast [Ignoring bad weak pointer]" << std::endl;
+        }
+	}
+}
+
+int MazeServer::findFreeSessionPos() const
+{
+	for (size_t i = 0; i < sessions_.size(); ++i)
+	{
+		if (sessions_[i].expired())
+			return static_cast<int>(i);
+	}
+	return -1;
+}
+
+
+static void printUsage()
+{
+	std::cerr << "Usage: MazeServer <port> [--limits <max width> <max height> <max levels>] [--workers <threads>]" << std::endl;
+	std::cerr << "                  [--tick <update interval ms>] [--threads <io threads>]" << std::endl;
+	std::cerr << "                  [--shards <game threads>]" << std::endl;
+	std::cerr << "                  [--send-limits <max queued bytes> <max queued messages> <grace ms>]" << std::endl;
+	std::cerr << "                  [--load <maze file>]... [--pool <width> <height> <levels> <algorithm> <count>]..." << std::endl;
+	std::cerr << "       MazeServer --generate <maze file> <width> <height> <levels> [seed]" << std::endl;
+	std::cerr << "       MazeServer --bench [<benchmark>]..." << std::endl;
+	std::cerr << "Algorithms:" << std::endl;
+	for (int i = 0; i < MazeConfig::MA_MAX; ++i)
+		std::cerr << "\t" << (i + 1) << ") " << MazeConfig::getAlgorithmName(static_cast<MazeConfig::eAlgorithm>(i)) << std::endl;
+	std::cerr << "Benchmarks (all when none are named):" << std::endl;
+	Benchmark::printNames(std::cerr);
+}
+
+static void printSizeRange(const char * what)
+{
+	std::cerr << what << " must be between " << MazeConfig::MIN_WIDTH << "x" << MazeConfig::MIN_HEIGHT << "x" <<
+		MazeConfig::MIN_LEVELS << " and " << MazeConfig::MAX_WIDTH << "x" << MazeConfig::MAX_HEIGHT << "x" <<
+		MazeConfig::MAX_LEVELS << "." << std::endl;
+}
+
+int main(int argc, char * argv[])
+{
+	try
+	{
+		const MazeConfig abs_max_config(MazeConfig::MAX_WIDTH, MazeConfig::MAX_HEIGHT, MazeConfig::MAX_LEVELS);
+
+		if ( ((argc == 6) || (argc == 7)) && (std::string(argv[1]) == "--generate") )
+		{
+			// Offline generation: stream a maze straight to disk.
+			MazeConfig config(atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), MazeConfig::MA_ELLER,
+				(argc == 7 ? strtoull(argv[6], nullptr, 10) : 0));
+			if (!config.isWithin(abs_max_config))
+			{
+				printSizeRange("Maze size");
+				return 1;
+			}
+			if (!config.seed)
+				config.seed = Random(static_cast<uint64_t>(time(0))).next64();
+			config.print();
+			return (MazeFile::generate(argv[2], config) ? 0 : 1);
+		}
+
+		if ( (argc >= 2) && (std::string(argv[1]) == "--bench") )
+			return (Benchmark::run(std::vector<std::string>(argv + 2, argv + argc)) ? 0 : 1);
+
+		if (argc < 2)
+		{
+			printUsage();
+			return 1;
+		}
+
+		MazeConfig max_config(MazeConfig::DEF_MAX_WIDTH, MazeConfig::DEF_MAX_HEIGHT, MazeConfig::DEF_MAX_LEVELS);
+		size_t num_workers = std::max<size_t>(1, boost::thread::hardware_concurrency());
+		size_t num_io_threads = std::max<size_t>(1, boost::thread::hardware_concurrency());
+		size_t num_shards = std::max<size_t>(1, boost::thread::hardware_concurrency());
+		uint32_t update_tick_ms = MazeManager::DEF_UPDATE_TICK_MS;
+		SendLimits send_limits;
+		std::vector<std::string> maze_files;
+		std::vector<std::pair<MazeConfig, size_t> > pools;
+		for (int i = 2; i < argc; ++i)
+		{
+			std::string option(argv[i]);
+			if ( (option == "--limits") && ((i + 3) < argc) )
+			{
+				max_config = MazeConfig(atoi(argv[i + 1]), atoi(argv[i + 2]), atoi(argv[i + 3]));
+				i += 3;
+				if (!max_config.isWithin(abs_max_config))
+				{
+					printSizeRange("Maximum maze size");
+					return 1;
+				}
+			}
+			else if ( (option == "--workers") && ((i + 1) < argc) && (atoi(argv[i + 1]) > 0) )
+			{
+				num_workers = atoi(argv[++i]);
+			}
+			else if ( (option == "--threads") && ((i + 1) < argc) && (atoi(argv[i + 1]) > 0) )
+			{
+				num_io_threads = atoi(argv[++i]);
+			}
+			else if ( (option == "--shards") && ((i + 1) < argc) && (atoi(argv[i + 1]) > 0) )
+			{
+				num_shards = atoi(argv[++i]);
+			}
+			else if ( (option == "--send-limits") && ((i + 3) < argc) && (atoi(argv[i + 1]) > 0) &&
+				(atoi(argv[i + 2]) > 0) && (atoi(argv[i + 3]) > 0) )
+			{
+				send_limits = SendLimits(atoi(argv[i + 1]), atoi(argv[i + 2]), atoi(argv[i + 3]));
+				i += 3;
+			}
+			else if ( (option == "--tick") && ((i + 1) < argc) && (atoi(argv[i + 1]) > 0) )
+			{
+				update_tick_ms = atoi(argv[++i]);
+			}
+			else if ( (option == "--load") && ((i + 1) < argc) )
+			{
+				maze_files.push_back(argv[++i]);
+			}
+			else if ( (option == "--pool") && ((i + 5) < argc) && (atoi(argv[i + 4]) >= 1) &&
+				(atoi(argv[i + 4]) <= MazeConfig::MA_MAX) )
+			{
+				MazeConfig config(atoi(argv[i + 1]), atoi(argv[i + 2]), atoi(argv[i + 3]),
+					static_cast<MazeConfig::eAlgorithm>(atoi(argv[i + 4]) - 1));
+				pools.push_back(std::make_pair(config, static_cast<size_t>(atoi(argv[i + 5]))));
+				i += 5;
+			}
+			else
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		std::cout << "Maximum ";
+		max_config.print();
+
+		boost::asio::io_service io_service;
+		tcp::endpoint endpoint(tcp::v4(), atoi(argv[1]));
+		MazeServer server(io_service, endpoint, max_config, num_workers, num_shards, update_tick_ms,
+			send_limits);
+		for (size_t i = 0; i < maze_files.size(); ++i)
+		{
+			if (!server.getMazeManager().loadMazeFile(maze_files[i]))
+				return 1;
+		}
+		for (size_t i = 0; i < pools.size(); ++i)
+		{
+			if (!server.getMazeManager().addPrebuiltPool(pools[i].first, pools[i].second))
+				return 1;
+		}
+
+		// Sessions serialize their own handlers on a strand and games run on the shards, so the io_service can be
+		// run from a pool of threads; this thread is one of them.
+		std::cout << "Running " << num_io_threads << " network thread(s)." << std::endl;
+		boost::thread_group io_threads;
+		for (size_t i = 1; i < num_io_threads; ++i)
+		{
+			io_threads.create_thread(boost::bind(
+				static_cast<std::size_t (boost::asio::io_service::*)()>(&boost::asio::io_service::run), &io_service));
+		}
+		io_service.run();
+		io_threads.join_all();
+	}
+	catch (std::runtime_error & e)
+	{
+		std::cerr << "Exception: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
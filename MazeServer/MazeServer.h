@@ -1,25 +1,31 @@
-#ifndef MAZE_SERVER_H
-#define MAZE_SERVER_H
-
-#include "MazeSession.h"
-
-
-class MazeServer
-{
-	boost::asio::io_service & io_service_;
-	boost::asio::ip::tcp::acceptor acceptor_;
-	maze_session_weak_vec sessions_;
-	MazeManager maze_mgr_;
-
-public:
-	MazeServer(boost::asio::io_service & io_service, const boost::asio::ip::tcp::endpoint & endpoint);
-
-	void startAccept();
-	void handleAccept(maze_session_ptr session, const boost::system::error_code & error);
-	void broadcast(const GameMessage & msg);
-
-private:
-	int findFreeSessionPos() const;
-};
-
-#endif // MAZE_SERVER_H
+#ifndef MAZE_SERVER_H
+#define MAZE_SERVER_H
+
+#include "MazeSession.h"
+
+
+class MazeServer
+{
+	boost::asio::io_service & io_service_;
+	boost::asio::ip::tcp::acceptor acceptor_;
+	maze_session_weak_vec sessions_;
+	boost::mutex sessions_mutex_; // Guards sessions_; broadcasts come from any io_service thread
+	MazeManager maze_mgr_;
+	SendLimits send_limits_;
+
+public:
+	MazeServer(boost::asio::io_service & io_service, const boost::asio::ip::tcp::endpoint & endpoint,
+		const MazeConfig & max_config, size_t num_workers, size_t num_shards, uint32_t update_tick_ms,
+		const SendLimits & send_limits);
+
+	void startAccept();
+	void handleAccept(maze_session_ptr session, const boost::system::error_code & error);
+	void broadcast(const GameMessage & msg);
+
+	MazeManager & getMazeManager() { return maze_mgr_; }
+
+private:
+	int findFreeSessionPos() const; // Requires sessions_mutex_
+};
+
+#endif // MAZE_SERVER_H
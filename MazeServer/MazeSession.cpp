@@ -1,181 +1,445 @@
-#include <boost/bind.hpp>
-#include "MazeSession.h"
-
-using boost::asio::ip::tcp;
-
-
-MazeSession::MazeSession(boost::asio::io_service & io_service, uint32_t player_id, MazeManager & maze_mgr) :
-	socket_(io_service), player_id_(player_id), maze_mgr_(maze_mgr), started_(false), curr_maze_(0)
-{}
-
-MazeSession::~MazeSession()
-{
-	std::cout << "Session terminated for Player " << player_id_ << "." << std::endl;
-}
-
-void MazeSession::start()
-{
-	boost::asio::async_read(socket_,
-		boost::asio::buffer(read_msg_.data(), GameMessage::HEADER_SIZE),
-		boost::bind(
-			&MazeSession::handleReadHeader, shared_from_this(),
-			boost::asio::placeholders::error));
-	started_ = true;
-
-	PlayerID game_data(player_id_);
-	GameMessage msg(GameMessage::GC_ID_NOTIFY, &game_data);
-	write(msg);
-
-	maze_mgr_.broadcastSummaryData();
-}
-
-void MazeSession::write(const GameMessage & msg)
-{
-	boost::mutex::scoped_lock lock(write_mutex_);
-	bool write_in_progress = !write_msgs_.empty();
-	write_msgs_.push_back(msg);
-	if (!write_in_progress)
-	{
-		boost::asio::async_write(socket_,
-			boost::asio::buffer(write_msgs_.front().data(), write_msgs_.front().length()),
-			boost::bind(&MazeSession::handleWrite, shared_from_this(),
-				boost::asio::placeholders::error));
-	}
-}
-
-void MazeSession::handleReadHeader(const boost::system::error_code & error)
-{
-	if (error)
-	{
-		std::cerr << "ERROR: MazeSession::handleReadHeader [" << error.value() << ": " << error.message() << "]" << std::endl;
-		leaveMaze();
-		return;
-	}
-
-	if (read_msg_.decodeHeader())
-	{
-		boost::asio::async_read(socket_,
-			boost::asio::buffer(read_msg_.body(), read_msg_.bodyLength()),
-			boost::bind(&MazeSession::handleReadBody, shared_from_this(),
-				boost::asio::placeholders::error));
-	}
-	else
-	{
-		std::cerr << "ERROR: MazeSession::handleReadHeader [Decode header failed]" << std::endl;
-		leaveMaze();
-	}
-}
-
-void MazeSession::handleReadBody(const boost::system::error_code & error)
-{
-	if (error)
-	{
-		std::cerr << "ERROR: MazeSession::handleReadBody [" << error.value() << ": " << error.message() << "]" << std::endl;
-		leaveMaze();
-		return;
-	}
-
-	processMessage(read_msg_);
-
-	boost::asio::async_read(socket_,
-		boost::asio::buffer(read_msg_.data(), GameMessage::HEADER_SIZE),
-		boost::bind(&MazeSession::handleReadHeader, shared_from_this(),
-			boost::asio::placeholders::error));
-}
-
-void MazeSession::handleWrite(const boost::system::error_code & error)
-{
-	if (error)
-	{
-		std::cerr << "ERROR: MazeSession::handleWrite [" << error.value() << ": " << error.message() << "]" << std::endl;
-		leaveMaze();
-		return;
-	}
-
-	boost::mutex::scoped_lock lock(write_mutex_);
-	write_msgs_.pop_front();
-	if (!write_msgs_.empty())
-	{
-		boost::asio::async_write(socket_,
-			boost::asio::buffer(write_msgs_.front().data(),	write_msgs_.front().length()),
-			boost::bind(&MazeSession::handleWrite, shared_from_this(),
-				boost::asio::placeholders::error));
-	}
-}
-
-void MazeSession::processMessage(GameMessage & game_msg)
-{
-	switch (game_msg.getGameCode())
-	{
-	case GameMessage::GC_CREATE_REQ:
-		{
-			game_config_ptr game_data = std::dynamic_pointer_cast<GameConfig>(game_msg.decodeBody());
-			if (!game_data)
-			{
-				std::cerr << "ERROR: MazeSession::processMessage [Unexpected message received]" << std::endl << *game_data;
-				return;
-			}
-
-			maze_mgr_.loadNewMaze(MazeConfig(game_data->getWidth(), game_data->getHeight(), game_data->getLevels()));
-		}
-		break;
-	case GameMessage::GC_SELECT_GAME_REQ:
-		{
-			game_select_ptr game_data = std::dynamic_pointer_cast<GameSelect>(game_msg.decodeBody());
-			if (!game_data)
-			{
-				std::cerr << "ERROR: MazeSession::processMessage [Unexpected message received]" << std::endl << *game_data;
-				return;
-			}
-
-			if (!maze_mgr_.joinMaze(shared_from_this(), game_data->getSelection(), game_data->getNumPlayers()))
-			{
-				GameSelectResp select_resp(GameSelectResp::SR_FAIL);
-				GameMessage msg(GameMessage::GC_SELECT_GAME_RESP, &select_resp);
-				write(msg);
-
-				std::cerr << "ERROR: MazeSession::processMessage [Failed to join maze]" << std::endl << *game_data;
-				return;
-			}
-
-			curr_maze_ = game_data->getSelection();
-		}
-		break;
-	case GameMessage::GC_MOVE_REQ:
-		{
-			move_req_ptr game_data = std::dynamic_pointer_cast<MoveReq>(game_msg.decodeBody());
-			if (!game_data)
-			{
-				std::cerr << "ERROR: MazeSession::processMessage [Unexpected message received]" << std::endl << *game_data;
-				return;
-			}
-
-			maze_mgr_.movePlayer(curr_maze_ - 1, player_id_, game_data);
-		}
-		break;
-	case GameMessage::GC_CANCEL_REQ:
-		{
-			leaveMaze();
-		}
-		break;
-	default:
-		{
-			std::cerr << "ERROR: MazeSession::processMessage [Unexpected message received]" << std::endl;
-			game_data_ptr game_data = game_msg.decodeBody();
-			if (game_data)
-				std::cerr << *game_data;
-			else
-				std::cerr << "[Code=" << game_msg.getGameCode() << "]" << std::endl;
-		}
-		break;
-	}
-}
-
-void MazeSession::leaveMaze()
-{
-	if (curr_maze_)
-	{
-		maze_mgr_.leaveMaze(shared_from_this(), (curr_maze_ - 1));
-		curr_maze_ = 0;
-	}
-}
+#include <boost/bind.hpp>
+#include "MazeSession.h"
+
+using boost::asio::ip::tcp;
+
+
+boost::atomic<size_t> MazeSession::server_peak_bytes_(0);
+boost::atomic<size_t> MazeSession::server_peak_msgs_(0);
+
+
+MazeSession::MazeSession(boost::asio::io_service & io_service, uint32_t player_id, MazeManager & maze_mgr,
+	const SendLimits & limits) :
+	socket_(io_service), player_id_(player_id), strand_(io_service), write_active_(false),
+	batch_(MAX_GATHER_MESSAGES - 1), limits_(limits), queued_bytes_(0), queued_msgs_(0), peak_bytes_(0),
+	peak_msgs_(0), next_latest_id_(1), latest_epoch_(0), collapsed_(0), over_limit_(false), slow_timer_(io_service),
+	maze_mgr_(maze_mgr), started_(false), curr_maze_(0), capabilities_(Capabilities::CAP_NONE)
+{}
+
+MazeSession::~MazeSession()
+{
+	std::cout << "Session terminated for Player " << player_id_ << " (send queue peak " << peak_msgs_ <<
+		" messages, " << peak_bytes_ << " bytes; " << collapsed_ << " updates collapsed; server peak " <<
+		server_peak_msgs_ << " messages, " << server_peak_bytes_ << " bytes)." << std::endl;
+}
+
+void MazeSession::start()
+{
+	// Messages are already batched into gathered writes, so Nagle's algorithm would only add delay.
+	boost::system::error_code error;
+	socket_.set_option(tcp::no_delay(true), error);
+	if (error)
+		std::cerr << "WARNING: MazeSession::start [Cannot set TCP_NODELAY: " << error.message() << "]" << std::endl;
+
+	boost::asio::async_read(socket_,
+		boost::asio::buffer(read_msg_.data(), GameMessage::HEADER_SIZE),
+		strand_.wrap(boost::bind(
+			&MazeSession::handleReadHeader, shared_from_this(),
+			boost::asio::placeholders::error)));
+	started_ = true;
+
+	write(MessageBuilder<PlayerIdSchema>().set<PlayerIdSchema::PlayerId>(player_id_).getMessage());
+
+	maze_mgr_.broadcastSummaryData();
+}
+
+void MazeSession::write(const GameMessage & msg)
+{
+	if (MessageChunker::needsChunking(msg))
+	{
+		write(MessageChunker::split(msg));
+		return;
+	}
+
+	enqueue(Outbound(msg, message_frames_ptr()), msg.length());
+}
+
+void MazeSession::write(const message_frames_ptr & frames)
+{
+	if (frames->front().getGameCode() != GameMessage::GC_CHUNK_NOTIFY)
+	{
+		enqueue(Outbound(frames->front(), message_frames_ptr()), frames->front().length());
+		return;
+	}
+
+	size_t bytes = 0;
+	for (game_message_vec::const_iterator it = frames->begin(); it != frames->end(); ++it)
+		bytes += it->length();
+	enqueue(Outbound(frames->front(), frames), bytes);
+}
+
+void MazeSession::enqueue(const Outbound & item, size_t bytes)
+{
+	// Counted before the message is stored or pushed, so the consumer never takes off more than has been added.
+	queued_bytes_ += bytes;
+	++queued_msgs_;
+
+	Outbound queued(item);
+	if (storeLatest(queued, bytes))
+	{
+		--queued_msgs_;
+	}
+	else
+	{
+		outbound_.push(queued);
+
+		// Whatever follows a message outside a slot must also go after it; the epoch moves on only once the message
+		// is in the queue, so a slot opened in the new epoch is always queued behind it.
+		if (!queued.latest)
+			++latest_epoch_;
+	}
+
+	size_t queued_bytes = queued_bytes_;
+	size_t queued_msgs = queued_msgs_;
+	raisePeak(peak_bytes_, queued_bytes);
+	raisePeak(peak_msgs_, queued_msgs);
+	raisePeak(server_peak_bytes_, queued_bytes);
+	raisePeak(server_peak_msgs_, queued_msgs);
+
+	// Only the producer that first crosses a limit starts the grace period.
+	if ( ((queued_bytes > limits_.max_bytes) || (queued_msgs > limits_.max_messages)) && !over_limit_.exchange(true) )
+		strand_.post(boost::bind(&MazeSession::handleOverLimit, shared_from_this()));
+
+	requestFlush();
+}
+
+bool MazeSession::storeLatest(Outbound & item, size_t bytes)
+{
+	// Returns true when the message went into a slot already in the queue; item is then not queued.  Otherwise the
+	// message is queued as item, which names a new slot if it opened one.  Only collapsible messages take the lock.
+	GameMessage::eGameCode code = item.msg.getGameCode();
+	bool collapsible = ( !item.frames && ((code == GameMessage::GC_UPDATE_FRAME_NOTIFY) ||
+		(code == GameMessage::GC_GAMES_NOTIFY) ||
+		((code == GameMessage::GC_UPDATE_NOTIFY) && (item.msg.bodyLength() == PlayerSchema::SIZE))) );
+	uint32_t player_id = 0;
+	if ( (code == GameMessage::GC_UPDATE_NOTIFY) && collapsible )
+		player_id = MessageView<PlayerSchema>(item.msg).get<PlayerSchema::PlayerId>();
+
+	if (!collapsible)
+		return false;
+
+	boost::mutex::scoped_lock lock(latest_mutex_);
+	size_t epoch = latest_epoch_;
+	std::vector<LatestSlot>::iterator slot = latest_.begin();
+	while ( (slot != latest_.end()) &&
+		((slot->epoch != epoch) || (slot->code != code) || (slot->player_id != player_id)) )
+	{
+		++slot;
+	}
+
+	if (slot == latest_.end())
+	{
+		LatestSlot opened;
+		opened.id = next_latest_id_++;
+		opened.epoch = epoch;
+		opened.code = code;
+		opened.player_id = player_id;
+		opened.msg = item.msg;
+		latest_.push_back(opened);
+		item.latest = opened.id;
+		return false;
+	}
+
+	GameMessage msg = item.msg;
+	if (code == GameMessage::GC_UPDATE_FRAME_NOTIFY)
+	{
+		SendBatch::frame_entry_vec entries(slot->entries);
+		if ( (entries.empty() && !SendBatch::composeFrame(slot->msg, entries)) ||
+			!SendBatch::composeFrame(item.msg, entries) )
+			return false; // Queued on its own, which closes the slot
+		msg = SendBatch::buildFrame(entries);
+		slot->entries.swap(entries);
+	}
+
+	// The message's own bytes were counted by enqueue; the slot now holds msg in place of what it had.
+	queued_bytes_ += msg.length();
+	queued_bytes_ -= slot->msg.length() + bytes;
+	slot->msg = msg;
+	++collapsed_;
+	return true;
+}
+
+GameMessage MazeSession::takeLatest(size_t id)
+{
+	boost::mutex::scoped_lock lock(latest_mutex_);
+	std::vector<LatestSlot>::iterator slot = latest_.begin();
+	while (slot->id != id)
+		++slot;
+
+	GameMessage msg = slot->msg;
+	queued_bytes_ -= msg.length();
+	*slot = latest_.back();
+	latest_.pop_back();
+	return msg;
+}
+
+bool MazeSession::isOverLimit() const
+{
+	return ( (queued_bytes_ > limits_.max_bytes) || (queued_msgs_ > limits_.max_messages) );
+}
+
+void MazeSession::raisePeak(boost::atomic<size_t> & peak, size_t value)
+{
+	size_t prev = peak.load(boost::memory_order_relaxed);
+	while ( (value > prev) && !peak.compare_exchange_weak(prev, value, boost::memory_order_relaxed) )
+		;
+}
+
+void MazeSession::joinFailed(uint32_t selection)
+{
+	// The session may have left or moved on by now, so only a join that is still current is undone.
+	uint32_t expected = selection;
+	curr_maze_.compare_exchange_strong(expected, 0);
+
+	MessageBuilder<SelectRespSchema> resp;
+	write(resp.set<SelectRespSchema::SelectResp>(GameSelectResp::SR_FAIL).getMessage());
+}
+
+void MazeSession::requestFlush()
+{
+	if (!write_active_.exchange(true))
+		strand_.post(boost::bind(&MazeSession::flush, shared_from_this()));
+}
+
+void MazeSession::flush()
+{
+	sending_.clear();
+	send_buffers_.clear();
+
+	// A session that is keeping up sends what it was given; one that has fallen behind drains its backlog into the
+	// batch, which leaves only the latest position for each player.
+	Outbound item;
+	while ( batch_.isOpen() && outbound_.pop(item) )
+	{
+		if (item.frames)
+		{
+			chunkers_.push_back(std::make_shared<MessageChunker>(item.frames));
+			continue;
+		}
+
+		if (item.latest)
+		{
+			--queued_msgs_;
+			batch_.add(takeLatest(item.latest));
+			continue;
+		}
+
+		queued_bytes_ -= item.msg.length();
+		--queued_msgs_;
+		batch_.add(item.msg);
+	}
+	batch_.finish(sending_);
+	collapsed_ += batch_.takeCollapsed();
+
+	// Queued messages go ahead of the next chunk of a large message, so a big download never holds up gameplay
+	// traffic for more than one chunk.
+	if ( (sending_.size() < MAX_GATHER_MESSAGES) && !chunkers_.empty() )
+	{
+		sending_.push_back(chunkers_.front()->nextChunk());
+		queued_bytes_ -= sending_.back().length();
+		if (chunkers_.front()->isDone())
+		{
+			chunkers_.pop_front();
+			--queued_msgs_;
+		}
+	}
+
+	if (sending_.empty())
+	{
+		// A producer that pushed after the queue was drained, but still saw the flag set, left its message to us.
+		write_active_.store(false);
+		if (!outbound_.isEmpty())
+			requestFlush();
+		return;
+	}
+
+	// Send through const references so the buffers stay shared with other queues.
+	const game_message_vec & sending = sending_;
+	for (game_message_vec::const_iterator it = sending.begin(); it != sending.end(); ++it)
+		send_buffers_.push_back(boost::asio::buffer(it->data(), it->length()));
+
+	boost::asio::async_write(socket_, send_buffers_,
+		strand_.wrap(boost::bind(&MazeSession::handleWrite, shared_from_this(),
+			boost::asio::placeholders::error)));
+}
+
+void MazeSession::handleReadHeader(const boost::system::error_code & error)
+{
+	if (error)
+	{
+		std::cerr << "ERROR: MazeSession::handleReadHeader [" << error.value() << ": " << error.message() << "]" << std::endl;
+		leaveMaze();
+		return;
+	}
+
+	if (read_msg_.decodeHeader())
+	{
+		boost::asio::async_read(socket_,
+			boost::asio::buffer(read_msg_.body(), read_msg_.bodyLength()),
+			strand_.wrap(boost::bind(&MazeSession::handleReadBody, shared_from_this(),
+				boost::asio::placeholders::error)));
+	}
+	else
+	{
+		std::cerr << "ERROR: MazeSession::handleReadHeader [Decode header failed]" << std::endl;
+		leaveMaze();
+	}
+}
+
+void MazeSession::handleReadBody(const boost::system::error_code & error)
+{
+	if (error)
+	{
+		std::cerr << "ERROR: MazeSession::handleReadBody [" << error.value() << ": " << error.message() << "]" << std::endl;
+		leaveMaze();
+		return;
+	}
+
+	processMessage(read_msg_);
+
+	boost::asio::async_read(socket_,
+		boost::asio::buffer(read_msg_.data(), GameMessage::HEADER_SIZE),
+		strand_.wrap(boost::bind(&MazeSession::handleReadHeader, shared_from_this(),
+			boost::asio::placeholders::error)));
+}
+
+void MazeSession::handleWrite(const boost::system::error_code & error)
+{
+	if (error)
+	{
+		std::cerr << "ERROR: MazeSession::handleWrite [" << error.value() << ": " << error.message() << "]" << std::endl;
+		leaveMaze();
+		return;
+	}
+
+	flush();
+}
+
+void MazeSession::handleOverLimit()
+{
+	std::cerr << "WARNING: MazeSession::handleOverLimit [Player " << player_id_ << " send queue at " << queued_msgs_ <<
+		" messages, " << queued_bytes_ << " bytes; disconnecting in " << limits_.grace_ms <<
+		" ms unless it drains]" << std::endl;
+
+	slow_timer_.expires_from_now(boost::posix_time::milliseconds(limits_.grace_ms));
+	slow_timer_.async_wait(strand_.wrap(boost::bind(&MazeSession::handleSlowTimer, shared_from_this(),
+		boost::asio::placeholders::error)));
+}
+
+void MazeSession::handleSlowTimer(const boost::system::error_code & error)
+{
+	if (error)
+		return;
+
+	if (!isOverLimit())
+	{
+		over_limit_.store(false);
+		return;
+	}
+
+	// Closing the socket fails the read and write in flight, whose handlers take the player out of the maze.  The
+	// flag stays set, so nothing more is started for this session.
+	std::cerr << "ERROR: MazeSession::handleSlowTimer [Disconnecting Player " << player_id_ << ": send queue at " <<
+		queued_msgs_ << " messages, " << queued_bytes_ << " bytes]" << std::endl;
+	boost::system::error_code ec;
+	socket_.close(ec);
+}
+
+const MessageDispatcher<MazeSession> MazeSession::dispatcher_ = MazeSession::buildDispatcher();
+
+MessageDispatcher<MazeSession> MazeSession::buildDispatcher()
+{
+	MessageDispatcher<MazeSession> dispatcher;
+	dispatcher.add<GameConfigSchema>(&MazeSession::processCreateReq)
+		.add<GameSelectSchema>(&MazeSession::processSelectGameReq)
+		.add<MoveReqSchema>(&MazeSession::processMoveReq)
+		.add<PathReqSchema>(&MazeSession::processPathReq)
+		.add<CapabilitiesSchema>(&MazeSession::processCapabilities)
+		.add<MapReqSchema>(&MazeSession::processMapReq)
+		.add<CancelReqSchema>(&MazeSession::processCancelReq);
+	return dispatcher;
+}
+
+void MazeSession::processMessage(const GameMessage & game_msg)
+{
+	if (dispatcher_.dispatch(*this, game_msg) != MessageDispatcher<MazeSession>::DR_HANDLED)
+	{
+		std::cerr << "ERROR: MazeSession::processMessage [Unexpected message received; code=" <<
+			game_msg.getGameCode() << ", length=" << game_msg.bodyLength() << "]" << std::endl;
+	}
+}
+
+void MazeSession::processCreateReq(const GameMessage & game_msg)
+{
+	MessageView<GameConfigSchema> view(game_msg);
+	MazeConfig::eAlgorithm algorithm = static_cast<MazeConfig::eAlgorithm>(view.get<GameConfigSchema::Algorithm>());
+	maze_mgr_.loadNewMaze(MazeConfig(view.get<GameConfigSchema::Width>(), view.get<GameConfigSchema::Height>(),
+		view.get<GameConfigSchema::Levels>(), algorithm, view.get<GameConfigSchema::Seed>()));
+}
+
+void MazeSession::processSelectGameReq(const GameMessage & game_msg)
+{
+	MessageView<GameSelectSchema> view(game_msg);
+	uint32_t selection = view.get<GameSelectSchema::Selection>();
+
+	// Set before the join is queued so a refusal from the maze's shard (joinFailed) always finds it.
+	curr_maze_ = selection;
+	if (!maze_mgr_.joinMaze(shared_from_this(), selection, view.get<GameSelectSchema::NumPlayers>()))
+	{
+		curr_maze_ = 0;
+
+		MessageBuilder<SelectRespSchema> resp;
+		write(resp.set<SelectRespSchema::SelectResp>(GameSelectResp::SR_FAIL).getMessage());
+
+		std::cerr << "ERROR: MazeSession::processSelectGameReq [Failed to join maze " << selection << "]" << std::endl;
+	}
+}
+
+void MazeSession::processMoveReq(const GameMessage & game_msg)
+{
+	uint32_t curr_maze = curr_maze_;
+	if (curr_maze)
+	{
+		MessageView<MoveReqSchema> view(game_msg);
+		MoveReq::eMoveDir dir = static_cast<MoveReq::eMoveDir>(view.get<MoveReqSchema::MoveDir>());
+		maze_mgr_.movePlayer(curr_maze - 1, player_id_, dir);
+	}
+}
+
+void MazeSession::processPathReq(const GameMessage & game_msg)
+{
+	if ( (game_msg.bodyLength() == 0) || (game_msg.bodyLength() > PathReq::MAX_STEPS) )
+	{
+		std::cerr << "ERROR: MazeSession::processPathReq [Invalid path length " << game_msg.bodyLength() << "]" <<
+			std::endl;
+		return;
+	}
+
+	uint32_t curr_maze = curr_maze_;
+	if (curr_maze)
+		maze_mgr_.movePlayer(curr_maze - 1, player_id_, game_msg.body(), game_msg.bodyLength());
+}
+
+void MazeSession::processCapabilities(const GameMessage & game_msg)
+{
+	capabilities_ = MessageView<CapabilitiesSchema>(game_msg).get<CapabilitiesSchema::Flags>();
+}
+
+void MazeSession::processMapReq(const GameMessage &)
+{
+	uint32_t curr_maze = curr_maze_;
+	if (curr_maze)
+		maze_mgr_.sendMap(shared_from_this(), (curr_maze - 1));
+}
+
+void MazeSession::processCancelReq(const GameMessage &)
+{
+	leaveMaze();
+}
+
+void MazeSession::leaveMaze()
+{
+	uint32_t curr_maze = curr_maze_.exchange(0);
+	if (curr_maze)
+		maze_mgr_.leaveMaze(shared_from_this(), (curr_maze - 1));
+}
@@ -1,45 +1,155 @@
-#ifndef MAZE_SESSION_H
-#define MAZE_SESSION_H
-
-#include <boost/asio.hpp>
-#include "MazeManager.h"
-
-
-class MazeSession : public std::enable_shared_from_this<MazeSession>
-{
-	boost::asio::ip::tcp::socket socket_;
-	GameMessage read_msg_;
-	uint32_t player_id_;
-	game_message_queue write_msgs_;
-	MazeManager & maze_mgr_;
-	volatile bool started_;
-	uint32_t curr_maze_;
-	boost::mutex write_mutex_;
-
-public:
-	MazeSession(boost::asio::io_service & io_service, uint32_t player_id, MazeManager & maze_mgr);
-	~MazeSession();
-
-	boost::asio::ip::tcp::socket & socket() { return socket_; }
-	uint32_t getPlayerId() const { return player_id_; }
-	bool isStarted() const { return started_; }
-
-	void start();
-	void write(const GameMessage & msg);
-
-	void handleReadHeader(const boost::system::error_code & error);
-	void handleReadBody(const boost::system::error_code & error);
-	void handleWrite(const boost::system::error_code & error);
-
-private:
-	void processMessage(GameMessage & game_msg);
-	void leaveMaze();
-
-};
-
-typedef std::shared_ptr<MazeSession> maze_session_ptr;
-typedef std::weak_ptr<MazeSession> maze_session_weak_ptr;
-typedef std::vector<maze_session_ptr> maze_session_vec;
-typedef std::vector<maze_session_weak_ptr> maze_session_weak_vec;
-
-#endif // MAZE_SESSION_H
+#ifndef MAZE_SESSION_H
+#define MAZE_SESSION_H
+
+#include <boost/asio.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include "../MazeShared/MessageChunk.h"
+#include "../MazeShared/MessageSchema.h"
+#include "MazeManager.h"
+#include "MpscQueue.h"
+#include "SendBatch.h"
+
+
+// How far a session's unsent output may grow.  A session over either limit for longer than grace_ms is treated as a
+// slow consumer and disconnected.
+struct SendLimits
+{
+	static const size_t DEF_MAX_BYTES = 16 * 1024 * 1024;
+	static const size_t DEF_MAX_MESSAGES = 4096;
+	static const uint32_t DEF_GRACE_MS = 5000;
+
+	size_t max_bytes;
+	size_t max_messages;
+	uint32_t grace_ms;
+
+	SendLimits() : max_bytes(DEF_MAX_BYTES), max_messages(DEF_MAX_MESSAGES), grace_ms(DEF_GRACE_MS) {}
+	SendLimits(size_t bytes, size_t messages, uint32_t grace) :
+		max_bytes(bytes), max_messages(messages), grace_ms(grace)
+	{}
+};
+
+
+class MazeSession : public std::enable_shared_from_this<MazeSession>
+{
+	// A message queued for sending; frames is only set for a large message split into chunks.  A message that went
+	// into a slot of latest_ is queued as the slot's id, and sent at its latest value when its turn comes.
+	struct Outbound
+	{
+		GameMessage msg;
+		message_frames_ptr frames;
+		size_t latest;
+
+		Outbound() : latest(0) {}
+		Outbound(const GameMessage & m, const message_frames_ptr & f) : msg(m), frames(f), latest(0) {}
+	};
+
+	// A position update for one player, an update frame or a lobby summary, waiting in the queue.  Until another
+	// message is queued behind it, the next of its kind replaces it (frames compose with it), so a session whose
+	// write is stalled holds one of each however long the stall lasts.
+	struct LatestSlot
+	{
+		size_t id;
+		size_t epoch; // Value of latest_epoch_ when the slot opened; it takes later messages only while that holds
+		GameMessage::eGameCode code;
+		uint32_t player_id; // For GC_UPDATE_NOTIFY
+		GameMessage msg;
+		SendBatch::frame_entry_vec entries; // For GC_UPDATE_FRAME_NOTIFY, once a second frame composed with msg
+	};
+
+	boost::asio::ip::tcp::socket socket_;
+	GameMessage read_msg_;
+	uint32_t player_id_;
+	boost::asio::io_service::strand strand_; // Orders this connection's reads, writes and message handling
+	MpscQueue<Outbound> outbound_; // Pushed from any thread, drained on the strand
+	boost::atomic<bool> write_active_; // A flush is posted or a write is in flight; whoever sets it starts the flush
+	game_message_vec sending_; // Messages in the write in flight, holding their buffers
+	std::vector<boost::asio::const_buffer> send_buffers_;
+	std::deque<message_chunker_ptr> chunkers_; // Large messages still being sent, a chunk at a time
+	SendBatch batch_;
+	SendLimits limits_;
+	boost::atomic<size_t> queued_bytes_; // Queued but not yet handed to a write; a chunked message counts every frame
+	boost::atomic<size_t> queued_msgs_; // Likewise, counting a chunked message once
+	boost::atomic<size_t> peak_bytes_;
+	boost::atomic<size_t> peak_msgs_;
+	boost::mutex latest_mutex_; // Guards latest_ and next_latest_id_
+	std::vector<LatestSlot> latest_;
+	size_t next_latest_id_;
+	boost::atomic<size_t> latest_epoch_; // Bumped after each message queued outside a slot, closing every open slot
+	boost::atomic<size_t> collapsed_; // Updates and summaries dropped in favour of later ones
+	boost::atomic<bool> over_limit_; // Set by the producer that crossed a limit, cleared when the grace period ends
+	boost::asio::deadline_timer slow_timer_;
+	MazeManager & maze_mgr_;
+	boost::atomic<bool> started_;
+	boost::atomic<uint32_t> curr_maze_; // Selection joined (1-based), or 0; set here, cleared by a failed join
+	boost::atomic<uint32_t> capabilities_; // Capabilities::CAP_* flags announced by the client
+
+	static const MessageDispatcher<MazeSession> dispatcher_;
+	static boost::atomic<size_t> server_peak_bytes_; // Highest queue depths seen by any session
+	static boost::atomic<size_t> server_peak_msgs_;
+
+public:
+	static const size_t MAX_GATHER_MESSAGES = 64; // Most messages sent in one write, the most asio passes to sendmsg
+
+	MazeSession(boost::asio::io_service & io_service, uint32_t player_id, MazeManager & maze_mgr,
+		const SendLimits & limits);
+	~MazeSession();
+
+	boost::asio::ip::tcp::socket & socket() { return socket_; }
+	uint32_t getPlayerId() const { return player_id_; }
+	bool isStarted() const { return started_; }
+	bool hasCapability(uint32_t flag) const { return (capabilities_ & flag) != 0; }
+
+	// Send queue high-water marks, for this session and across the server.
+	size_t getPeakQueuedBytes() const { return peak_bytes_; }
+	size_t getPeakQueuedMessages() const { return peak_msgs_; }
+	static size_t getServerPeakQueuedBytes() { return server_peak_bytes_; }
+	static size_t getServerPeakQueuedMessages() { return server_peak_msgs_; }
+
+	void start();
+
+	// Safe from any thread.  A position update or lobby summary replaces one of its kind still waiting (see
+	// LatestSlot); everything queued by the time the session gets to send goes out in one gathered write, with stale
+	// position updates collapsed (see SendBatch).
+	void write(const GameMessage & msg);
+
+	// Queue a message already split by MessageChunker::split; the frames are shared with other sessions, not copied.
+	void write(const message_frames_ptr & frames);
+
+	// Called by the maze when it turned down a join that had been accepted for the given selection.
+	void joinFailed(uint32_t selection);
+
+	void handleReadHeader(const boost::system::error_code & error);
+	void handleReadBody(const boost::system::error_code & error);
+	void handleWrite(const boost::system::error_code & error);
+	void handleOverLimit();
+	void handleSlowTimer(const boost::system::error_code & error);
+
+private:
+	void enqueue(const Outbound & item, size_t bytes);
+	bool storeLatest(Outbound & item, size_t bytes);
+	GameMessage takeLatest(size_t id);
+	bool isOverLimit() const;
+	static void raisePeak(boost::atomic<size_t> & peak, size_t value);
+	void requestFlush();
+	void flush();
+	void leaveMaze();
+
+	static MessageDispatcher<MazeSession> buildDispatcher();
+	void processMessage(const GameMessage & game_msg);
+	void processCreateReq(const GameMessage & game_msg);
+	void processSelectGameReq(const GameMessage & game_msg);
+	void processMoveReq(const GameMessage & game_msg);
+	void processPathReq(const GameMessage & game_msg);
+	void processCapabilities(const GameMessage & game_msg);
+	void processMapReq(const GameMessage & game_msg);
+	void processCancelReq(const GameMessage & game_msg);
+
+};
+
+typedef std::shared_ptr<MazeSession> maze_session_ptr;
+typedef std::weak_ptr<MazeSession> maze_session_weak_ptr;
+typedef std::vector<maze_session_ptr> maze_session_vec;
+typedef std::vector<maze_session_weak_ptr> maze_session_weak_vec;
+
+#endif // MAZE_SESSION_H
@@ -0,0 +1,103 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <boost/atomic.hpp>
+
+
+// Lock-free multi-producer, single-consumer queue (Dmitry Vyukov's intrusive node queue).
+// push() is safe from any thread and costs one allocation and one atomic exchange.  pop() and isEmpty() belong to
+// the single consumer.  A push that has claimed its place but not yet linked its node is invisible to pop() for that
+// moment, but isEmpty() already reports it, so a consumer that found nothing to pop and yet sees the queue non-empty
+// should come back shortly instead of going to sleep.
+template <typename T>
+class MpscQueue
+{
+	struct Node
+	{
+		boost::atomic<Node *> next;
+		T value;
+
+		Node() : next(nullptr) {}
+		explicit Node(const T & v) : next(nullptr), value(v) {}
+	};
+
+	boost::atomic<Node *> head_; // Producers push here
+	Node * tail_; // Consumer pops from here
+	Node stub_;
+
+public:
+	MpscQueue() :
+		head_(&stub_), tail_(&stub_)
+	{}
+
+	~MpscQueue()
+	{
+		while (Node * node = popNode())
+			delete node;
+	}
+
+	void push(const T & value)
+	{
+		pushNode(new Node(value));
+	}
+
+	bool pop(T & value)
+	{
+		Node * node = popNode();
+		if (!node)
+			return false;
+
+		value = node->value;
+		delete node;
+		return true;
+	}
+
+	bool isEmpty() const { return head_.load() == tail_; }
+
+private:
+	void pushNode(Node * node)
+	{
+		node->next.store(nullptr, boost::memory_order_relaxed);
+		Node * prev = head_.exchange(node);
+		prev->next.store(node, boost::memory_order_release);
+	}
+
+	Node * popNode()
+	{
+		Node * tail = tail_;
+		Node * next = tail->next.load(boost::memory_order_acquire);
+		if (tail == &stub_)
+		{
+			if (!next)
+				return nullptr;
+			tail_ = next;
+			tail = next;
+			next = next->next.load(boost::memory_order_acquire);
+		}
+
+		if (next)
+		{
+			tail_ = next;
+			return tail;
+		}
+
+		// The tail is the last node pushed, or a producer is part way through pushing after it.
+		if (tail != head_.load())
+			return nullptr;
+
+		pushNode(&stub_);
+		next = tail->next.load(boost::memory_order_acquire);
+		if (next)
+		{
+			tail_ = next;
+			return tail;
+		}
+		return nullptr;
+	}
+
+	// Non-copyable.
+	MpscQueue(const MpscQueue &);
+	void operator=(const MpscQueue &);
+};
+
+#endif // MPSC_QUEUE_H
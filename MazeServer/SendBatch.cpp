@@ -0,0 +1,161 @@
+#include <algorithm>
+#include "SendBatch.h"
+#include "../MazeShared/MessageSchema.h"
+
+
+SendBatch::SendBatch(size_t max_messages) :
+	max_messages_(max_messages), frames_mergeable_(true), has_winner_(false), collapsed_(0)
+{
+}
+
+bool SendBatch::isEmpty() const
+{
+	return ( controls_.empty() && player_updates_.empty() && frames_.empty() && !has_winner_ );
+}
+
+size_t SendBatch::getSize() const
+{
+	size_t frames = (frames_mergeable_ ? std::min<size_t>(frames_.size(), 1) : frames_.size());
+	return ( controls_.size() + player_updates_.size() + frames + (has_winner_ ? 1 : 0) );
+}
+
+void SendBatch::add(const GameMessage & msg)
+{
+	switch (msg.getGameCode())
+	{
+	case GameMessage::GC_UPDATE_NOTIFY:
+		if (msg.bodyLength() == PlayerSchema::SIZE)
+			addUpdate(msg);
+		else
+			controls_.push_back(msg);
+		break;
+	case GameMessage::GC_UPDATE_FRAME_NOTIFY:
+		addFrame(msg);
+		break;
+	case GameMessage::GC_GAMES_NOTIFY:
+		addSummary(msg);
+		break;
+	case GameMessage::GC_WINNER_NOTIFY:
+		winner_ = msg;
+		has_winner_ = true;
+		break;
+	default:
+		controls_.push_back(msg);
+		break;
+	}
+}
+
+void SendBatch::addUpdate(const GameMessage & msg)
+{
+	uint32_t player_id = MessageView<PlayerSchema>(msg).get<PlayerSchema::PlayerId>();
+	for (size_t i = 0; i < player_updates_.size(); ++i)
+	{
+		if (player_updates_[i].first == player_id)
+		{
+			player_updates_[i].second = msg;
+			++collapsed_;
+			return;
+		}
+	}
+	player_updates_.push_back(std::make_pair(player_id, msg));
+}
+
+void SendBatch::addFrame(const GameMessage & msg)
+{
+	frames_.push_back(msg);
+	if ( frames_mergeable_ && !composeFrame(msg, frame_entries_) )
+		frames_mergeable_ = false;
+}
+
+bool SendBatch::composeFrame(const GameMessage & frame, frame_entry_vec & entries)
+{
+	// Compose each entry with what is already known of its player: an absolute position replaces everything
+	// before it, and changes add up.
+	const char * data = frame.body();
+	const char * end = data + frame.bodyLength();
+	UpdateFrame::Entry entry;
+	while (data != end)
+	{
+		if (!UpdateFrame::readEntry(data, end, entry))
+			return false;
+
+		frame_entry_vec::iterator it = entries.begin();
+		while ( (it != entries.end()) && (it->player_id != entry.player_id) )
+			++it;
+
+		if (it == entries.end())
+		{
+			entries.push_back(entry);
+		}
+		else if (it->op == UpdateFrame::OP_ABSOLUTE)
+		{
+			it->pos = UpdateFrame::applyEntry(entry, it->pos);
+		}
+		else if (entry.op == UpdateFrame::OP_ABSOLUTE)
+		{
+			*it = entry;
+		}
+		else
+		{
+			it->pos = UpdateFrame::applyEntry(entry, UpdateFrame::applyEntry(*it, Vertex3DEx()));
+			it->op = UpdateFrame::OP_DELTA;
+		}
+	}
+	return true;
+}
+
+GameMessage SendBatch::buildFrame(const frame_entry_vec & entries)
+{
+	UpdateFrame frame;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		const UpdateFrame::Entry & entry = entries[i];
+		if (entry.op == UpdateFrame::OP_ABSOLUTE)
+			frame.addPlayer(entry.player_id, entry.pos);
+		else
+			frame.addPlayer(entry.player_id, UpdateFrame::applyEntry(entry, Vertex3DEx()), Vertex3DEx());
+	}
+	return GameMessage(GameMessage::GC_UPDATE_FRAME_NOTIFY, &frame);
+}
+
+void SendBatch::addSummary(const GameMessage & msg)
+{
+	for (game_message_vec::iterator it = controls_.begin(); it != controls_.end(); ++it)
+	{
+		if (it->getGameCode() == GameMessage::GC_GAMES_NOTIFY)
+		{
+			controls_.erase(it);
+			++collapsed_;
+			break;
+		}
+	}
+	controls_.push_back(msg);
+}
+
+void SendBatch::finish(game_message_vec & out)
+{
+	out.insert(out.end(), controls_.begin(), controls_.end());
+
+	for (size_t i = 0; i < player_updates_.size(); ++i)
+		out.push_back(player_updates_[i].second);
+
+	if ( (frames_.size() > 1) && frames_mergeable_ && !frame_entries_.empty() )
+	{
+		out.push_back(buildFrame(frame_entries_));
+		collapsed_ += frames_.size() - 1;
+	}
+	else
+	{
+		out.insert(out.end(), frames_.begin(), frames_.end());
+	}
+
+	if (has_winner_)
+		out.push_back(winner_);
+
+	controls_.clear();
+	player_updates_.clear();
+	frames_.clear();
+	frame_entries_.clear();
+	frames_mergeable_ = true;
+	has_winner_ = false;
+}
@@ -0,0 +1,58 @@
+#ifndef SEND_BATCH_H
+#define SEND_BATCH_H
+
+#include "../MazeShared/MessageChunk.h"
+
+
+// The messages for one gathered write, taken from a session's backlog.
+// Position updates are only worth their latest value, so when a session has fallen behind they collapse: plain
+// updates to the last one for each player, and update frames into a single frame whose entries compose every
+// change queued for each player.  The same goes for lobby summaries, which are sent whole each time.  Control
+// messages keep their order and go ahead of the updates, except a winner notification: the winning move must reach
+// the client first, so the winner closes the batch and goes out after the updates.
+class SendBatch
+{
+public:
+	typedef std::vector<UpdateFrame::Entry> frame_entry_vec;
+
+private:
+	size_t max_messages_;
+	game_message_vec controls_;
+	std::vector<std::pair<uint32_t, GameMessage> > player_updates_; // Latest GC_UPDATE_NOTIFY for each player
+	game_message_vec frames_; // GC_UPDATE_FRAME_NOTIFY messages, in order
+	frame_entry_vec frame_entries_; // The frames composed, one entry per player
+	bool frames_mergeable_;
+	GameMessage winner_;
+	bool has_winner_;
+	size_t collapsed_;
+
+public:
+	explicit SendBatch(size_t max_messages);
+
+	// Whether another message can be added; the batch closes when it is full or after a winner notification.
+	bool isOpen() const { return ( !has_winner_ && (getSize() < max_messages_) ); }
+	bool isEmpty() const;
+
+	void add(const GameMessage & msg);
+
+	// Append the batch to out, in sending order, and start the next one.
+	void finish(game_message_vec & out);
+
+	// Messages absorbed into later ones since the last call.
+	size_t takeCollapsed() { size_t collapsed = collapsed_; collapsed_ = 0; return collapsed; }
+
+	// Compose the entries of an update frame into entries, one per player.  Returns false for a malformed frame,
+	// leaving entries partly updated.
+	static bool composeFrame(const GameMessage & frame, frame_entry_vec & entries);
+
+	// A frame carrying composed entries.
+	static GameMessage buildFrame(const frame_entry_vec & entries);
+
+private:
+	size_t getSize() const;
+	void addUpdate(const GameMessage & msg);
+	void addFrame(const GameMessage & msg);
+	void addSummary(const GameMessage & msg);
+};
+
+#endif // SEND_BATCH_H
@@ -0,0 +1,81 @@
+#include "TimerWheel.h"
+
+
+TimerWheel::TimerWheel(uint64_t now_ms) :
+	current_tick_(now_ms / TICK_MS), count_(0)
+{
+}
+
+void TimerWheel::add(uint64_t due_ms, const callback & cb)
+{
+	// Rounded up, so a timer never runs early.
+	place(Timer((due_ms + TICK_MS - 1) / TICK_MS, cb));
+	++count_;
+}
+
+void TimerWheel::place(const Timer & timer)
+{
+	uint64_t due_tick = (timer.due_tick < current_tick_ ? current_tick_ : timer.due_tick);
+	if ((due_tick - current_tick_) < INNER_SLOTS)
+	{
+		inner_[due_tick & (INNER_SLOTS - 1)].push_back(Timer(due_tick, timer.cb));
+		return;
+	}
+
+	uint64_t turns = (due_tick >> INNER_BITS) - (current_tick_ >> INNER_BITS);
+	if (turns >= OUTER_SLOTS)
+		turns = OUTER_SLOTS - 1;
+	outer_[((current_tick_ >> INNER_BITS) + turns) % OUTER_SLOTS].push_back(timer);
+}
+
+void TimerWheel::advance(uint64_t now_ms, callback_vec & due)
+{
+	uint64_t now_tick = now_ms / TICK_MS;
+	if (count_ == 0)
+	{
+		// Nothing to run on the way, so skip straight there.
+		if (now_tick >= current_tick_)
+			current_tick_ = now_tick + 1;
+		return;
+	}
+
+	for (; (current_tick_ <= now_tick) && count_; ++current_tick_)
+	{
+		if ((current_tick_ & (INNER_SLOTS - 1)) == 0)
+		{
+			// Start of a turn of the inner wheel: bring down the timers for it from the outer wheel.
+			timer_vec cascade;
+			cascade.swap(outer_[(current_tick_ >> INNER_BITS) % OUTER_SLOTS]);
+			for (timer_vec::const_iterator it = cascade.begin(); it != cascade.end(); ++it)
+				place(*it);
+		}
+
+		timer_vec & slot = inner_[current_tick_ & (INNER_SLOTS - 1)];
+		for (timer_vec::iterator it = slot.begin(); it != slot.end(); ++it)
+			due.push_back(it->cb);
+		count_ -= slot.size();
+		slot.clear();
+	}
+
+	if ( (count_ == 0) && (current_tick_ <= now_tick) )
+		current_tick_ = now_tick + 1;
+}
+
+uint64_t TimerWheel::getNextDue() const
+{
+	if (count_ == 0)
+		return NO_TIMERS;
+
+	// A turn that has not started yet still has its timers in the outer wheel.
+	if ( ((current_tick_ & (INNER_SLOTS - 1)) == 0) && !outer_[(current_tick_ >> INNER_BITS) % OUTER_SLOTS].empty() )
+		return current_tick_ * TICK_MS;
+
+	// The inner wheel is searched up to the end of its current turn; past that, the next cascade is the next event.
+	uint64_t turn_end = ((current_tick_ >> INNER_BITS) + 1) << INNER_BITS;
+	for (uint64_t tick = current_tick_; tick < turn_end; ++tick)
+	{
+		if (!inner_[tick & (INNER_SLOTS - 1)].empty())
+			return tick * TICK_MS;
+	}
+	return turn_end * TICK_MS;
+}
@@ -0,0 +1,64 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+#include <vector>
+#include <boost/function.hpp>
+
+
+// One-shot timers kept in a two-level hashed timer wheel, so adding a timer and running the due ones cost the same
+// however many are pending.  Time is counted in ticks of TICK_MS.  The inner wheel holds timers due within
+// INNER_SLOTS ticks, one slot per tick; the outer wheel holds later ones, one slot per turn of the inner wheel, and
+// each outer slot is moved down into the inner wheel when its turn comes.  Timers further out than the outer wheel
+// reaches are parked in its last slot and placed again when that slot comes round.
+//
+// Not thread-safe; each GameShard keeps its own.  Timers cannot be cancelled, so callbacks check whether they still
+// apply when they run.
+class TimerWheel
+{
+public:
+	typedef boost::function<void ()> callback;
+	typedef std::vector<callback> callback_vec;
+
+	static const uint32_t TICK_MS = 10;
+	static const uint64_t NO_TIMERS = ~static_cast<uint64_t>(0);
+
+private:
+	static const uint32_t INNER_BITS = 8;
+	static const uint32_t INNER_SLOTS = 1 << INNER_BITS; // 2.56 seconds
+	static const uint32_t OUTER_SLOTS = 64; // 164 seconds
+
+	struct Timer
+	{
+		uint64_t due_tick;
+		callback cb;
+
+		Timer(uint64_t due, const callback & c) : due_tick(due), cb(c) {}
+	};
+
+	typedef std::vector<Timer> timer_vec;
+
+	uint64_t current_tick_; // Every tick before this one has been run
+	size_t count_;
+	timer_vec inner_[INNER_SLOTS];
+	timer_vec outer_[OUTER_SLOTS];
+
+public:
+	explicit TimerWheel(uint64_t now_ms);
+
+	size_t getCount() const { return count_; }
+
+	void add(uint64_t due_ms, const callback & cb);
+
+	// Move the wheel on to the given time, appending the callbacks of every timer now due to the list.  The callbacks
+	// are left for the caller to run, so that they can add timers of their own.
+	void advance(uint64_t now_ms, callback_vec & due);
+
+	// Earliest time at which advance() may have something to do, or NO_TIMERS.
+	uint64_t getNextDue() const;
+
+private:
+	void place(const Timer & timer);
+};
+
+#endif // TIMER_WHEEL_H
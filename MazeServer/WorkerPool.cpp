@@ -0,0 +1,23 @@
+#include <boost/bind.hpp>
+#include "WorkerPool.h"
+
+
+WorkerPool::WorkerPool(size_t num_threads) :
+	work_(new boost::asio::io_service::work(work_service_))
+{
+	for (size_t i = 0; i < num_threads; ++i)
+		threads_.create_thread(boost::bind(&WorkerPool::runWorker, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+	// Abandon queued jobs; jobs already running are allowed to finish.
+	work_.reset();
+	work_service_.stop();
+	threads_.join_all();
+}
+
+void WorkerPool::runWorker()
+{
+	work_service_.run();
+}
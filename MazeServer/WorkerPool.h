@@ -0,0 +1,34 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <memory>
+#include <boost/asio.hpp>
+#include <boost/thread/thread.hpp>
+
+
+// Fixed set of threads running background jobs (such as maze generation) away from the main io_service thread.
+// Results are handed back by posting a completion handler to the main io_service.
+class WorkerPool
+{
+	boost::asio::io_service work_service_;
+	std::unique_ptr<boost::asio::io_service::work> work_;
+	boost::thread_group threads_;
+
+public:
+	explicit WorkerPool(size_t num_threads);
+	~WorkerPool();
+
+	size_t getSize() const { return threads_.size(); }
+
+	template<typename Handler>
+	void post(Handler handler) { work_service_.post(handler); }
+
+private:
+	void runWorker();
+
+	// Non-copyable.
+	WorkerPool(const WorkerPool &);
+	void operator=(const WorkerPool &);
+};
+
+#endif // WORKER_POOL_H
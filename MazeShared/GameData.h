@@ -1,610 +1,1060 @@
-#ifndef GAME_DATA_H
-#define GAME_DATA_H
-
-#include <map>
-#include <memory>
-#include <boost/asio.hpp> // Included to ensure that ASIO gets to include WinSock first
-#include "GameStructs.h"
-
-#ifdef _WIN32_WINNT
-#include <Windows.h>
-#else
-#include <arpa/inet.h>
-#endif
-
-
-class GameData
-{
-public:
-	virtual ~GameData() {}
-	virtual char * serializeData() = 0;
-	virtual bool deserializeData(const char * data, size_t length) = 0;
-	virtual size_t getLength() const = 0;
-	friend std::ostream & operator<<(std::ostream & os, const GameData & game_data);
-
-protected:
-	virtual void print(std::ostream & os) const {};
-};
-
-typedef std::shared_ptr<GameData> game_data_ptr;
-
-
-template <typename T>
-class BasicSingle : public GameData
-{
-	static const size_t DATA_SIZE = 4;
-
-	T data_;
-
-	char serial_data_[DATA_SIZE];
-
-public:
-	// Constructor for message receiver.
-	BasicSingle() :
-		data_(0)
-	{}
-
-	// Constructor for message sender.
-	BasicSingle(T data) :
-		data_(data)
-	{}
-
-	T getData() const { return data_; }
-
-	virtual char * serializeData()
-	{
-		*(reinterpret_cast<T *>(serial_data_)) = htonl(data_);
-		return serial_data_;
-	}
-
-	virtual bool deserializeData(const char * data, size_t length)
-	{
-		if (length != DATA_SIZE)
-			return false;
-
-		data_ = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
-		return true;
-	}
-
-	virtual size_t getLength() const { return DATA_SIZE; }
-
-protected:
-	virtual void print(std::ostream & os) const
-	{
-		os << "BasicSingle: Data=" << data_ << std::endl;
-	}
-};
-
-
-class PlayerID : public BasicSingle<uint32_t>
-{
-public:
-	// Constructor for message receiver.
-	PlayerID() :
-		BasicSingle(0)
-	{}
-
-	// Constructor for message sender.
-	PlayerID(uint32_t id) :
-		BasicSingle(id)
-	{}
-
-	uint32_t getPlayerId() const { return getData(); }
-
-protected:
-	virtual void print(std::ostream & os) const
-	{
-		os << "PlayerID: ID=" << getData() << std::endl;
-	}
-};
-
-typedef std::shared_ptr<PlayerID> player_id_ptr;
-
-
-class Winner : public BasicSingle<uint32_t>
-{
-public:
-	// Constructor for message receiver.
-	Winner() :
-		BasicSingle(0)
-	{}
-
-	// Constructor for message sender.
-	Winner(uint32_t id) :
-		BasicSingle(id)
-	{}
-
-	uint32_t getWinnerId() const { return getData(); }
-
-protected:
-	virtual void print(std::ostream & os) const
-	{
-		os << "Winner: ID=" << getData() << std::endl;
-	}
-};
-
-typedef std::shared_ptr<Winner> winner_ptr;
-
-
-class GameSelectResp : public BasicSingle<uint32_t>
-{
-public:
-	enum eSelectResp
-	{
-		SR_NONE,
-		SR_WAIT,
-		SR_FAIL
-	};
-
-	// Constructor for message receiver.
-	GameSelectResp() :
-		BasicSingle(0)
-	{}
-
-	// Constructor for message sender.
-	GameSelectResp(eSelectResp resp) :
-		BasicSingle(resp)
-	{}
-
-	eSelectResp getSelectResp() const { return static_cast<eSelectResp>(getData()); }
-
-protected:
-	virtual void print(std::ostream & os) const
-	{
-		os << "GameSelectResp: Resp=" << getData() << std::endl;
-	}
-};
-
-typedef std::shared_ptr<GameSelectResp> select_resp_ptr;
-
-
-class GameConfig : public GameData
-{
-	static const size_t DATA_SIZE = 12;
-
-	uint32_t width_, height_, levels_;
-
-	char serial_data_[DATA_SIZE];
-
-public:
-	// Constructor for message receiver.
-	GameConfig() :
-		width_(0), height_(0), levels_(0)
-	{}
-
-	// Constructor for message sender.
-	GameConfig(uint32_t width, uint32_t height, uint32_t levels) :
-		width_(width), height_(height), levels_(levels)
-	{}
-
-	uint32_t getWidth() const { return width_; }
-	uint32_t getHeight() const { return height_; }
-	uint32_t getLevels() const { return levels_; }
-
-	virtual char * serializeData()
-	{
-		*(reinterpret_cast<uint32_t *>(serial_data_)) = htonl(width_);
-		*(reinterpret_cast<uint32_t *>(serial_data_ + 4)) = htonl(height_);
-		*(reinterpret_cast<uint32_t *>(serial_data_ + 8)) = htonl(levels_);
-		return serial_data_;
-	}
-
-	virtual bool deserializeData(const char * data, size_t length)
-	{
-		if (length != DATA_SIZE)
-			return false;
-
-		width_ = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
-		height_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
-		levels_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 8)));
-		return true;
-	}
-
-	virtual size_t getLength() const { return DATA_SIZE; }
-
-protected:
-	virtual void print(std::ostream & os) const
-	{
-		os << "GameConfig: Width=" << width_ << ", Height=" << height_ <<
-			", Levels=" << levels_ << std::endl;
-	}
-};
-
-typedef std::shared_ptr<GameConfig> game_config_ptr;
-
-
-class GameSummary : public GameData
-{
-	static const size_t ENTRY_SIZE = 12;
-
-	maze_config_vec configs_;
-
-	size_t data_len_;
-	char * serial_data_;
-
-public:
-	// Constructor for message receiver.
-	GameSummary() :
-		data_len_(0), serial_data_(nullptr)
-	{}
-
-	// Constructor for message sender.
-	GameSummary(size_t num_games)
-	{ 
-		data_len_ = ENTRY_SIZE * num_games;
-		serial_data_ = new char[data_len_];
-	}
-
-	// Rule of three:
-	GameSummary(const GameSummary & other)
-	{
-		configs_ = other.configs_;
-		data_len_ = other.data_len_;
-		if (other.serial_data_)
-		{
-			serial_data_ = new char[data_len_];
-			memcpy(serial_data_, other.serial_data_, data_len_);
-		}
-		else
-			serial_data_ = nullptr;
-	}
-
-	// Copy-and-swap idiom.
-	friend void swap(GameSummary & first, GameSummary & second)
-	{
-		// Enable ADL (best practice).
-		using std::swap;
-
-        swap(first.configs_, second.configs_);
-        swap(first.data_len_, second.data_len_);
-		swap(first.serial_data_, second.serial_data_);
-	}
-
-	GameSummary & operator=(GameSummary other)
-	{
-		swap(*this, other);
-		return *this;
-	}
-
-	~GameSummary()
-	{
-		delete [] serial_data_;
-	}
-
-	void addMazeConfig(MazeConfig & config)
-	{
-		configs_.push_back(config);
-	}
-
-	const maze_config_vec & getConfigs() { return configs_; }
-
-	virtual char * serializeData()
-	{
-		char * ptr = serial_data_;
-
-		for (maze_config_vec::iterator it = configs_.begin(); it != configs_.end(); ++it)
-		{
-			*(reinterpret_cast<uint32_t *>(ptr)) = htonl((*it).width);
-			*(reinterpret_cast<uint32_t *>(ptr + 4)) = htonl((*it).height);
-			*(reinterpret_cast<uint32_t *>(ptr + 8)) = htonl((*it).levels);
-			ptr += ENTRY_SIZE;
-		}
-
-		return serial_data_;
-	}
-
-	virtual bool deserializeData(const char * data, size_t length)
-	{
-		if ( (length % ENTRY_SIZE) != 0 )
-			return false;
-
-		data_len_ = length;
-
-		size_t num_games = length / ENTRY_SIZE;
-		for (size_t i = 0; i < num_games; ++i)
-		{
-			uint32_t width = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
-			uint32_t height = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
-			uint32_t levels = ntohl(*(reinterpret_cast<const uint32_t *>(data + 8)));
-			configs_.push_back(MazeConfig(width, height, levels));
-			data += ENTRY_SIZE;
-		}
-		return true;
-	}
-
-	virtual size_t getLength() const { return data_len_; }
-
-protected:
-	virtual void print(std::ostream & os) const
-	{
-		os << "GameSummary:" << std::endl;
-		for (maze_config_vec::const_iterator it = configs_.begin(); it != configs_.end(); ++it)
-		{
-			os << "\tWidth=" << (*it).width << ", Height=" << (*it).height <<
-				", Levels=" << (*it).levels << std::endl;
-		}
-	}
-};
-
-typedef std::shared_ptr<GameSummary> game_summary_ptr;
-
-
-class GameSelect : public GameData
-{
-	static const size_t DATA_SIZE = 8;
-
-	uint32_t selection_;
-	uint32_t num_players_;
-
-	char serial_data_[DATA_SIZE];
-
-public:
-	// Constructor for message receiver.
-	GameSelect() :
-		selection_(0), num_players_(0)
-	{}
-
-	// Constructor for message sender.
-	GameSelect(uint32_t selection, uint32_t num_players) :
-		selection_(selection), num_players_(num_players)
-	{}
-
-	uint32_t getSelection() const { return selection_; }
-	uint32_t getNumPlayers() const { return num_players_; }
-
-	virtual char * serializeData()
-	{
-		*(reinterpret_cast<uint32_t *>(serial_data_)) = htonl(selection_);
-		*(reinterpret_cast<uint32_t *>(serial_data_ + 4)) = htonl(num_players_);
-		return serial_data_;
-	}
-
-	virtual bool deserializeData(const char * data, size_t length)
-	{
-		if (length != DATA_SIZE)
-			return false;
-
-		selection_ = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
-		num_players_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
-		return true;
-	}
-
-	virtual size_t getLength() const { return DATA_SIZE; }
-
-protected:
-	virtual void print(std::ostream & os) const
-	{
-		os << "GameSelect: Selection=" << selection_ << ", NumPlayers=" << num_players_ << std::endl;
-	}
-};
-
-typedef std::shared_ptr<GameSelect> game_select_ptr;
-
-
-template <typename T>
-class Matrix3D : public GameData
-{
-	static const size_t HEADER_SIZE = 12;
-
-	uint32_t width_, height_, depth_;
-	uint32_t depth_offset_;
-	T * buffer_;
-
-	size_t data_len_;
-	char * serial_data_;
-
-public:
-	// Constructor for message receiver (client).
-	Matrix3D() :
-		width_(0), height_(0), depth_(0), depth_offset_(0), buffer_(nullptr),
-		data_len_(0), serial_data_(nullptr)
-	{}
-
-	// Constructor for message sender (server).
-	Matrix3D(uint32_t width, uint32_t height, uint32_t depth, T init_value) :
-		width_(width), height_(height), depth_(depth), depth_offset_(width * height),
-		buffer_(new T[width * height * depth])
-	{
-		data_len_ = HEADER_SIZE + (depth_offset_ * depth);
-		serial_data_ = new char[data_len_];
-
-		T * ptr = buffer_;
-		for (uint32_t i = 0; i < depth_offset_ * depth; ++i)
-			*ptr++ = init_value;
-	}
-
-	~Matrix3D()
-	{
-		delete [] buffer_;
-		delete [] serial_data_;
-	}
-
-	uint32_t getWidth() const { return width_; }
-	uint32_t getHeight() const { return height_; }
-	uint32_t getDepth() const { return depth_; }
-
-	T & at(uint32_t x, uint32_t y, uint32_t z) { return buffer_[index(x, y, z)]; }
-	const T & at(uint32_t x, uint32_t y, uint32_t z) const { return buffer_[index(x, y, z)]; }
-
-	T * ptr(uint32_t x, uint32_t y, uint32_t z) { return &buffer_[index(x, y, z)]; }
-	const T * ptr(uint32_t x, uint32_t y, uint32_t z) const { return &buffer_[index(x, y, z)]; }
-
-	T & at(const Vertex3DEx & vert) { return at(vert.x, vert.y, vert.z); }
-	const T & at(const Vertex3DEx & vert) const { return at(vert.x, vert.y, vert.z); }
-
-	T * ptr(const Vertex3DEx & vert) { return ptr(vert.x, vert.y, vert.z); }
-	const T * ptr(const Vertex3DEx & vert) const { return ptr(vert.x, vert.y, vert.z); }
-
-	virtual char * serializeData()
-	{
-		*(reinterpret_cast<uint32_t *>(serial_data_)) = htonl(width_);
-		*(reinterpret_cast<uint32_t *>(serial_data_ + 4)) = htonl(height_);
-		*(reinterpret_cast<uint32_t *>(serial_data_ + 8)) = htonl(depth_);
-
-		memcpy((serial_data_ + HEADER_SIZE), buffer_, (depth_offset_ * depth_));
-
-		return serial_data_;
-	}
-
-	virtual bool deserializeData(const char * data, size_t length)
-	{
-		if (length < HEADER_SIZE)
-			return false;
-
-		width_ = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
-		height_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
-		depth_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 8)));
-
-		depth_offset_ = width_ * height_;
-
-		data_len_ = HEADER_SIZE + (depth_offset_ * depth_);
-		if (length != data_len_)
-			return false;
-
-		buffer_ = new T[depth_offset_ * depth_];
-		memcpy(buffer_, (data + HEADER_SIZE), (depth_offset_ * depth_));
-
-		return true;
-	}
-
-	virtual size_t getLength() const { return data_len_; }
-
-protected:
-	uint32_t index(uint32_t x, uint32_t y, uint32_t z) const { return x + (width_ * y) + (depth_offset_ * z); }
-
-	virtual void print(std::ostream & os) const
-	{
-		os << "Matrix3D:" << std::endl << 
-			"\tWidth=" << width_ << ", Height=" << height_ << ", Depth=" << depth_ << std::endl;
-	}
-
-private:
-	// Non-copyable.
-	Matrix3D(const Matrix3D &);
-	void operator=(const Matrix3D &);
-};
-
-typedef Matrix3D<uint8_t> matrix3d_u8;
-typedef std::shared_ptr<matrix3d_u8> matrix3d_u8_ptr;
-
-
-class Player : public GameData
-{
-	static const size_t DATA_SIZE = 16;
-
-	uint32_t player_id_;
-	Vertex3DEx pos_;
-
-	char serial_data_[DATA_SIZE];
-
-public:
-	Player() :
-		player_id_(0), pos_(0, 0, 0)
-	{}
-
-	Player(uint32_t player_id, const Vertex3DEx pos) :
-		player_id_(player_id), pos_(pos)
-	{}
-
-	uint32_t getPlayerId() const { return player_id_; }
-
-	Vertex3DEx & getPosition() { return pos_; }
-	const Vertex3DEx & getPosition() const { return pos_; }
-
-	void clear() { player_id_ = 0; }
-	bool isClear() const { return (player_id_ == 0); }
-
-	virtual char * serializeData()
-	{
-		*(reinterpret_cast<uint32_t *>(serial_data_)) = htonl(player_id_);
-		*(reinterpret_cast<uint32_t *>(serial_data_ + 4)) = htonl(pos_.x);
-		*(reinterpret_cast<uint32_t *>(serial_data_ + 8)) = htonl(pos_.y);
-		*(reinterpret_cast<uint32_t *>(serial_data_ + 12)) = htonl(pos_.z);
-		return serial_data_;
-	}
-
-	virtual bool deserializeData(const char * data, size_t length)
-	{
-		if (length != DATA_SIZE)
-			return false;
-
-		player_id_ = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
-		pos_.x = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
-		pos_.y = ntohl(*(reinterpret_cast<const uint32_t *>(data + 8)));
-		pos_.z = ntohl(*(reinterpret_cast<const uint32_t *>(data + 12)));
-		return true;
-	}
-
-	virtual size_t getLength() const { return DATA_SIZE; }
-
-protected:
-	virtual void print(std::ostream & os) const
-	{
-		os << "Player: ID=" << player_id_ << ", Pos=(" << pos_.x << ", " << pos_.y << ", " << pos_.z << ")" << std::endl;
-	}
-};
-
-typedef std::shared_ptr<Player> player_ptr;
-typedef std::map<uint32_t, player_ptr> player_map;
-
-
-class MoveReq : public GameData
-{
-	static const size_t DATA_SIZE = 4;
-
-	char serial_data_[DATA_SIZE];
-
-public:
-	enum eMoveDir
-	{
-		MD_NONE,
-		MD_LEFT,
-		MD_RIGHT,
-		MD_UP,
-		MD_DOWN,
-		MD_BOTTOM,
-		MD_TOP
-	};
-
-	// Constructor for message receiver.
-	MoveReq() :
-		move_dir_(MD_NONE)
-	{}
-
-	// Constructor for message sender.
-	MoveReq(eMoveDir dir) :
-		move_dir_(dir)
-	{}
-
-	eMoveDir getMoveDir() const { return move_dir_; }
-
-	virtual char * serializeData()
-	{
-		*(reinterpret_cast<uint32_t *>(serial_data_)) = htonl(move_dir_);
-		return serial_data_;
-	}
-
-	virtual bool deserializeData(const char * data, size_t length)
-	{
-		if (length != DATA_SIZE)
-			return false;
-
-		move_dir_ = static_cast<eMoveDir>(ntohl(*(reinterpret_cast<const uint32_t *>(data))));
-		return true;
-	}
-
-	virtual size_t getLength() const { return DATA_SIZE; }
-
-protected:
-	virtual void print(std::ostream & os) const
-	{
-		os << "MoveReq: Dir=" << move_dir_ << std::endl;
-	}
-
-private:
-	eMoveDir move_dir_;
-};
-
-typedef std::shared_ptr<MoveReq> move_req_ptr;
-
-#endif // GAME_DATA_H
+#ifndef GAME_DATA_H
+#define GAME_DATA_H
+
+#include <map>
+#include <memory>
+#include <boost/asio.hpp> // Included to ensure that ASIO gets to include WinSock first
+#include "GameStructs.h"
+#include "WallMatrix.h"
+
+#ifdef _WIN32_WINNT
+#include <Windows.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+
+class GameData
+{
+public:
+	virtual ~GameData() {}
+	virtual char * serializeData() = 0;
+	virtual bool deserializeData(const char * data, size_t length) = 0;
+	virtual size_t getLength() const = 0;
+
+	// Write the getLength() bytes of serialized data to a message body.  Types that can produce their encoding in
+	// place override this to skip the intermediate copy made by serializeData().
+	virtual void serializeTo(char * out) { memcpy(out, serializeData(), getLength()); }
+
+	// Types that can decode a chunked body piece by piece, instead of having it reassembled first, override these;
+	// beginStream() returns false for the rest.
+	virtual bool beginStream(size_t /*length*/) { return false; }
+	virtual bool deserializeStream(const char * /*data*/, size_t /*length*/) { return false; }
+	virtual bool endStream() { return false; }
+
+	friend std::ostream & operator<<(std::ostream & os, const GameData & game_data);
+
+protected:
+	virtual void print(std::ostream & os) const {};
+};
+
+typedef std::shared_ptr<GameData> game_data_ptr;
+
+
+template <typename T>
+class BasicSingle : public GameData
+{
+	static const size_t DATA_SIZE = 4;
+
+	T data_;
+
+	char serial_data_[DATA_SIZE];
+
+public:
+	// Constructor for message receiver.
+	BasicSingle() :
+		data_(0)
+	{}
+
+	// Constructor for message sender.
+	BasicSingle(T data) :
+		data_(data)
+	{}
+
+	T getData() const { return data_; }
+
+	virtual char * serializeData()
+	{
+		*(reinterpret_cast<T *>(serial_data_)) = htonl(data_);
+		return serial_data_;
+	}
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		if (length != DATA_SIZE)
+			return false;
+
+		data_ = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
+		return true;
+	}
+
+	virtual size_t getLength() const { return DATA_SIZE; }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "BasicSingle: Data=" << data_ << std::endl;
+	}
+};
+
+
+class PlayerID : public BasicSingle<uint32_t>
+{
+public:
+	// Constructor for message receiver.
+	PlayerID() :
+		BasicSingle(0)
+	{}
+
+	// Constructor for message sender.
+	PlayerID(uint32_t id) :
+		BasicSingle(id)
+	{}
+
+	uint32_t getPlayerId() const { return getData(); }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "PlayerID: ID=" << getData() << std::endl;
+	}
+};
+
+typedef std::shared_ptr<PlayerID> player_id_ptr;
+
+
+class Winner : public BasicSingle<uint32_t>
+{
+public:
+	// Constructor for message receiver.
+	Winner() :
+		BasicSingle(0)
+	{}
+
+	// Constructor for message sender.
+	Winner(uint32_t id) :
+		BasicSingle(id)
+	{}
+
+	uint32_t getWinnerId() const { return getData(); }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "Winner: ID=" << getData() << std::endl;
+	}
+};
+
+typedef std::shared_ptr<Winner> winner_ptr;
+
+
+class GameSelectResp : public BasicSingle<uint32_t>
+{
+public:
+	enum eSelectResp
+	{
+		SR_NONE,
+		SR_WAIT,
+		SR_FAIL
+	};
+
+	// Constructor for message receiver.
+	GameSelectResp() :
+		BasicSingle(0)
+	{}
+
+	// Constructor for message sender.
+	GameSelectResp(eSelectResp resp) :
+		BasicSingle(resp)
+	{}
+
+	eSelectResp getSelectResp() const { return static_cast<eSelectResp>(getData()); }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "GameSelectResp: Resp=" << getData() << std::endl;
+	}
+};
+
+typedef std::shared_ptr<GameSelectResp> select_resp_ptr;
+
+
+class Capabilities : public BasicSingle<uint32_t>
+{
+public:
+	// Optional protocol features a client can handle.
+	static const uint32_t CAP_NONE =		0;
+	static const uint32_t CAP_PACKED_MAP =	1 << 0; // GC_PACKED_START_NOTIFY
+	static const uint32_t CAP_WALL_MAP =	1 << 1; // GC_WALLS_START_NOTIFY
+	static const uint32_t CAP_SEED_MAP =	1 << 2; // GC_SEED_START_NOTIFY, answered with GC_MAP_REQ on a mismatch
+	static const uint32_t CAP_UPDATE_FRAME =	1 << 3; // GC_UPDATE_FRAME_NOTIFY
+
+	// Constructor for message receiver.
+	Capabilities() :
+		BasicSingle(CAP_NONE)
+	{}
+
+	// Constructor for message sender.
+	Capabilities(uint32_t flags) :
+		BasicSingle(flags)
+	{}
+
+	uint32_t getFlags() const { return getData(); }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "Capabilities: Flags=" << getData() << std::endl;
+	}
+};
+
+typedef std::shared_ptr<Capabilities> capabilities_ptr;
+
+
+class GameConfig : public GameData
+{
+	static const size_t DATA_SIZE = 24;
+
+	uint32_t width_, height_, levels_, algorithm_;
+	uint64_t seed_;
+
+	char serial_data_[DATA_SIZE];
+
+public:
+	// Constructor for message receiver.
+	GameConfig() :
+		width_(0), height_(0), levels_(0), algorithm_(0), seed_(0)
+	{}
+
+	// Constructor for message sender.
+	GameConfig(uint32_t width, uint32_t height, uint32_t levels, MazeConfig::eAlgorithm algorithm, uint64_t seed) :
+		width_(width), height_(height), levels_(levels), algorithm_(algorithm), seed_(seed)
+	{}
+
+	uint32_t getWidth() const { return width_; }
+	uint32_t getHeight() const { return height_; }
+	uint32_t getLevels() const { return levels_; }
+	MazeConfig::eAlgorithm getAlgorithm() const { return static_cast<MazeConfig::eAlgorithm>(algorithm_); }
+	uint64_t getSeed() const { return seed_; }
+
+	virtual char * serializeData()
+	{
+		*(reinterpret_cast<uint32_t *>(serial_data_)) = htonl(width_);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 4)) = htonl(height_);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 8)) = htonl(levels_);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 12)) = htonl(algorithm_);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 16)) = htonl(static_cast<uint32_t>(seed_ >> 32));
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 20)) = htonl(static_cast<uint32_t>(seed_));
+		return serial_data_;
+	}
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		if (length != DATA_SIZE)
+			return false;
+
+		width_ = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
+		height_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
+		levels_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 8)));
+		algorithm_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 12)));
+		seed_ = (static_cast<uint64_t>(ntohl(*(reinterpret_cast<const uint32_t *>(data + 16)))) << 32) |
+			ntohl(*(reinterpret_cast<const uint32_t *>(data + 20)));
+		return true;
+	}
+
+	virtual size_t getLength() const { return DATA_SIZE; }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "GameConfig: Width=" << width_ << ", Height=" << height_ <<
+			", Levels=" << levels_ << ", Algorithm=" << algorithm_ << ", Seed=" << seed_ << std::endl;
+	}
+};
+
+typedef std::shared_ptr<GameConfig> game_config_ptr;
+
+
+class GameSummary : public GameData
+{
+	static const size_t ENTRY_SIZE = 24;
+
+	maze_config_vec configs_;
+
+	size_t data_len_;
+	char * serial_data_;
+
+public:
+	// Constructor for message receiver.
+	GameSummary() :
+		data_len_(0), serial_data_(nullptr)
+	{}
+
+	// Constructor for message sender.
+	GameSummary(size_t num_games)
+	{ 
+		data_len_ = ENTRY_SIZE * num_games;
+		serial_data_ = new char[data_len_];
+	}
+
+	// Rule of three:
+	GameSummary(const GameSummary & other)
+	{
+		configs_ = other.configs_;
+		data_len_ = other.data_len_;
+		if (other.serial_data_)
+		{
+			serial_data_ = new char[data_len_];
+			memcpy(serial_data_, other.serial_data_, data_len_);
+		}
+		else
+			serial_data_ = nullptr;
+	}
+
+	// Copy-and-swap idiom.
+	friend void swap(GameSummary & first, GameSummary & second)
+	{
+		// Enable ADL (best practice).
+		using std::swap;
+
+        swap(first.configs_, second.configs_);
+        swap(first.data_len_, second.data_len_);
+		swap(first.serial_data_, second.serial_data_);
+	}
+
+	GameSummary & operator=(GameSummary other)
+	{
+		swap(*this, other);
+		return *this;
+	}
+
+	~GameSummary()
+	{
+		delete [] serial_data_;
+	}
+
+	void addMazeConfig(MazeConfig & config)
+	{
+		configs_.push_back(config);
+	}
+
+	const maze_config_vec & getConfigs() { return configs_; }
+
+	virtual char * serializeData()
+	{
+		char * ptr = serial_data_;
+
+		for (maze_config_vec::iterator it = configs_.begin(); it != configs_.end(); ++it)
+		{
+			*(reinterpret_cast<uint32_t *>(ptr)) = htonl((*it).width);
+			*(reinterpret_cast<uint32_t *>(ptr + 4)) = htonl((*it).height);
+			*(reinterpret_cast<uint32_t *>(ptr + 8)) = htonl((*it).levels);
+			*(reinterpret_cast<uint32_t *>(ptr + 12)) = htonl((*it).algorithm);
+			*(reinterpret_cast<uint32_t *>(ptr + 16)) = htonl(static_cast<uint32_t>((*it).seed >> 32));
+			*(reinterpret_cast<uint32_t *>(ptr + 20)) = htonl(static_cast<uint32_t>((*it).seed));
+			ptr += ENTRY_SIZE;
+		}
+
+		return serial_data_;
+	}
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		if ( (length % ENTRY_SIZE) != 0 )
+			return false;
+
+		data_len_ = length;
+
+		size_t num_games = length / ENTRY_SIZE;
+		for (size_t i = 0; i < num_games; ++i)
+		{
+			uint32_t width = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
+			uint32_t height = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
+			uint32_t levels = ntohl(*(reinterpret_cast<const uint32_t *>(data + 8)));
+			uint32_t algorithm = ntohl(*(reinterpret_cast<const uint32_t *>(data + 12)));
+			uint64_t seed = (static_cast<uint64_t>(ntohl(*(reinterpret_cast<const uint32_t *>(data + 16)))) << 32) |
+				ntohl(*(reinterpret_cast<const uint32_t *>(data + 20)));
+			configs_.push_back(MazeConfig(width, height, levels, static_cast<MazeConfig::eAlgorithm>(algorithm), seed));
+			data += ENTRY_SIZE;
+		}
+		return true;
+	}
+
+	virtual size_t getLength() const { return data_len_; }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "GameSummary:" << std::endl;
+		for (maze_config_vec::const_iterator it = configs_.begin(); it != configs_.end(); ++it)
+		{
+			os << "\tWidth=" << (*it).width << ", Height=" << (*it).height <<
+				", Levels=" << (*it).levels << ", Algorithm=" << (*it).algorithm << ", Seed=" << (*it).seed << std::endl;
+		}
+	}
+};
+
+typedef std::shared_ptr<GameSummary> game_summary_ptr;
+
+
+class GameSelect : public GameData
+{
+	static const size_t DATA_SIZE = 8;
+
+	uint32_t selection_;
+	uint32_t num_players_;
+
+	char serial_data_[DATA_SIZE];
+
+public:
+	// Constructor for message receiver.
+	GameSelect() :
+		selection_(0), num_players_(0)
+	{}
+
+	// Constructor for message sender.
+	GameSelect(uint32_t selection, uint32_t num_players) :
+		selection_(selection), num_players_(num_players)
+	{}
+
+	uint32_t getSelection() const { return selection_; }
+	uint32_t getNumPlayers() const { return num_players_; }
+
+	virtual char * serializeData()
+	{
+		*(reinterpret_cast<uint32_t *>(serial_data_)) = htonl(selection_);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 4)) = htonl(num_players_);
+		return serial_data_;
+	}
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		if (length != DATA_SIZE)
+			return false;
+
+		selection_ = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
+		num_players_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
+		return true;
+	}
+
+	virtual size_t getLength() const { return DATA_SIZE; }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "GameSelect: Selection=" << selection_ << ", NumPlayers=" << num_players_ << std::endl;
+	}
+};
+
+typedef std::shared_ptr<GameSelect> game_select_ptr;
+
+
+template <typename T>
+class Matrix3D : public GameData
+{
+public:
+	static const size_t HEADER_SIZE = 12;
+
+private:
+	uint32_t width_, height_, depth_;
+	uint32_t depth_offset_;
+	T * buffer_;
+
+	size_t data_len_;
+	char * serial_data_;
+
+public:
+	// Constructor for message receiver (client).
+	Matrix3D() :
+		width_(0), height_(0), depth_(0), depth_offset_(0), buffer_(nullptr),
+		data_len_(0), serial_data_(nullptr)
+	{}
+
+	// Constructor for message sender (server).
+	Matrix3D(uint32_t width, uint32_t height, uint32_t depth, T init_value) :
+		width_(width), height_(height), depth_(depth), depth_offset_(width * height),
+		buffer_(new T[width * height * depth]), serial_data_(nullptr)
+	{
+		data_len_ = HEADER_SIZE + (depth_offset_ * depth);
+
+		T * ptr = buffer_;
+		for (uint32_t i = 0; i < depth_offset_ * depth; ++i)
+			*ptr++ = init_value;
+	}
+
+	~Matrix3D()
+	{
+		delete [] buffer_;
+		delete [] serial_data_;
+	}
+
+	uint32_t getWidth() const { return width_; }
+	uint32_t getHeight() const { return height_; }
+	uint32_t getDepth() const { return depth_; }
+	uint32_t getSize() const { return depth_offset_ * depth_; }
+
+	T * data() { return buffer_; }
+	const T * data() const { return buffer_; }
+
+	T & at(uint32_t x, uint32_t y, uint32_t z) { return buffer_[index(x, y, z)]; }
+	const T & at(uint32_t x, uint32_t y, uint32_t z) const { return buffer_[index(x, y, z)]; }
+
+	T * ptr(uint32_t x, uint32_t y, uint32_t z) { return &buffer_[index(x, y, z)]; }
+	const T * ptr(uint32_t x, uint32_t y, uint32_t z) const { return &buffer_[index(x, y, z)]; }
+
+	T & at(const Vertex3DEx & vert) { return at(vert.x, vert.y, vert.z); }
+	const T & at(const Vertex3DEx & vert) const { return at(vert.x, vert.y, vert.z); }
+
+	T * ptr(const Vertex3DEx & vert) { return ptr(vert.x, vert.y, vert.z); }
+	const T * ptr(const Vertex3DEx & vert) const { return ptr(vert.x, vert.y, vert.z); }
+
+	virtual char * serializeData()
+	{
+		// Only allocated when asked for, so a matrix built on the receiving side is not held twice; messages are
+		// built with serializeTo and never need it.
+		if (!serial_data_)
+			serial_data_ = new char[data_len_];
+
+		serializeTo(serial_data_);
+		return serial_data_;
+	}
+
+	virtual void serializeTo(char * out)
+	{
+		*(reinterpret_cast<uint32_t *>(out)) = htonl(width_);
+		*(reinterpret_cast<uint32_t *>(out + 4)) = htonl(height_);
+		*(reinterpret_cast<uint32_t *>(out + 8)) = htonl(depth_);
+
+		memcpy((out + HEADER_SIZE), buffer_, (depth_offset_ * depth_));
+	}
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		if (length < HEADER_SIZE)
+			return false;
+
+		width_ = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
+		height_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
+		depth_ = ntohl(*(reinterpret_cast<const uint32_t *>(data + 8)));
+
+		depth_offset_ = width_ * height_;
+
+		data_len_ = HEADER_SIZE + (depth_offset_ * depth_);
+		if (length != data_len_)
+			return false;
+
+		buffer_ = new T[depth_offset_ * depth_];
+		memcpy(buffer_, (data + HEADER_SIZE), (depth_offset_ * depth_));
+
+		return true;
+	}
+
+	virtual size_t getLength() const { return data_len_; }
+
+protected:
+	uint32_t index(uint32_t x, uint32_t y, uint32_t z) const { return x + (width_ * y) + (depth_offset_ * z); }
+
+	virtual void print(std::ostream & os) const
+	{
+		os << "Matrix3D:" << std::endl << 
+			"\tWidth=" << width_ << ", Height=" << height_ << ", Depth=" << depth_ << std::endl;
+	}
+
+private:
+	// Non-copyable.
+	Matrix3D(const Matrix3D &);
+	void operator=(const Matrix3D &);
+};
+
+typedef Matrix3D<uint8_t> matrix3d_u8;
+typedef std::shared_ptr<matrix3d_u8> matrix3d_u8_ptr;
+
+
+// The maze itself (wall bits and goal room) for clients that render the map on their own.
+class WallMap : public GameData
+{
+	static const size_t HEADER_SIZE = 24;
+
+	std::shared_ptr<WallMatrix> walls_;
+	Vertex3DEx goal_;
+
+	std::vector<char> serial_data_;
+
+public:
+	// Constructor for message receiver.
+	WallMap() {}
+
+	// Constructor for message sender.
+	WallMap(const WallMatrix & walls, const Vertex3DEx & goal) :
+		goal_(goal), serial_data_(HEADER_SIZE + walls.getSerialSize())
+	{
+		*(reinterpret_cast<uint32_t *>(&serial_data_[0])) = htonl(walls.getWidth());
+		*(reinterpret_cast<uint32_t *>(&serial_data_[4])) = htonl(walls.getHeight());
+		*(reinterpret_cast<uint32_t *>(&serial_data_[8])) = htonl(walls.getDepth());
+		*(reinterpret_cast<uint32_t *>(&serial_data_[12])) = htonl(goal.x);
+		*(reinterpret_cast<uint32_t *>(&serial_data_[16])) = htonl(goal.y);
+		*(reinterpret_cast<uint32_t *>(&serial_data_[20])) = htonl(goal.z);
+		walls.serializePlanes(&serial_data_[HEADER_SIZE]);
+	}
+
+	const std::shared_ptr<WallMatrix> & getWalls() const { return walls_; }
+	const Vertex3DEx & getGoal() const { return goal_; }
+
+	virtual char * serializeData() { return &serial_data_[0]; }
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		if (length < HEADER_SIZE)
+			return false;
+
+		uint32_t width = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
+		uint32_t height = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
+		uint32_t depth = ntohl(*(reinterpret_cast<const uint32_t *>(data + 8)));
+		goal_.x = ntohl(*(reinterpret_cast<const uint32_t *>(data + 12)));
+		goal_.y = ntohl(*(reinterpret_cast<const uint32_t *>(data + 16)));
+		goal_.z = ntohl(*(reinterpret_cast<const uint32_t *>(data + 20)));
+
+		uint64_t total_rooms = static_cast<uint64_t>(width) * height * depth;
+		if ( !total_rooms || (total_rooms > (static_cast<uint64_t>(length) * 8)) || (goal_.x >= width) ||
+			(goal_.y >= height) || (goal_.z >= depth) )
+			return false;
+
+		walls_ = std::make_shared<WallMatrix>(width, height, depth);
+		if (length != (HEADER_SIZE + walls_->getSerialSize()))
+		{
+			walls_ = nullptr;
+			return false;
+		}
+
+		walls_->deserializePlanes(data + HEADER_SIZE);
+		return true;
+	}
+
+	virtual size_t getLength() const { return serial_data_.size(); }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "WallMap: Goal=(" << goal_.x << ", " << goal_.y << ", " << goal_.z << ")" << std::endl;
+	}
+};
+
+typedef std::shared_ptr<WallMap> wall_map_ptr;
+
+
+// Just enough for a client to regenerate the maze itself: the configuration (algorithm and seed included), the goal
+// room and a checksum of the wall bits the client's result must match.
+class SeedMap : public GameData
+{
+	static const size_t DATA_SIZE = 44;
+
+	MazeConfig config_;
+	Vertex3DEx goal_;
+	uint64_t checksum_;
+
+	char serial_data_[DATA_SIZE];
+
+public:
+	// Constructor for message receiver.
+	SeedMap() :
+		checksum_(0)
+	{}
+
+	// Constructor for message sender.
+	SeedMap(const MazeConfig & config, const Vertex3DEx & goal, uint64_t checksum) :
+		config_(config), goal_(goal), checksum_(checksum)
+	{}
+
+	const MazeConfig & getConfig() const { return config_; }
+	const Vertex3DEx & getGoal() const { return goal_; }
+	uint64_t getChecksum() const { return checksum_; }
+
+	virtual char * serializeData()
+	{
+		*(reinterpret_cast<uint32_t *>(serial_data_)) = htonl(config_.width);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 4)) = htonl(config_.height);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 8)) = htonl(config_.levels);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 12)) = htonl(config_.algorithm);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 16)) = htonl(static_cast<uint32_t>(config_.seed >> 32));
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 20)) = htonl(static_cast<uint32_t>(config_.seed));
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 24)) = htonl(goal_.x);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 28)) = htonl(goal_.y);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 32)) = htonl(goal_.z);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 36)) = htonl(static_cast<uint32_t>(checksum_ >> 32));
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 40)) = htonl(static_cast<uint32_t>(checksum_));
+		return serial_data_;
+	}
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		if (length != DATA_SIZE)
+			return false;
+
+		config_.width = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
+		config_.height = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
+		config_.levels = ntohl(*(reinterpret_cast<const uint32_t *>(data + 8)));
+		config_.algorithm = static_cast<MazeConfig::eAlgorithm>(ntohl(*(reinterpret_cast<const uint32_t *>(data + 12))));
+		config_.seed = (static_cast<uint64_t>(ntohl(*(reinterpret_cast<const uint32_t *>(data + 16)))) << 32) |
+			ntohl(*(reinterpret_cast<const uint32_t *>(data + 20)));
+		goal_.x = ntohl(*(reinterpret_cast<const uint32_t *>(data + 24)));
+		goal_.y = ntohl(*(reinterpret_cast<const uint32_t *>(data + 28)));
+		goal_.z = ntohl(*(reinterpret_cast<const uint32_t *>(data + 32)));
+		checksum_ = (static_cast<uint64_t>(ntohl(*(reinterpret_cast<const uint32_t *>(data + 36)))) << 32) |
+			ntohl(*(reinterpret_cast<const uint32_t *>(data + 40)));
+		return true;
+	}
+
+	virtual size_t getLength() const { return DATA_SIZE; }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "SeedMap: Width=" << config_.width << ", Height=" << config_.height << ", Levels=" << config_.levels <<
+			", Algorithm=" << config_.algorithm << ", Seed=" << config_.seed << ", Checksum=" << checksum_ << std::endl;
+	}
+};
+
+typedef std::shared_ptr<SeedMap> seed_map_ptr;
+
+
+class Player : public GameData
+{
+	static const size_t DATA_SIZE = 16;
+
+	uint32_t player_id_;
+	Vertex3DEx pos_;
+
+	char serial_data_[DATA_SIZE];
+
+public:
+	Player() :
+		player_id_(0), pos_(0, 0, 0)
+	{}
+
+	Player(uint32_t player_id, const Vertex3DEx pos) :
+		player_id_(player_id), pos_(pos)
+	{}
+
+	uint32_t getPlayerId() const { return player_id_; }
+
+	Vertex3DEx & getPosition() { return pos_; }
+	const Vertex3DEx & getPosition() const { return pos_; }
+
+	void clear() { player_id_ = 0; }
+	bool isClear() const { return (player_id_ == 0); }
+
+	virtual char * serializeData()
+	{
+		*(reinterpret_cast<uint32_t *>(serial_data_)) = htonl(player_id_);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 4)) = htonl(pos_.x);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 8)) = htonl(pos_.y);
+		*(reinterpret_cast<uint32_t *>(serial_data_ + 12)) = htonl(pos_.z);
+		return serial_data_;
+	}
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		if (length != DATA_SIZE)
+			return false;
+
+		player_id_ = ntohl(*(reinterpret_cast<const uint32_t *>(data)));
+		pos_.x = ntohl(*(reinterpret_cast<const uint32_t *>(data + 4)));
+		pos_.y = ntohl(*(reinterpret_cast<const uint32_t *>(data + 8)));
+		pos_.z = ntohl(*(reinterpret_cast<const uint32_t *>(data + 12)));
+		return true;
+	}
+
+	virtual size_t getLength() const { return DATA_SIZE; }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "Player: ID=" << player_id_ << ", Pos=(" << pos_.x << ", " << pos_.y << ", " << pos_.z << ")" << std::endl;
+	}
+};
+
+typedef std::shared_ptr<Player> player_ptr;
+typedef std::map<uint32_t, player_ptr> player_map;
+
+
+// The positions of the players in a maze that moved since the previous frame, sent once per update tick in place of
+// a GC_UPDATE_NOTIFY per move.
+// Each entry is a varint key, (player ID << 3) | op, followed by the operands of its op:
+//   OP_LEFT to OP_TOP	one step from the player's previous position, matching MoveReq::MD_LEFT to MD_TOP; no operands
+//   OP_DELTA			zigzag varints dx, dy and dz from the player's previous position
+//   OP_ABSOLUTE		varints x, y and z
+// Absolute entries introduce each player and are repeated in periodic keyframes, so a receiver always resynchronises.
+class UpdateFrame : public GameData
+{
+public:
+	enum eEntryOp
+	{
+		OP_LEFT,
+		OP_RIGHT,
+		OP_UP,
+		OP_DOWN,
+		OP_BOTTOM,
+		OP_TOP,
+		OP_DELTA,
+		OP_ABSOLUTE,
+		OP_MAX
+	};
+
+	static const size_t MAX_PLAYERS = 64;
+
+	struct Entry
+	{
+		uint32_t player_id;
+		eEntryOp op;
+		Vertex3DEx pos; // Position for OP_ABSOLUTE, otherwise the change in two's complement
+	};
+
+private:
+	static const uint32_t OP_BITS = 3;
+
+	std::vector<Entry> entries_;
+
+	std::vector<char> serial_data_; // Appended to as entries are added
+
+public:
+	UpdateFrame() {}
+
+	// A player whose previous position the receiver does not know (or should not rely on).
+	void addPlayer(uint32_t player_id, const Vertex3DEx & pos)
+	{
+		Entry entry = { player_id, OP_ABSOLUTE, pos };
+		addEntry(entry);
+	}
+
+	// A player that moved from base, the position the receiver last saw.
+	void addPlayer(uint32_t player_id, const Vertex3DEx & pos, const Vertex3DEx & base)
+	{
+		Entry entry = { player_id, OP_DELTA, Vertex3DEx(pos.x - base.x, pos.y - base.y, pos.z - base.z) };
+		for (int op = OP_LEFT; op < OP_DELTA; ++op)
+		{
+			if (entry.pos == getStep(static_cast<eEntryOp>(op)))
+			{
+				entry.op = static_cast<eEntryOp>(op);
+				break;
+			}
+		}
+		addEntry(entry);
+	}
+
+	size_t getPlayerCount() const { return entries_.size(); }
+	uint32_t getPlayerId(size_t index) const { return entries_[index].player_id; }
+
+	// The new position of a player, given the position the receiver last saw.
+	Vertex3DEx getPosition(size_t index, const Vertex3DEx & base) const { return applyEntry(entries_[index], base); }
+
+	static Vertex3DEx applyEntry(const Entry & entry, const Vertex3DEx & base)
+	{
+		if (entry.op == OP_ABSOLUTE)
+			return entry.pos;
+
+		Vertex3DEx delta = (entry.op == OP_DELTA ? entry.pos : getStep(entry.op));
+		return Vertex3DEx(base.x + delta.x, base.y + delta.y, base.z + delta.z);
+	}
+
+	// Decode the entry at data and advance past it, so a frame can be walked in place without building an UpdateFrame.
+	static bool readEntry(const char *& data, const char * end, Entry & entry)
+	{
+		uint32_t key;
+		if (!readVarint(data, end, key))
+			return false;
+
+		entry.player_id = key >> OP_BITS;
+		entry.op = static_cast<eEntryOp>(key & ((1 << OP_BITS) - 1));
+		if (entry.op >= OP_DELTA)
+		{
+			if ( !readVarint(data, end, entry.pos.x) || !readVarint(data, end, entry.pos.y) ||
+				!readVarint(data, end, entry.pos.z) )
+				return false;
+
+			if (entry.op == OP_DELTA)
+				entry.pos = Vertex3DEx(unzigzag(entry.pos.x), unzigzag(entry.pos.y), unzigzag(entry.pos.z));
+		}
+		return true;
+	}
+
+	virtual char * serializeData() { return (serial_data_.empty() ? nullptr : &serial_data_[0]); }
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		const char * end = data + length;
+		entries_.clear();
+		while (data != end)
+		{
+			Entry entry;
+			if ( (entries_.size() == MAX_PLAYERS) || !readEntry(data, end, entry) )
+				return false;
+			entries_.push_back(entry);
+		}
+		return true;
+	}
+
+	virtual size_t getLength() const { return serial_data_.size(); }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "UpdateFrame: Players=" << entries_.size() << ", Length=" << serial_data_.size() << std::endl;
+	}
+
+private:
+	static Vertex3DEx getStep(eEntryOp op)
+	{
+		static const int32_t steps[OP_DELTA][3] = { { -2, 0, 0 }, { 2, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 },
+			{ 0, 0, 1 } };
+		return Vertex3DEx(steps[op][0], steps[op][1], steps[op][2]);
+	}
+
+	static uint32_t zigzag(uint32_t value) { return (value << 1) ^ (0 - (value >> 31)); }
+	static uint32_t unzigzag(uint32_t value) { return (value >> 1) ^ (0 - (value & 1)); }
+
+	void addEntry(const Entry & entry)
+	{
+		entries_.push_back(entry);
+		writeVarint((entry.player_id << OP_BITS) | entry.op);
+		if (entry.op == OP_ABSOLUTE)
+		{
+			writeVarint(entry.pos.x);
+			writeVarint(entry.pos.y);
+			writeVarint(entry.pos.z);
+		}
+		else if (entry.op == OP_DELTA)
+		{
+			writeVarint(zigzag(entry.pos.x));
+			writeVarint(zigzag(entry.pos.y));
+			writeVarint(zigzag(entry.pos.z));
+		}
+	}
+
+	void writeVarint(uint32_t value)
+	{
+		for (; value >= 0x80; value >>= 7)
+			serial_data_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+		serial_data_.push_back(static_cast<char>(value));
+	}
+
+	static bool readVarint(const char *& data, const char * end, uint32_t & value)
+	{
+		value = 0;
+		for (uint32_t shift = 0; (data != end) && (shift < 35); shift += 7)
+		{
+			uint8_t byte = static_cast<uint8_t>(*data++);
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return true;
+		}
+		return false;
+	}
+};
+
+typedef std::shared_ptr<UpdateFrame> update_frame_ptr;
+
+
+class MoveReq : public GameData
+{
+	static const size_t DATA_SIZE = 4;
+
+	char serial_data_[DATA_SIZE];
+
+public:
+	enum eMoveDir
+	{
+		MD_NONE,
+		MD_LEFT,
+		MD_RIGHT,
+		MD_UP,
+		MD_DOWN,
+		MD_BOTTOM,
+		MD_TOP
+	};
+
+	// Constructor for message receiver.
+	MoveReq() :
+		move_dir_(MD_NONE)
+	{}
+
+	// Constructor for message sender.
+	MoveReq(eMoveDir dir) :
+		move_dir_(dir)
+	{}
+
+	eMoveDir getMoveDir() const { return move_dir_; }
+
+	virtual char * serializeData()
+	{
+		*(reinterpret_cast<uint32_t *>(serial_data_)) = htonl(move_dir_);
+		return serial_data_;
+	}
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		if (length != DATA_SIZE)
+			return false;
+
+		move_dir_ = static_cast<eMoveDir>(ntohl(*(reinterpret_cast<const uint32_t *>(data))));
+		return true;
+	}
+
+	virtual size_t getLength() const { return DATA_SIZE; }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "MoveReq: Dir=" << move_dir_ << std::endl;
+	}
+
+private:
+	eMoveDir move_dir_;
+};
+
+typedef std::shared_ptr<MoveReq> move_req_ptr;
+
+
+// A run of moves sent as one request.  Each step is one byte: a MoveReq::eMoveDir, optionally flagged with STEP_RUN
+// to keep following the passage from there until it reaches a junction, a dead end, a stairwell or the goal.
+// The server applies the steps in order, stops at the first one that is blocked and sends the result as one update.
+class PathReq : public GameData
+{
+public:
+	static const size_t MAX_STEPS = 64;
+	static const uint8_t STEP_RUN = 0x80;
+
+private:
+	std::vector<char> steps_;
+
+public:
+	PathReq() {}
+
+	void addStep(MoveReq::eMoveDir dir, bool run = false)
+	{
+		steps_.push_back(static_cast<char>(run ? (dir | STEP_RUN) : dir));
+	}
+
+	size_t getNumSteps() const { return steps_.size(); }
+	const char * getSteps() const { return (steps_.empty() ? nullptr : &steps_[0]); }
+
+	static MoveReq::eMoveDir getStepDir(char step)
+	{
+		return static_cast<MoveReq::eMoveDir>(static_cast<uint8_t>(step) & ~STEP_RUN);
+	}
+
+	static bool isRun(char step) { return ((static_cast<uint8_t>(step) & STEP_RUN) != 0); }
+
+	virtual char * serializeData() { return &steps_[0]; }
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		if ( (length == 0) || (length > MAX_STEPS) )
+			return false;
+
+		steps_.assign(data, data + length);
+		return true;
+	}
+
+	virtual size_t getLength() const { return steps_.size(); }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "PathReq: Steps=" << steps_.size() << std::endl;
+	}
+};
+
+typedef std::shared_ptr<PathReq> path_req_ptr;
+
+#endif // GAME_DATA_H
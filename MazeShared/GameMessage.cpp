@@ -1,98 +1,148 @@
-#include "GameMessage.h"
-
-
-bool GameMessage::decodeHeader()
-{
-	body_length_ = ntohl(*(reinterpret_cast<uint32_t *>(data_)));
-	if (body_length_ > MAX_SIZE)
-	{
-		std::cerr << "ERROR: GameMessage::decodeHeader [Message exceeds maximum size]" << std::endl;
-		return false;
-	}
-
-	game_code_ = static_cast<eGameCode>(ntohs(*(reinterpret_cast<uint16_t *>(data_ + LENGTH_SIZE))));
-	if ( (game_code_ <= GC_NONE) || (game_code_ >= GC_MAX) )
-	{
-		std::cerr << "ERROR: GameMessage::decodeHeader [Invalid game message code " << game_code_ << "]" << std::endl;
-		return false;
-	}
-
-	return true;
-}
-
-game_data_ptr GameMessage::decodeBody()
-{
-	switch (game_code_)
-	{
-	case GC_ID_NOTIFY:
-		game_data_ = std::make_shared<PlayerID>();
-		break;
-	case GC_GAMES_NOTIFY:
-		game_data_ = std::make_shared<GameSummary>();
-		break;
-	case GC_CREATE_REQ:
-		game_data_ = std::make_shared<GameConfig>();
-		break;
-	case GC_SELECT_GAME_REQ:
-		game_data_ = std::make_shared<GameSelect>();
-		break;
-	case GC_SELECT_GAME_RESP:
-		game_data_ = std::make_shared<GameSelectResp>();
-		break;
-	case GC_START_NOTIFY:
-		game_data_ = std::make_shared<matrix3d_u8>();
-		break;
-	case GC_UPDATE_NOTIFY:
-		game_data_ = std::make_shared<Player>();
-		break;
-	case GC_MOVE_REQ:
-		game_data_ = std::make_shared<MoveReq>();
-		break;
-	case GC_WINNER_NOTIFY:
-		game_data_ = std::make_shared<Winner>();
-		break;
-	default:
-		std::cerr << "ERROR: GameMessage::decodeBody [Unexpected game message code " << game_code_ << "]" << std::endl;
-		game_data_ = nullptr;
-		break;
-	}
-	
-	if (game_data_)
-	{
-		if (!game_data_->deserializeData(body(), bodyLength()))
-		{
-			game_data_ = nullptr;
-		}
-	}
-
-	return game_data_;
-}
-
-void GameMessage::processSerialData(const char * serial_data)
-{
-	if (body_length_ > MAX_SIZE)
-		throw std::runtime_error("GameMessage::processSerialData: [Message exceeds maximum size]");
-
-	char * ptr = data_;
-	*(reinterpret_cast<uint32_t *>(ptr)) = htonl(static_cast<const uint32_t>(body_length_));
-	ptr += LENGTH_SIZE;
-
-	*(reinterpret_cast<uint16_t *>(ptr)) = htons(static_cast<const uint16_t>(game_code_));
-	ptr += CODE_SIZE;
-
-	memcpy(ptr, serial_data, body_length_);
-}
-
-std::ostream & operator<<(std::ostream & os, const GameMessage & game_msg)
-{
-	os << "GameMessage: Length=" << game_msg.length() << ", Code=" << game_msg.game_code_ << std::endl;
-	if (game_msg.game_data_)
-		os << *game_msg.game_data_;
-	else
-	{
-		os << "Raw: ";
-		os.write(game_msg.body(), game_msg.bodyLength());
-		os << std::endl;
-	}
-	return os;
-}
+#include "GameMessage.h"
+#include "MapCodec.h"
+
+
+bool GameMessage::decodeHeader()
+{
+	const char * header = buffer_->data();
+	body_length_ = ntohl(*(reinterpret_cast<const uint32_t *>(header)));
+	if (body_length_ > MAX_SIZE)
+	{
+		std::cerr << "ERROR: GameMessage::decodeHeader [Message exceeds maximum size]" << std::endl;
+		return false;
+	}
+
+	game_code_ = static_cast<eGameCode>(ntohs(*(reinterpret_cast<const uint16_t *>(header + LENGTH_SIZE))));
+	if ( (game_code_ <= GC_NONE) || (game_code_ >= GC_MAX) )
+	{
+		std::cerr << "ERROR: GameMessage::decodeHeader [Invalid game message code " << game_code_ << "]" << std::endl;
+		return false;
+	}
+
+	// Move to a buffer sized for this body, so a large message does not pin a large buffer for the next read.
+	game_data_ = nullptr;
+	if ( (buffer_->refs > 1) || (buffer_->capacity != MessagePool::getCapacity(length())) )
+	{
+		message_buffer_ptr buffer = MessagePool::instance().acquire(length());
+		memcpy(buffer->data(), header, HEADER_SIZE);
+		buffer_.swap(buffer);
+	}
+
+	return true;
+}
+
+game_data_ptr GameMessage::decodeBody()
+{
+	// Chunked messages that were decoded as they streamed in already carry their data.
+	if (game_data_)
+		return game_data_;
+
+	game_data_ = createGameData(game_code_);
+	if (!game_data_)
+	{
+		std::cerr << "ERROR: GameMessage::decodeBody [Unexpected game message code " << game_code_ << "]" << std::endl;
+		return game_data_;
+	}
+
+	if (!game_data_->deserializeData(body(), bodyLength()))
+	{
+		game_data_ = nullptr;
+	}
+
+	return game_data_;
+}
+
+game_data_ptr GameMessage::createGameData(eGameCode game_code)
+{
+	switch (game_code)
+	{
+	case GC_ID_NOTIFY:
+		return std::make_shared<PlayerID>();
+	case GC_GAMES_NOTIFY:
+		return std::make_shared<GameSummary>();
+	case GC_CREATE_REQ:
+		return std::make_shared<GameConfig>();
+	case GC_SELECT_GAME_REQ:
+		return std::make_shared<GameSelect>();
+	case GC_SELECT_GAME_RESP:
+		return std::make_shared<GameSelectResp>();
+	case GC_START_NOTIFY:
+		return std::make_shared<matrix3d_u8>();
+	case GC_UPDATE_NOTIFY:
+		return std::make_shared<Player>();
+	case GC_MOVE_REQ:
+		return std::make_shared<MoveReq>();
+	case GC_PATH_REQ:
+		return std::make_shared<PathReq>();
+	case GC_WINNER_NOTIFY:
+		return std::make_shared<Winner>();
+	case GC_CAPABILITIES_NOTIFY:
+		return std::make_shared<Capabilities>();
+	case GC_PACKED_START_NOTIFY:
+		return std::make_shared<PackedMap>();
+	case GC_WALLS_START_NOTIFY:
+		return std::make_shared<WallMap>();
+	case GC_SEED_START_NOTIFY:
+		return std::make_shared<SeedMap>();
+	case GC_UPDATE_FRAME_NOTIFY:
+		return std::make_shared<UpdateFrame>();
+	default:
+		return nullptr;
+	}
+}
+
+void GameMessage::processSerialData(const char * serial_data)
+{
+	if (body_length_ > MAX_PAYLOAD_SIZE)
+		throw std::runtime_error("GameMessage::processSerialData: [Message exceeds maximum size]");
+
+	allocate(game_code_, body_length_);
+	memcpy(body(), serial_data, body_length_);
+}
+
+void GameMessage::processGameData(GameData * game_data)
+{
+	if (body_length_ > MAX_PAYLOAD_SIZE)
+		throw std::runtime_error("GameMessage::processGameData: [Message exceeds maximum size]");
+
+	allocate(game_code_, body_length_);
+	game_data->serializeTo(body());
+}
+
+void GameMessage::allocate(eGameCode game_code, size_t body_length)
+{
+	game_code_ = game_code;
+	body_length_ = body_length;
+	game_data_ = nullptr;
+	buffer_ = MessagePool::instance().acquire(length());
+
+	char * ptr = buffer_->data();
+	*(reinterpret_cast<uint32_t *>(ptr)) = htonl(static_cast<const uint32_t>(body_length_));
+	ptr += LENGTH_SIZE;
+
+	*(reinterpret_cast<uint16_t *>(ptr)) = htons(static_cast<const uint16_t>(game_code_));
+}
+
+void GameMessage::detach()
+{
+	if (buffer_->refs > 1)
+	{
+		message_buffer_ptr buffer = MessagePool::instance().acquire(length());
+		memcpy(buffer->data(), buffer_->data(), length());
+		buffer_.swap(buffer);
+	}
+}
+
+std::ostream & operator<<(std::ostream & os, const GameMessage & game_msg)
+{
+	os << "GameMessage: Length=" << game_msg.length() << ", Code=" << game_msg.game_code_ << std::endl;
+	if (game_msg.game_data_)
+		os << *game_msg.game_data_;
+	else
+	{
+		os << "Raw: ";
+		os.write(game_msg.body(), game_msg.bodyLength());
+		os << std::endl;
+	}
+	return os;
+}
@@ -1,68 +1,105 @@
-#ifndef GAME_STRUCTS_H
-#define GAME_STRUCTS_H
-
-#include <cstdint>
-#include <iostream>
-#include <vector>
-
-
-struct MazeConfig
-{
-	static const uint32_t MIN_WIDTH = 3;
-	static const uint32_t MIN_HEIGHT = 3;
-	static const uint32_t MIN_LEVELS = 1;
-	static const uint32_t MAX_WIDTH = 19;
-	static const uint32_t MAX_HEIGHT = 11;
-	static const uint32_t MAX_LEVELS = 10;
-
-	uint32_t width;
-	uint32_t height;
-	uint32_t levels;
-
-	MazeConfig() :
-		width(0), height(0), levels(0)
-	{}
-		
-	MazeConfig(uint32_t width_, uint32_t height_, uint32_t levels_) :
-		width(width_), height(height_), levels(levels_)
-	{}
-
-	void print() const
-	{
-		std::cout << "Maze configuration: [" << "Width=" << width << ", Height=" << height << ", Levels=" << levels << "]" << std::endl;
-	}
-
-	uint32_t getTotalRooms() const { return width * height * levels; }
-};
-
-typedef std::vector<MazeConfig> maze_config_vec;
-
-
-struct Vertex3DEx
-{
-	uint32_t x, y, z, extra;
-
-	Vertex3DEx() :
-		x(0), y(0), z(0), extra(0)
-	{}
-
-	Vertex3DEx(uint32_t _x, uint32_t _y, uint32_t _z, uint32_t _extra = 0) :
-		x(_x), y(_y), z(_z), extra(_extra)
-	{}
-
-	bool operator==(const Vertex3DEx & other)
-	{
-		return ( (x == other.x) && (y == other.y) && (z == other.z) );
-	}
-
-	bool operator!=(const Vertex3DEx & other) { return !(*this == other); }
-
-	void print() const
-	{
-		std::cout << "Vertex 3D: [" << "X=" << x << ", Y=" << y << ", Z=" << z << ", Ex=" << extra << "]" << std::endl;
-	}
-};
-
-typedef std::vector<Vertex3DEx> vertex3d_vec;
-
-#endif // GAME_STRUCTS_H
+#ifndef GAME_STRUCTS_H
+#define GAME_STRUCTS_H
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+
+struct MazeConfig
+{
+	enum eAlgorithm
+	{
+		MA_PRIM,
+		MA_KRUSKAL,
+		MA_WILSON,
+		MA_GROWING_TREE,
+		MA_BACKTRACKER,
+		MA_ELLER,
+		MA_PARALLEL,
+		/* Insert new algorithms before MA_MAX */
+		MA_MAX
+	};
+
+	static const uint32_t MIN_WIDTH = 3;
+	static const uint32_t MIN_HEIGHT = 3;
+	static const uint32_t MIN_LEVELS = 1;
+
+	// Absolute ceiling; the server enforces its own configured limits at or below these.
+	static const uint32_t MAX_WIDTH = 2048;
+	static const uint32_t MAX_HEIGHT = 2048;
+	static const uint32_t MAX_LEVELS = 64;
+
+	// Default server limits.
+	static const uint32_t DEF_MAX_WIDTH = 19;
+	static const uint32_t DEF_MAX_HEIGHT = 11;
+	static const uint32_t DEF_MAX_LEVELS = 10;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	eAlgorithm algorithm;
+	uint64_t seed; // 0 lets the server choose one
+
+	MazeConfig() :
+		width(0), height(0), levels(0), algorithm(MA_PRIM), seed(0)
+	{}
+		
+	MazeConfig(uint32_t width_, uint32_t height_, uint32_t levels_, eAlgorithm algorithm_ = MA_PRIM, uint64_t seed_ = 0) :
+		width(width_), height(height_), levels(levels_), algorithm(algorithm_), seed(seed_)
+	{}
+
+	static const char * getAlgorithmName(eAlgorithm algorithm)
+	{
+		static const char * names[MA_MAX] = { "Prim", "Kruskal", "Wilson", "Growing tree", "Recursive backtracker", "Eller",
+			"Parallel Kruskal" };
+		return (algorithm < MA_MAX ? names[algorithm] : "Unknown");
+	}
+
+	void print() const
+	{
+		std::cout << "Maze configuration: [" << "Width=" << width << ", Height=" << height << ", Levels=" << levels <<
+			", Algorithm=" << getAlgorithmName(algorithm) << ", Seed=" << seed << "]" << std::endl;
+	}
+
+	uint32_t getTotalRooms() const { return width * height * levels; }
+
+	bool isWithin(const MazeConfig & limits) const
+	{
+		return ( (width >= MIN_WIDTH) && (width <= limits.width) &&
+				 (height >= MIN_HEIGHT) && (height <= limits.height) &&
+				 (levels >= MIN_LEVELS) && (levels <= limits.levels) );
+	}
+};
+
+typedef std::vector<MazeConfig> maze_config_vec;
+
+
+struct Vertex3DEx
+{
+	uint32_t x, y, z, extra;
+
+	Vertex3DEx() :
+		x(0), y(0), z(0), extra(0)
+	{}
+
+	Vertex3DEx(uint32_t _x, uint32_t _y, uint32_t _z, uint32_t _extra = 0) :
+		x(_x), y(_y), z(_z), extra(_extra)
+	{}
+
+	bool operator==(const Vertex3DEx & other)
+	{
+		return ( (x == other.x) && (y == other.y) && (z == other.z) );
+	}
+
+	bool operator!=(const Vertex3DEx & other) { return !(*this == other); }
+
+	void print() const
+	{
+		std::cout << "Vertex 3D: [" << "X=" << x << ", Y=" << y << ", Z=" << z << ", Ex=" << extra << "]" << std::endl;
+	}
+};
+
+typedef std::vector<Vertex3DEx> vertex3d_vec;
+
+#endif // GAME_STRUCTS_H
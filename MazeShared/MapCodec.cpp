@@ -0,0 +1,261 @@
+#include <algorithm>
+#include "MapCodec.h"
+#include "GameMessage.h"
+
+
+void MapModel::initModel(uint32_t width, uint32_t height, uint32_t depth, const std::vector<uint8_t> & alphabet)
+{
+	width_ = width;
+	height_ = height;
+	level_size_ = width * height;
+	total_cells_ = static_cast<size_t>(level_size_) * depth;
+	alphabet_ = alphabet;
+	alphabet_size_ = static_cast<uint32_t>(alphabet.size());
+
+	symbol_bits_ = 0;
+	while ((static_cast<uint32_t>(1) << symbol_bits_) < alphabet_size_)
+		++symbol_bits_;
+
+	std::fill(ranks_, ranks_ + 256, static_cast<uint16_t>(0));
+	for (uint32_t i = 0; i < alphabet_size_; ++i)
+		ranks_[alphabet[i]] = static_cast<uint16_t>(i);
+
+	probs_.assign(static_cast<size_t>(1) << (CONTEXT_BITS + symbol_bits_), static_cast<uint16_t>(PROB_INIT));
+	pos_ = 0;
+	x_ = y_ = 0;
+}
+
+
+void MapEncoder::encode(const matrix3d_u8 & map, std::vector<char> & out)
+{
+	const uint8_t * cells = map.data();
+	size_t total_cells = map.getSize();
+
+	// Rank the cell values by frequency, so the common ones share the shortest paths through the symbol tree.
+	size_t counts[256] = { 0 };
+	for (size_t i = 0; i < total_cells; ++i)
+		++counts[cells[i]];
+
+	std::vector<std::pair<size_t, int> > ranked;
+	for (int value = 0; value < 256; ++value)
+	{
+		if (counts[value])
+			ranked.push_back(std::make_pair(counts[value], -value));
+	}
+	std::sort(ranked.rbegin(), ranked.rend());
+
+	std::vector<uint8_t> alphabet;
+	for (size_t i = 0; i < ranked.size(); ++i)
+		alphabet.push_back(static_cast<uint8_t>(-ranked[i].second));
+
+	out.clear();
+	out.reserve(matrix3d_u8::HEADER_SIZE + ALPHABET_HEADER_SIZE + alphabet.size() + (total_cells / 8) + 16);
+	out.resize(matrix3d_u8::HEADER_SIZE + ALPHABET_HEADER_SIZE);
+	*(reinterpret_cast<uint32_t *>(&out[0])) = htonl(map.getWidth());
+	*(reinterpret_cast<uint32_t *>(&out[4])) = htonl(map.getHeight());
+	*(reinterpret_cast<uint32_t *>(&out[8])) = htonl(map.getDepth());
+	*(reinterpret_cast<uint16_t *>(&out[matrix3d_u8::HEADER_SIZE])) = htons(static_cast<uint16_t>(alphabet.size()));
+	out.insert(out.end(), alphabet.begin(), alphabet.end());
+
+	MapEncoder encoder(out);
+	encoder.initModel(map.getWidth(), map.getHeight(), map.getDepth(), alphabet);
+	for (; encoder.pos_ < total_cells; encoder.advance())
+	{
+		uint16_t * probs = encoder.getContext(cells);
+		uint32_t rank = encoder.ranks_[cells[encoder.pos_]];
+		uint32_t node = 1;
+		for (uint32_t bit_num = encoder.symbol_bits_; bit_num > 0; --bit_num)
+		{
+			uint32_t bit = (rank >> (bit_num - 1)) & 1;
+			encoder.encodeBit(probs[node], bit);
+			node = (node << 1) | bit;
+		}
+	}
+	encoder.flush();
+}
+
+void MapEncoder::encodeBit(uint16_t & prob, uint32_t bit)
+{
+	uint32_t bound = (range_ >> PROB_BITS) * prob;
+	if (!bit)
+	{
+		range_ = bound;
+		prob += ((1 << PROB_BITS) - prob) >> ADAPT_SHIFT;
+	}
+	else
+	{
+		low_ += bound;
+		range_ -= bound;
+		prob -= prob >> ADAPT_SHIFT;
+	}
+
+	while (range_ < TOP_VALUE)
+	{
+		range_ <<= 8;
+		shiftLow();
+	}
+}
+
+void MapEncoder::shiftLow()
+{
+	// Bytes are held back while they could still be changed by a carry out of low_.
+	if ( (static_cast<uint32_t>(low_) < 0xFF000000) || ((low_ >> 32) != 0) )
+	{
+		uint8_t carry = static_cast<uint8_t>(low_ >> 32);
+		uint8_t temp = cache_;
+		do
+		{
+			out_.push_back(static_cast<char>(temp + carry));
+			temp = 0xFF;
+		} while (--cache_size_ != 0);
+		cache_ = static_cast<uint8_t>(low_ >> 24);
+	}
+	++cache_size_;
+	low_ = (low_ & 0x00FFFFFF) << 8;
+}
+
+void MapEncoder::flush()
+{
+	for (int i = 0; i < 5; ++i)
+		shiftLow();
+}
+
+
+bool MapDecoder::feed(const char * data, size_t length)
+{
+	if (stage_ == DS_ERROR)
+		return false;
+
+	// Drop consumed input before appending, so at most one cell's worth of bytes is ever carried over.
+	input_.erase(input_.begin(), input_.begin() + input_pos_);
+	input_pos_ = 0;
+	input_.insert(input_.end(), data, data + length);
+
+	return run(false);
+}
+
+bool MapDecoder::finish()
+{
+	if (!run(true) || (stage_ != DS_DONE))
+	{
+		std::cerr << "ERROR: MapDecoder::finish [Packed map is truncated or corrupt]" << std::endl;
+		stage_ = DS_ERROR;
+		return false;
+	}
+	return true;
+}
+
+bool MapDecoder::run(bool final)
+{
+	if (stage_ == DS_HEADER)
+	{
+		if (available() < (matrix3d_u8::HEADER_SIZE + ALPHABET_HEADER_SIZE))
+			return true;
+		if (!decodeHeader())
+		{
+			stage_ = DS_ERROR;
+			return false;
+		}
+		stage_ = DS_ALPHABET;
+	}
+
+	if (stage_ == DS_ALPHABET)
+	{
+		if (available() < alphabet_size_)
+			return true;
+
+		std::vector<uint8_t> alphabet(input_.begin() + input_pos_, input_.begin() + input_pos_ + alphabet_size_);
+		input_pos_ += alphabet_size_;
+		initModel(map_->getWidth(), map_->getHeight(), map_->getDepth(), alphabet);
+		stage_ = DS_CODER;
+	}
+
+	if (stage_ == DS_CODER)
+	{
+		if (available() < CODER_INIT_SIZE)
+			return true;
+
+		for (size_t i = 0; i < CODER_INIT_SIZE; ++i)
+			code_ = (code_ << 8) | static_cast<uint8_t>(input_[input_pos_++]);
+		stage_ = DS_CELLS;
+	}
+
+	if (stage_ == DS_CELLS)
+	{
+		uint8_t * cells = map_->data();
+		while (pos_ < total_cells_)
+		{
+			// Only decode a cell once all the bytes it could need are here, unless no more input is coming.
+			if ( !final && (available() < MAX_BYTES_PER_CELL) )
+				return true;
+
+			uint16_t * probs = getContext(cells);
+			uint32_t node = 1;
+			for (uint32_t bit_num = symbol_bits_; bit_num > 0; --bit_num)
+				node = (node << 1) | decodeBit(probs[node]);
+
+			uint32_t rank = node - (static_cast<uint32_t>(1) << symbol_bits_);
+			if ( (rank >= alphabet_size_) || (input_pos_ > input_.size()) )
+			{
+				stage_ = DS_ERROR;
+				return false;
+			}
+
+			cells[pos_] = alphabet_[rank];
+			advance();
+		}
+		stage_ = DS_DONE;
+	}
+
+	return (stage_ != DS_ERROR);
+}
+
+bool MapDecoder::decodeHeader()
+{
+	const char * header = &input_[input_pos_];
+	uint32_t width = ntohl(*(reinterpret_cast<const uint32_t *>(header)));
+	uint32_t height = ntohl(*(reinterpret_cast<const uint32_t *>(header + 4)));
+	uint32_t depth = ntohl(*(reinterpret_cast<const uint32_t *>(header + 8)));
+	alphabet_size_ = ntohs(*(reinterpret_cast<const uint16_t *>(header + matrix3d_u8::HEADER_SIZE)));
+	input_pos_ += matrix3d_u8::HEADER_SIZE + ALPHABET_HEADER_SIZE;
+
+	uint64_t total_cells = static_cast<uint64_t>(width) * height * depth;
+	if ( !width || !height || (total_cells > GameMessage::MAX_PAYLOAD_SIZE) || (alphabet_size_ > 256) ||
+		(!alphabet_size_ && total_cells) )
+	{
+		std::cerr << "ERROR: MapDecoder::decodeHeader [Invalid packed map header]" << std::endl;
+		return false;
+	}
+
+	map_ = std::make_shared<matrix3d_u8>(width, height, depth, 0);
+	return true;
+}
+
+uint32_t MapDecoder::decodeBit(uint16_t & prob)
+{
+	uint32_t bound = (range_ >> PROB_BITS) * prob;
+	uint32_t bit;
+	if (code_ < bound)
+	{
+		range_ = bound;
+		prob += ((1 << PROB_BITS) - prob) >> ADAPT_SHIFT;
+		bit = 0;
+	}
+	else
+	{
+		code_ -= bound;
+		range_ -= bound;
+		prob -= prob >> ADAPT_SHIFT;
+		bit = 1;
+	}
+
+	while (range_ < TOP_VALUE)
+	{
+		range_ <<= 8;
+		// Running past the end of the input is caught by the caller; treat missing bytes as zero meanwhile.
+		uint8_t next = (input_pos_ < input_.size() ? static_cast<uint8_t>(input_[input_pos_]) : 0);
+		++input_pos_;
+		code_ = (code_ << 8) | next;
+	}
+	return bit;
+}
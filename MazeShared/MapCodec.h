@@ -0,0 +1,171 @@
+#ifndef MAP_CODEC_H
+#define MAP_CODEC_H
+
+#include <vector>
+#include "GameData.h"
+
+
+// Compressed encoding of a world map (matrix3d_u8), sent as GC_PACKED_START_NOTIFY to clients that support it.
+// Cells are replaced by their rank in a per-map alphabet and coded bit by bit with an adaptive binary range coder.
+// Each bit's probability is conditioned on the cells to the left, one row up and two rows up, and on the position
+// within a room (column mod 4 and row parity), which together predict almost all of the box-drawing structure.
+//
+// Stream layout: the 12-byte Matrix3D header, the alphabet size (2 bytes), the alphabet in rank order, then the
+// range-coded cells.
+class MapModel
+{
+public:
+	static const size_t ALPHABET_HEADER_SIZE = 2;
+
+protected:
+	static const uint32_t PROB_BITS = 12;
+	static const uint16_t PROB_INIT = 1 << (PROB_BITS - 1);
+	static const uint32_t ADAPT_SHIFT = 4;
+	static const uint32_t CONTEXT_BITS = 12;
+	static const uint32_t TOP_VALUE = 1 << 24;
+
+	MapModel() :
+		width_(0), height_(0), level_size_(0), total_cells_(0), alphabet_size_(0), symbol_bits_(0), pos_(0), x_(0), y_(0)
+	{}
+
+	void initModel(uint32_t width, uint32_t height, uint32_t depth, const std::vector<uint8_t> & alphabet);
+
+	// Probability slots for the cell at pos_, given the cells already coded.
+	uint16_t * getContext(const uint8_t * cells)
+	{
+		uint32_t sentinel = alphabet_size_;
+		uint32_t left = (x_ > 0 ? ranks_[cells[pos_ - 1]] : sentinel);
+		uint32_t up1 = (y_ > 0 ? ranks_[cells[pos_ - width_]] : sentinel);
+		uint32_t up2 = (y_ > 1 ? ranks_[cells[pos_ - (2 * width_)]] : sentinel);
+		uint32_t context = left | (up1 << 9) | (up2 << 18) | ((x_ & 3) << 27) | ((y_ & 1) << 29);
+		uint32_t slot = (context * 2654435761u) >> (32 - CONTEXT_BITS);
+		return &probs_[static_cast<size_t>(slot) << symbol_bits_];
+	}
+
+	void advance()
+	{
+		++pos_;
+		if (++x_ == width_)
+		{
+			x_ = 0;
+			if (++y_ == height_)
+				y_ = 0;
+		}
+	}
+
+	uint32_t width_, height_, level_size_;
+	size_t total_cells_;
+	uint32_t alphabet_size_, symbol_bits_;
+	std::vector<uint8_t> alphabet_; // Cell value of each rank
+	uint16_t ranks_[256]; // Rank of each cell value
+	std::vector<uint16_t> probs_; // Probability of a 0 bit, per context and symbol tree node
+	size_t pos_;
+	uint32_t x_, y_;
+};
+
+
+class MapEncoder : public MapModel
+{
+public:
+	static void encode(const matrix3d_u8 & map, std::vector<char> & out);
+
+private:
+	explicit MapEncoder(std::vector<char> & out) :
+		out_(out), low_(0), range_(0xFFFFFFFF), cache_(0), cache_size_(1)
+	{}
+
+	void encodeBit(uint16_t & prob, uint32_t bit);
+	void shiftLow();
+	void flush();
+
+	std::vector<char> & out_;
+	uint64_t low_;
+	uint32_t range_;
+	uint8_t cache_;
+	uint64_t cache_size_;
+};
+
+
+// Decodes a packed map incrementally: feed() accepts the stream in pieces of any size and decodes as far as the
+// input allows, so a map arriving in chunks is unpacked while it downloads.
+class MapDecoder : public MapModel
+{
+public:
+	MapDecoder() :
+		stage_(DS_HEADER), range_(0xFFFFFFFF), code_(0), input_pos_(0)
+	{}
+
+	bool feed(const char * data, size_t length);
+	bool finish();
+
+	bool isDone() const { return stage_ == DS_DONE; }
+	const matrix3d_u8_ptr & getMap() const { return map_; }
+
+private:
+	static const size_t MAX_BYTES_PER_CELL = 16; // Up to 8 bits, each renormalising by up to 2 bytes
+	static const size_t CODER_INIT_SIZE = 5;
+
+	enum eDecodeStage
+	{
+		DS_HEADER,
+		DS_ALPHABET,
+		DS_CODER,
+		DS_CELLS,
+		DS_DONE,
+		DS_ERROR
+	};
+
+	bool run(bool final);
+	bool decodeHeader();
+	uint32_t decodeBit(uint16_t & prob);
+	size_t available() const { return input_.size() - input_pos_; }
+
+	eDecodeStage stage_;
+	matrix3d_u8_ptr map_;
+	uint32_t range_;
+	uint32_t code_;
+	std::vector<char> input_; // Received bytes not yet consumed start at input_pos_
+	size_t input_pos_;
+};
+
+
+class PackedMap : public GameData
+{
+	std::vector<char> packed_;
+	MapDecoder decoder_;
+
+public:
+	// Constructor for message receiver.
+	PackedMap() {}
+
+	// Constructor for message sender.
+	explicit PackedMap(const matrix3d_u8 & map)
+	{
+		MapEncoder::encode(map, packed_);
+	}
+
+	const matrix3d_u8_ptr & getMap() const { return decoder_.getMap(); }
+
+	virtual char * serializeData() { return &packed_[0]; }
+
+	virtual bool deserializeData(const char * data, size_t length)
+	{
+		return (decoder_.feed(data, length) && decoder_.finish());
+	}
+
+	virtual size_t getLength() const { return packed_.size(); }
+
+	virtual bool beginStream(size_t /*length*/) { return true; }
+	virtual bool deserializeStream(const char * data, size_t length) { return decoder_.feed(data, length); }
+	virtual bool endStream() { return decoder_.finish(); }
+
+protected:
+	virtual void print(std::ostream & os) const
+	{
+		os << "PackedMap: Length=" << packed_.size() << std::endl;
+	}
+};
+
+typedef std::shared_ptr<PackedMap> packed_map_ptr;
+
+#endif // MAP_CODEC_H
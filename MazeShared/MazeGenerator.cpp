@@ -0,0 +1,620 @@
+#include <limits>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp>
+#include "MazeGenerator.h"
+
+
+std::unique_ptr<MazeGenerator> MazeGenerator::create(MazeConfig::eAlgorithm algorithm, uint64_t seed)
+{
+	std::unique_ptr<MazeGenerator> generator;
+	switch (algorithm)
+	{
+	case MazeConfig::MA_PRIM: generator.reset(new PrimGenerator()); break;
+	case MazeConfig::MA_KRUSKAL: generator.reset(new KruskalGenerator()); break;
+	case MazeConfig::MA_WILSON: generator.reset(new WilsonGenerator()); break;
+	case MazeConfig::MA_GROWING_TREE: generator.reset(new GrowingTreeGenerator()); break;
+	case MazeConfig::MA_BACKTRACKER: generator.reset(new BacktrackerGenerator()); break;
+	case MazeConfig::MA_ELLER: generator.reset(new EllerGenerator()); break;
+	case MazeConfig::MA_PARALLEL: generator.reset(new ParallelGenerator()); break;
+	default:
+		throw std::runtime_error("MazeGenerator::create: [Unexpected algorithm]");
+	}
+
+	generator->setSeed(seed);
+	return generator;
+}
+
+MazeGenerator::MazeGenerator() :
+	width_(0), height_(0), levels_(0), row_offset_(0), level_offset_(0), total_rooms_(0), walls_(nullptr)
+{
+}
+
+void MazeGenerator::generate(WallMatrix & maze_matrix)
+{
+	width_ = maze_matrix.getWidth();
+	height_ = maze_matrix.getHeight();
+	levels_ = maze_matrix.getDepth();
+	row_offset_ = width_;
+	level_offset_ = width_ * height_;
+	total_rooms_ = maze_matrix.getTotalRooms();
+	walls_ = &maze_matrix;
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	stats_.peak_bytes = carve();
+	stats_.elapsed_ms = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+}
+
+size_t MazeGenerator::getNeighbours(uint32_t room, uint32_t * neighbours, uint8_t * dirs) const
+{
+	uint32_t x = room % row_offset_;
+	uint32_t y = (room / row_offset_) % height_;
+	uint32_t z = room / level_offset_;
+
+	size_t count = 0;
+	if (x > 0)
+	{
+		neighbours[count] = room - 1;
+		dirs[count++] = WallMatrix::WALL_LEFT;
+	}
+	if (x < (width_ - 1))
+	{
+		neighbours[count] = room + 1;
+		dirs[count++] = WallMatrix::WALL_RIGHT;
+	}
+	if (y > 0)
+	{
+		neighbours[count] = room - row_offset_;
+		dirs[count++] = WallMatrix::WALL_UP;
+	}
+	if (y < (height_ - 1))
+	{
+		neighbours[count] = room + row_offset_;
+		dirs[count++] = WallMatrix::WALL_DOWN;
+	}
+	if (z > 0)
+	{
+		neighbours[count] = room - level_offset_;
+		dirs[count++] = WallMatrix::WALL_BOTTOM;
+	}
+	if (z < (levels_ - 1))
+	{
+		neighbours[count] = room + level_offset_;
+		dirs[count++] = WallMatrix::WALL_TOP;
+	}
+	return count;
+}
+
+uint32_t MazeGenerator::getAdjacentRoom(uint32_t room, uint8_t dir) const
+{
+	switch (dir)
+	{
+	case WallMatrix::WALL_LEFT: return room - 1;
+	case WallMatrix::WALL_RIGHT: return room + 1;
+	case WallMatrix::WALL_UP: return room - row_offset_;
+	case WallMatrix::WALL_DOWN: return room + row_offset_;
+	case WallMatrix::WALL_BOTTOM: return room - level_offset_;
+	case WallMatrix::WALL_TOP: return room + level_offset_;
+	default:
+		throw std::runtime_error("MazeGenerator::getAdjacentRoom: [Unexpected direction]");
+	}
+}
+
+uint32_t MazeGenerator::findSet(std::vector<uint32_t> & parents, uint32_t set)
+{
+	while (parents[set] != set)
+	{
+		parents[set] = parents[parents[set]];
+		set = parents[set];
+	}
+	return set;
+}
+
+
+size_t PrimGenerator::carve()
+{
+	// Frontier rooms are tracked by linear index and removed by swapping with the last entry, so each step is O(1).
+	// Scratch bitsets mark rooms already on the frontier and rooms already in the maze.
+	std::vector<bool> loaded(total_rooms_, false);
+	std::vector<bool> explored(total_rooms_, false);
+	std::vector<uint32_t> frontier;
+	frontier.reserve(level_offset_);
+	frontier.push_back((width_ / 2) + (row_offset_ * (height_ / 2)) + (level_offset_ * (levels_ / 2)));
+
+	uint32_t neighbours[6];
+	uint8_t dirs[6];
+	uint8_t explored_dirs[6];
+	while (frontier.size() > 0)
+	{
+		// Randomly select next room, remove it from the frontier, and mark it explored.
+		size_t index = random(static_cast<uint32_t>(frontier.size()));
+		uint32_t curr_room = frontier[index];
+		frontier[index] = frontier.back();
+		frontier.pop_back();
+		explored[curr_room] = true;
+
+		// Load adjacent, unexplored rooms for future processing.
+		// Also locally track the directions of adjacent, explored rooms.
+		size_t num_explored = 0;
+		size_t num_neighbours = getNeighbours(curr_room, neighbours, dirs);
+		for (size_t i = 0; i < num_neighbours; ++i)
+		{
+			if (explored[neighbours[i]])
+			{
+				explored_dirs[num_explored++] = dirs[i];
+			}
+			else if (!loaded[neighbours[i]])
+			{
+				loaded[neighbours[i]] = true;
+				frontier.push_back(neighbours[i]);
+			}
+		}
+
+		if (num_explored > 0)
+		{
+			// Randomly select adjacent, explored room to connect.
+			size_t adj_index = random(static_cast<uint32_t>(num_explored));
+			walls_->removeWall(curr_room, explored_dirs[adj_index]);
+		}
+	}
+
+	return (frontier.capacity() * sizeof(uint32_t)) + ((loaded.capacity() + explored.capacity()) / 8);
+}
+
+
+size_t KruskalGenerator::carve()
+{
+	// Enumerate each interior wall once as (room * 3 + axis), where axis 0/1/2 is the wall towards +x/+y/+z.
+	std::vector<uint32_t> walls;
+	walls.reserve(static_cast<size_t>(total_rooms_) * 3);
+	for (uint32_t z = 0, room = 0; z < levels_; ++z)
+	{
+		for (uint32_t y = 0; y < height_; ++y)
+		{
+			for (uint32_t x = 0; x < width_; ++x, ++room)
+			{
+				if (x < (width_ - 1))
+					walls.push_back(room * 3);
+				if (y < (height_ - 1))
+					walls.push_back(room * 3 + 1);
+				if (z < (levels_ - 1))
+					walls.push_back(room * 3 + 2);
+			}
+		}
+	}
+
+	// Fisher-Yates shuffle.
+	for (size_t i = walls.size() - 1; i > 0; --i)
+		std::swap(walls[i], walls[random(static_cast<uint32_t>(i + 1))]);
+
+	// Union-find over rooms with union by rank and path halving.
+	std::vector<uint32_t> parents(total_rooms_);
+	std::vector<uint8_t> ranks(total_rooms_, 0);
+	for (uint32_t i = 0; i < total_rooms_; ++i)
+		parents[i] = i;
+
+	static const uint8_t axis_dirs[3] = { WallMatrix::WALL_RIGHT, WallMatrix::WALL_DOWN, WallMatrix::WALL_TOP };
+	uint32_t remaining = total_rooms_ - 1;
+	for (size_t i = 0; (i < walls.size()) && (remaining > 0); ++i)
+	{
+		uint32_t room = walls[i] / 3;
+		uint8_t dir = axis_dirs[walls[i] % 3];
+		uint32_t adj_room = getAdjacentRoom(room, dir);
+
+		uint32_t set = findSet(parents, room);
+		uint32_t adj_set = findSet(parents, adj_room);
+		if (set == adj_set)
+			continue;
+
+		if (ranks[set] < ranks[adj_set])
+			std::swap(set, adj_set);
+		parents[adj_set] = set;
+		if (ranks[set] == ranks[adj_set])
+			++ranks[set];
+
+		walls_->removeWall(room, dir);
+		--remaining;
+	}
+
+	return (walls.capacity() * sizeof(uint32_t)) + (parents.capacity() * sizeof(uint32_t)) + ranks.capacity();
+}
+
+size_t WilsonGenerator::carve()
+{
+	// Direction taken the last time each room was left during the current walk.
+	// Overwriting it on revisits erases loops implicitly.
+	std::vector<uint8_t> exits(total_rooms_, static_cast<uint8_t>(WallMatrix::WALL_NONE));
+	std::vector<bool> explored(total_rooms_, false);
+
+	explored[random(total_rooms_)] = true;
+
+	uint32_t neighbours[6];
+	uint8_t dirs[6];
+	for (uint32_t start = 0; start < total_rooms_; ++start)
+	{
+		// Random walk until the walk reaches the maze.
+		uint32_t room = start;
+		while (!explored[room])
+		{
+			size_t num_neighbours = getNeighbours(room, neighbours, dirs);
+			size_t index = random(static_cast<uint32_t>(num_neighbours));
+			exits[room] = dirs[index];
+			room = neighbours[index];
+		}
+
+		// Retrace the loop-erased path and add it to the maze.
+		room = start;
+		while (!explored[room])
+		{
+			walls_->removeWall(room, exits[room]);
+			explored[room] = true;
+			room = getAdjacentRoom(room, exits[room]);
+		}
+	}
+
+	return exits.capacity() + (explored.capacity() / 8);
+}
+
+
+size_t GrowingTreeGenerator::carve()
+{
+	std::vector<uint32_t> active;
+	std::vector<bool> explored(total_rooms_, false);
+	uint32_t start = random(total_rooms_);
+	explored[start] = true;
+	active.push_back(start);
+
+	uint32_t neighbours[6];
+	uint8_t dirs[6];
+	while (active.size() > 0)
+	{
+		size_t index = active.size() - 1;
+		if ( (newest_percent_ < 100) && (random(100) >= newest_percent_) )
+			index = random(static_cast<uint32_t>(active.size()));
+		uint32_t curr_room = active[index];
+
+		// Keep only unexplored neighbours.
+		size_t num_unexplored = 0;
+		size_t num_neighbours = getNeighbours(curr_room, neighbours, dirs);
+		for (size_t i = 0; i < num_neighbours; ++i)
+		{
+			if (!explored[neighbours[i]])
+			{
+				neighbours[num_unexplored] = neighbours[i];
+				dirs[num_unexplored++] = dirs[i];
+			}
+		}
+
+		if (num_unexplored == 0)
+		{
+			// Room is exhausted; retire it.
+			active[index] = active.back();
+			active.pop_back();
+			continue;
+		}
+
+		size_t adj_index = random(static_cast<uint32_t>(num_unexplored));
+		walls_->removeWall(curr_room, dirs[adj_index]);
+		explored[neighbours[adj_index]] = true;
+		active.push_back(neighbours[adj_index]);
+	}
+
+	return (active.capacity() * sizeof(uint32_t)) + (explored.capacity() / 8);
+}
+
+
+size_t EllerGenerator::carve()
+{
+	WallMatrix * walls = walls_;
+	uint32_t width = width_;
+	return generateRows(width_, height_, levels_,
+		[walls, width] (uint32_t y, uint32_t z, const uint8_t * row)
+		{
+			uint32_t room = walls->getIndex(0, y, z);
+			for (uint32_t x = 0; x < width; ++x)
+				walls->setWalls(room + x, row[x]);
+		});
+}
+
+size_t EllerGenerator::generateRows(uint32_t width, uint32_t height, uint32_t levels, const row_sink & sink)
+{
+	static const uint8_t ALL_WALLS = WallMatrix::ALL_WALLS;
+	static const uint32_t NO_STAIRWELL = std::numeric_limits<uint32_t>::max();
+
+	// Set identifiers are always below width, so every array is indexed by either column or set.
+	std::vector<uint32_t> sets(width);
+	std::vector<uint32_t> parents(width);
+	std::vector<uint32_t> counts(width);
+	std::vector<uint8_t> flags(width);
+	std::vector<uint8_t> down(width);
+	std::vector<uint8_t> row(width);
+
+	uint32_t stair_below = NO_STAIRWELL;
+	for (uint32_t z = 0; z < levels; ++z)
+	{
+		// Stairwell to the next level, as an index within the level.
+		uint32_t stair_above = (z < (levels - 1) ? random(width * height) : NO_STAIRWELL);
+
+		// Every room in the first row starts in its own set.
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			sets[x] = x;
+			down[x] = 0;
+		}
+
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			bool last_row = (y == (height - 1));
+
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				parents[x] = x;
+				row[x] = ALL_WALLS;
+				if (down[x])
+					row[x] &= ~WallMatrix::WALL_UP;
+			}
+
+			// Randomly join adjacent rooms in different sets; the last row must join all of them.
+			for (uint32_t x = 0; x < (width - 1); ++x)
+			{
+				uint32_t set = findSet(parents, sets[x]);
+				uint32_t adj_set = findSet(parents, sets[x + 1]);
+				if ( (set != adj_set) && (last_row || random(2)) )
+				{
+					parents[adj_set] = set;
+					row[x] &= ~WallMatrix::WALL_RIGHT;
+					row[x + 1] &= ~WallMatrix::WALL_LEFT;
+				}
+			}
+			for (uint32_t x = 0; x < width; ++x)
+				sets[x] = findSet(parents, sets[x]);
+
+			if (!last_row)
+			{
+				// Randomly extend rooms downward, making sure every set continues at least once.
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					counts[sets[x]] = 0;
+					flags[sets[x]] = 0;
+				}
+				for (uint32_t x = 0; x < width; ++x)
+					++counts[sets[x]];
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					uint32_t set = sets[x];
+					bool last_in_set = (--counts[set] == 0);
+					down[x] = ( random(2) || (last_in_set && !flags[set]) );
+					if (down[x])
+					{
+						flags[set] = 1;
+						row[x] &= ~WallMatrix::WALL_DOWN;
+					}
+				}
+
+				// Rooms that did not continue downward leave a fresh singleton set for the next row.
+				for (uint32_t x = 0; x < width; ++x)
+					flags[x] = 0;
+				for (uint32_t x = 0; x < width; ++x)
+					if (down[x])
+						flags[sets[x]] = 1;
+				uint32_t next_free = 0;
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					if (down[x])
+						continue;
+					while (flags[next_free])
+						++next_free;
+					flags[next_free] = 1;
+					sets[x] = next_free;
+				}
+			}
+
+			// Stairwells.
+			uint32_t row_start = width * y;
+			if ( (stair_above != NO_STAIRWELL) && (stair_above >= row_start) && (stair_above < (row_start + width)) )
+				row[stair_above - row_start] &= ~WallMatrix::WALL_TOP;
+			if ( (stair_below != NO_STAIRWELL) && (stair_below >= row_start) && (stair_below < (row_start + width)) )
+				row[stair_below - row_start] &= ~WallMatrix::WALL_BOTTOM;
+
+			sink(y, z, &row[0]);
+		}
+
+		stair_below = stair_above;
+	}
+
+	return (sets.capacity() + parents.capacity() + counts.capacity()) * sizeof(uint32_t) +
+		flags.capacity() + down.capacity() + row.capacity();
+}
+
+
+size_t ParallelGenerator::carve()
+{
+	// One slab per core, but never so many that slabs become too small to be worth a thread.
+	size_t num_slabs = std::max<size_t>(1, boost::thread::hardware_concurrency());
+	num_slabs = std::min<size_t>(num_slabs, std::max<uint32_t>(1, total_rooms_ / MIN_ROOMS_PER_SLAB));
+	num_slabs = std::min<size_t>(num_slabs, height_ * levels_);
+
+	// Cut slabs on level boundaries where possible so that most seams are stairwells, then round each cut down to a
+	// whole word of packed walls so that no two workers ever write the same word.
+	slabs_.resize(num_slabs);
+	uint32_t total_rows = height_ * levels_;
+	for (size_t i = 0; i < num_slabs; ++i)
+	{
+		uint32_t cut;
+		if (levels_ >= num_slabs)
+			cut = static_cast<uint32_t>((levels_ * i) / num_slabs) * level_offset_;
+		else
+			cut = static_cast<uint32_t>((total_rows * i) / num_slabs) * row_offset_;
+
+		slabs_[i].begin = cut & ~static_cast<uint32_t>(63);
+		if (i > 0)
+			slabs_[i - 1].end = slabs_[i].begin;
+		slabs_[i].seed = random_gen_.next64();
+		slabs_[i].peak_bytes = 0;
+	}
+	slabs_.back().end = total_rooms_;
+
+	parents_.reset(new boost::atomic<uint32_t>[total_rooms_]);
+
+	// Each phase runs one worker per slab; joining the workers is the barrier between phases.
+	void (ParallelGenerator::*phases[])(size_t) = { &ParallelGenerator::buildSlab, &ParallelGenerator::joinSlab,
+		&ParallelGenerator::openSlab };
+	for (size_t phase = 0; phase < (sizeof(phases) / sizeof(phases[0])); ++phase)
+	{
+		boost::thread_group workers;
+		for (size_t i = 1; i < num_slabs; ++i)
+			workers.create_thread(boost::bind(phases[phase], this, i));
+		(this->*phases[phase])(0);
+		workers.join_all();
+	}
+
+	size_t peak_bytes = static_cast<size_t>(total_rooms_) * sizeof(uint32_t);
+	for (size_t i = 0; i < num_slabs; ++i)
+		peak_bytes += slabs_[i].peak_bytes;
+
+	parents_.reset();
+	slabs_.clear();
+	return peak_bytes;
+}
+
+void ParallelGenerator::buildSlab(size_t index)
+{
+	Slab & slab = slabs_[index];
+	Random random_gen(slab.seed);
+
+	for (uint32_t room = slab.begin; room < slab.end; ++room)
+		parents_[room].store(room, boost::memory_order_relaxed);
+
+	// Collect the walls on each room's +x/+y/+z sides, which are the ones it stores; walls crossing into the next
+	// slab go straight to the join.
+	std::vector<uint64_t> walls;
+	walls.reserve(static_cast<size_t>(slab.end - slab.begin) * 3);
+	uint32_t x = slab.begin % row_offset_;
+	uint32_t y = (slab.begin / row_offset_) % height_;
+	uint32_t z = slab.begin / level_offset_;
+	for (uint32_t room = slab.begin; room < slab.end; ++room)
+	{
+		uint64_t wall = static_cast<uint64_t>(room) << 8;
+		if (x < (width_ - 1))
+			((room + 1) < slab.end ? walls : slab.join_walls).push_back(wall | WallMatrix::WALL_RIGHT);
+		if (y < (height_ - 1))
+			((room + row_offset_) < slab.end ? walls : slab.join_walls).push_back(wall | WallMatrix::WALL_DOWN);
+		if (z < (levels_ - 1))
+			((room + level_offset_) < slab.end ? walls : slab.join_walls).push_back(wall | WallMatrix::WALL_TOP);
+
+		if (++x == width_)
+		{
+			x = 0;
+			if (++y == height_)
+			{
+				y = 0;
+				++z;
+			}
+		}
+	}
+
+	for (size_t i = walls.size() - 1; i > 0; --i)
+		std::swap(walls[i], walls[random_gen.uniform(static_cast<uint32_t>(i + 1))]);
+
+	// Kruskal's algorithm within the slab, leaving a share of the would-be passages to the join.
+	for (size_t i = 0; i < walls.size(); ++i)
+	{
+		uint32_t room = static_cast<uint32_t>(walls[i] >> 8);
+		uint8_t dir = static_cast<uint8_t>(walls[i]);
+		uint32_t adj_room = getAdjacentRoom(room, dir);
+
+		if (findRoot(room) == findRoot(adj_room))
+			continue;
+
+		if (random_gen.uniform(DEFER_ONE_IN) == 0)
+			slab.join_walls.push_back(walls[i]);
+		else
+		{
+			unite(room, adj_room);
+			walls_->removeWall(room, dir);
+		}
+	}
+
+	for (size_t i = slab.join_walls.size(); i > 1; --i)
+		std::swap(slab.join_walls[i - 1], slab.join_walls[random_gen.uniform(static_cast<uint32_t>(i))]);
+
+	slab.accepted.resize(slabs_.size());
+	slab.peak_bytes = (walls.capacity() + slab.join_walls.capacity()) * sizeof(uint64_t);
+}
+
+void ParallelGenerator::joinSlab(size_t index)
+{
+	Slab & slab = slabs_[index];
+	for (size_t i = 0; i < slab.join_walls.size(); ++i)
+	{
+		uint32_t room = static_cast<uint32_t>(slab.join_walls[i] >> 8);
+		uint8_t dir = static_cast<uint8_t>(slab.join_walls[i]);
+		uint32_t adj_room = getAdjacentRoom(room, dir);
+
+		// Walls are only written by the worker owning the slab that stores them, so hand each one to its owner.
+		if (unite(room, adj_room))
+			slab.accepted[findSlab(room)].push_back(slab.join_walls[i]);
+	}
+
+	std::vector<uint64_t>().swap(slab.join_walls);
+}
+
+void ParallelGenerator::openSlab(size_t index)
+{
+	for (size_t i = 0; i < slabs_.size(); ++i)
+	{
+		const std::vector<uint64_t> & walls = slabs_[i].accepted[index];
+		for (size_t j = 0; j < walls.size(); ++j)
+			walls_->removeWall(static_cast<uint32_t>(walls[j] >> 8), static_cast<uint8_t>(walls[j]));
+	}
+}
+
+size_t ParallelGenerator::findSlab(uint32_t room) const
+{
+	size_t low = 0;
+	size_t high = slabs_.size() - 1;
+	while (low < high)
+	{
+		size_t mid = (low + high + 1) / 2;
+		if (slabs_[mid].begin <= room)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	return low;
+}
+
+uint32_t ParallelGenerator::findRoot(uint32_t room)
+{
+	// Lock-free path halving; a failed update is harmless since every parent is still an ancestor.
+	// Links only ever point towards smaller roots, so relaxed ordering cannot lead to a stale cycle.
+	uint32_t parent = parents_[room].load(boost::memory_order_relaxed);
+	while (parent != room)
+	{
+		uint32_t grandparent = parents_[parent].load(boost::memory_order_relaxed);
+		if (grandparent != parent)
+			parents_[room].compare_exchange_weak(parent, grandparent, boost::memory_order_relaxed);
+		room = grandparent;
+		parent = parents_[room].load(boost::memory_order_relaxed);
+	}
+	return room;
+}
+
+bool ParallelGenerator::unite(uint32_t room, uint32_t adj_room)
+{
+	while (true)
+	{
+		room = findRoot(room);
+		adj_room = findRoot(adj_room);
+		if (room == adj_room)
+			return false;
+
+		// Always link the larger root beneath the smaller, so concurrent links can never form a cycle.
+		if (room < adj_room)
+			std::swap(room, adj_room);
+
+		uint32_t expected = room;
+		if (parents_[room].compare_exchange_strong(expected, adj_room))
+			return true;
+	}
+}
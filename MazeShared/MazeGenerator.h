@@ -0,0 +1,180 @@
+#ifndef MAZE_GENERATOR_H
+#define MAZE_GENERATOR_H
+
+#include <functional>
+#include <memory>
+#include <boost/atomic.hpp>
+#include "GameData.h"
+#include "Random.h"
+#include "WallMatrix.h"
+
+
+struct GenerationStats
+{
+	double elapsed_ms;
+	size_t peak_bytes; // High-water mark of generator scratch memory (excludes the maze matrix itself)
+
+	GenerationStats() :
+		elapsed_ms(0.0), peak_bytes(0)
+	{}
+
+	void print() const
+	{
+		std::cout << "Generation statistics: [" << "Time=" << elapsed_ms << " ms, PeakMemory=" << peak_bytes << " bytes]" << std::endl;
+	}
+};
+
+
+// Base class for maze generation backends.
+// Every backend carves a perfect maze (exactly one path between any two rooms) into a WallMatrix that starts with
+// every wall present.  Any per-room scratch state is kept in the backend's own transient bitsets.
+class MazeGenerator
+{
+public:
+	static std::unique_ptr<MazeGenerator> create(MazeConfig::eAlgorithm algorithm, uint64_t seed);
+
+	// Whether the algorithm always carves the same maze from the same seed and dimensions.
+	static bool isReproducible(MazeConfig::eAlgorithm algorithm) { return (algorithm != MazeConfig::MA_PARALLEL); }
+
+	virtual ~MazeGenerator() {}
+
+	void setSeed(uint64_t seed) { random_gen_.setSeed(seed); }
+
+	void generate(WallMatrix & maze_matrix);
+
+	const GenerationStats & getStats() const { return stats_; }
+
+protected:
+	MazeGenerator();
+
+	// Carve passages through rooms_ and return the peak scratch memory used, in bytes.
+	virtual size_t carve() = 0;
+
+	size_t getNeighbours(uint32_t room, uint32_t * neighbours, uint8_t * dirs) const;
+	uint32_t getAdjacentRoom(uint32_t room, uint8_t dir) const;
+
+	uint32_t random(uint32_t n) { return random_gen_.uniform(n); }
+
+	// Union-find lookup with path halving.
+	static uint32_t findSet(std::vector<uint32_t> & parents, uint32_t set);
+
+	uint32_t width_, height_, levels_;
+	uint32_t row_offset_, level_offset_, total_rooms_;
+	WallMatrix * walls_;
+	Random random_gen_;
+
+private:
+	GenerationStats stats_;
+
+	// Non-copyable.
+	MazeGenerator(const MazeGenerator &);
+	void operator=(const MazeGenerator &);
+};
+
+typedef std::unique_ptr<MazeGenerator> maze_generator_ptr;
+
+
+// Modified Prim's algorithm: grow from the centre room, attaching random frontier rooms to the explored region.
+class PrimGenerator : public MazeGenerator
+{
+protected:
+	virtual size_t carve();
+};
+
+
+// Randomized Kruskal's algorithm: remove walls in random order whenever they separate two disjoint sets.
+class KruskalGenerator : public MazeGenerator
+{
+protected:
+	virtual size_t carve();
+};
+
+
+// Wilson's algorithm: loop-erased random walks produce a uniformly random spanning tree.
+class WilsonGenerator : public MazeGenerator
+{
+protected:
+	virtual size_t carve();
+};
+
+
+// Growing tree algorithm: extend from the newest active room most of the time and from a random one otherwise.
+class GrowingTreeGenerator : public MazeGenerator
+{
+	static const uint32_t DEF_NEWEST_PERCENT = 75;
+
+	uint32_t newest_percent_;
+
+public:
+	explicit GrowingTreeGenerator(uint32_t newest_percent = DEF_NEWEST_PERCENT) :
+		newest_percent_(newest_percent)
+	{}
+
+protected:
+	virtual size_t carve();
+};
+
+
+// Recursive backtracker: a growing tree that always extends the newest room (iterative depth-first search).
+class BacktrackerGenerator : public GrowingTreeGenerator
+{
+public:
+	BacktrackerGenerator() :
+		GrowingTreeGenerator(100)
+	{}
+};
+
+
+// Eller's algorithm: builds each level row by row, keeping only O(width) state, and joins consecutive levels
+// with a single random stairwell (set membership across a whole level is never held, so more would risk loops).
+// Rows can be streamed to any sink, so mazes far larger than memory can be written out without a full matrix.
+class EllerGenerator : public MazeGenerator
+{
+public:
+	// Receives each finished row of rooms (width bytes of wall bits) in Matrix3D order.
+	typedef std::function<void (uint32_t y, uint32_t z, const uint8_t * row)> row_sink;
+
+	// Returns the peak scratch memory used, in bytes.
+	size_t generateRows(uint32_t width, uint32_t height, uint32_t levels, const row_sink & sink);
+
+protected:
+	virtual size_t carve();
+};
+
+
+// Parallel Kruskal's algorithm: the maze is split into slabs of roughly whole levels (or rows), and each worker thread
+// builds a random spanning forest of its own slab, deferring some walls on purpose.
+// Workers then concurrently offer the deferred walls and the seam walls between slabs to a lock-free union-find,
+// which accepts exactly the walls that join two disjoint sets, so the result is still a perfect maze.
+// The join order depends on thread timing, so unlike the other backends the result is not reproducible from the seed.
+class ParallelGenerator : public MazeGenerator
+{
+	static const uint32_t MIN_ROOMS_PER_SLAB = 1 << 16;
+	static const uint32_t DEFER_ONE_IN = 4;
+
+	struct Slab
+	{
+		uint32_t begin, end; // Room range [begin, end)
+		std::vector<uint64_t> join_walls; // Deferred and seam walls, as (room << 8 | dir) with dir towards +x/+y/+z
+		std::vector<std::vector<uint64_t> > accepted; // Walls accepted during the join, bucketed by owning slab
+		uint64_t seed;
+		size_t peak_bytes;
+	};
+
+	std::unique_ptr<boost::atomic<uint32_t>[]> parents_;
+	std::vector<Slab> slabs_;
+
+protected:
+	virtual size_t carve();
+
+private:
+	void buildSlab(size_t index);
+	void joinSlab(size_t index);
+	void openSlab(size_t index);
+
+	size_t findSlab(uint32_t room) const;
+	uint32_t findRoot(uint32_t room);
+	bool unite(uint32_t room, uint32_t adj_room);
+};
+
+#endif // MAZE_GENERATOR_H
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include "MessageChunk.h"
+
+
+message_frames_ptr MessageChunker::split(const GameMessage & msg)
+{
+	std::shared_ptr<game_message_vec> frames = std::make_shared<game_message_vec>();
+	if (!needsChunking(msg))
+	{
+		frames->push_back(msg);
+		return frames;
+	}
+
+	frames->reserve((msg.bodyLength() + CHUNK_DATA_SIZE - 1) / CHUNK_DATA_SIZE);
+	for (size_t offset = 0; offset < msg.bodyLength(); offset += CHUNK_DATA_SIZE)
+	{
+		size_t length = std::min(static_cast<size_t>(CHUNK_DATA_SIZE), msg.bodyLength() - offset);
+
+		frames->push_back(GameMessage(CHUNK_HEADER_SIZE + length, GameMessage::GC_CHUNK_NOTIFY));
+		GameMessage & chunk = frames->back();
+
+		char * header = chunk.body();
+		*(reinterpret_cast<uint16_t *>(header)) = htons(static_cast<uint16_t>(msg.getGameCode()));
+		*(reinterpret_cast<uint32_t *>(header + 2)) = htonl(static_cast<uint32_t>(msg.bodyLength()));
+		*(reinterpret_cast<uint32_t *>(header + 6)) = htonl(static_cast<uint32_t>(offset));
+		memcpy(header + CHUNK_HEADER_SIZE, msg.body() + offset, length);
+	}
+	return frames;
+}
+
+bool MessageAssembler::addChunk(const GameMessage & chunk)
+{
+	if (isComplete())
+		in_progress_ = false;
+
+	if (chunk.bodyLength() < MessageChunker::CHUNK_HEADER_SIZE)
+		return fail("Chunk too short");
+
+	const char * header = chunk.body();
+	GameMessage::eGameCode game_code =
+		static_cast<GameMessage::eGameCode>(ntohs(*(reinterpret_cast<const uint16_t *>(header))));
+	size_t total_length = ntohl(*(reinterpret_cast<const uint32_t *>(header + 2)));
+	size_t offset = ntohl(*(reinterpret_cast<const uint32_t *>(header + 6)));
+	size_t length = chunk.bodyLength() - MessageChunker::CHUNK_HEADER_SIZE;
+
+	if (offset == 0)
+	{
+		if ( (game_code <= GameMessage::GC_NONE) || (game_code >= GameMessage::GC_MAX) ||
+			(game_code == GameMessage::GC_CHUNK_NOTIFY) || (total_length > GameMessage::MAX_PAYLOAD_SIZE) )
+			return fail("Invalid chunked message");
+
+		stream_data_ = GameMessage::createGameData(game_code);
+		if ( stream_data_ && stream_data_->beginStream(total_length) )
+			msg_.allocate(game_code, 0);
+		else
+		{
+			stream_data_ = nullptr;
+			msg_.allocate(game_code, total_length);
+		}
+
+		total_length_ = total_length;
+		received_ = 0;
+		in_progress_ = true;
+	}
+
+	if ( !in_progress_ || (game_code != msg_.getGameCode()) || (total_length != total_length_) ||
+		(offset != received_) || (length > (total_length - offset)) )
+		return fail("Chunk out of sequence");
+
+	const char * data = header + MessageChunker::CHUNK_HEADER_SIZE;
+	received_ += length;
+	if (!stream_data_)
+	{
+		memcpy(msg_.body() + offset, data, length);
+		return true;
+	}
+
+	if (!stream_data_->deserializeStream(data, length))
+		return fail("Stream decode failed");
+
+	if (received_ == total_length_)
+	{
+		if (!stream_data_->endStream())
+			return fail("Stream decode failed");
+		msg_.game_data_ = stream_data_;
+		stream_data_ = nullptr;
+	}
+	return true;
+}
+
+bool MessageAssembler::fail(const char * reason)
+{
+	std::cerr << "ERROR: MessageAssembler::addChunk [" << reason << "]" << std::endl;
+	stream_data_ = nullptr;
+	in_progress_ = false;
+	return false;
+}
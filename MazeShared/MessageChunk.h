@@ -0,0 +1,71 @@
+#ifndef MESSAGE_CHUNK_H
+#define MESSAGE_CHUNK_H
+
+#include <vector>
+#include "GameMessage.h"
+
+
+// Messages with bodies larger than GameMessage::MAX_SIZE travel as a series of GC_CHUNK_NOTIFY frames.
+// Each chunk body is the original game code (2 bytes), the full body length (4 bytes) and the offset of this
+// piece (4 bytes), followed by the piece itself; the chunk that reaches the full length completes the message.
+// A message is split into its frames once (see split), and the read-only frame list can then be queued on any number
+// of sessions; each session sends it a chunk at a time, so the sender can slip other messages in between them.
+typedef std::vector<GameMessage> game_message_vec;
+typedef std::shared_ptr<const game_message_vec> message_frames_ptr;
+
+class MessageChunker
+{
+public:
+	static const size_t CHUNK_HEADER_SIZE = 10;
+	static const size_t CHUNK_DATA_SIZE = 16 * 1024;
+
+	explicit MessageChunker(const message_frames_ptr & frames) :
+		frames_(frames), next_(0)
+	{}
+
+	static bool needsChunking(const GameMessage & msg) { return msg.bodyLength() > GameMessage::MAX_SIZE; }
+
+	// The frames that carry a message: its chunks if it needs chunking, otherwise just the message itself.
+	static message_frames_ptr split(const GameMessage & msg);
+
+	bool isDone() const { return next_ >= frames_->size(); }
+
+	const GameMessage & nextChunk() { return (*frames_)[next_++]; }
+
+private:
+	message_frames_ptr frames_;
+	size_t next_;
+};
+
+typedef std::shared_ptr<MessageChunker> message_chunker_ptr;
+
+
+// Rebuilds a chunked message in a buffer allocated up front from the first chunk.
+// Messages whose data type can decode a stream (see GameData::beginStream) are not buffered at all; each piece is
+// decoded as it arrives, and the finished message carries the decoded data instead of a body.
+class MessageAssembler
+{
+public:
+	MessageAssembler() :
+		total_length_(0), received_(0), in_progress_(false)
+	{}
+
+	// Returns false if the chunk is malformed or out of sequence; the partial message is then discarded.
+	bool addChunk(const GameMessage & chunk);
+
+	bool isComplete() const { return in_progress_ && (received_ == total_length_); }
+
+	// The reassembled message; only valid once isComplete() returns true, and until the next chunk is added.
+	GameMessage & getMessage() { return msg_; }
+
+private:
+	bool fail(const char * reason);
+
+	GameMessage msg_;
+	game_data_ptr stream_data_; // Set while streaming
+	size_t total_length_;
+	size_t received_;
+	bool in_progress_;
+};
+
+#endif // MESSAGE_CHUNK_H
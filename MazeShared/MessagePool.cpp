@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <new>
+#include "MessagePool.h"
+
+
+void intrusive_ptr_add_ref(MessageBuffer * buffer)
+{
+	buffer->refs.fetch_add(1, boost::memory_order_relaxed);
+}
+
+void intrusive_ptr_release(MessageBuffer * buffer)
+{
+	if (buffer->refs.fetch_sub(1, boost::memory_order_release) == 1)
+	{
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		MessagePool::instance().release(buffer);
+	}
+}
+
+
+MessagePool & MessagePool::instance()
+{
+	static MessagePool pool;
+	return pool;
+}
+
+MessagePool::MessagePool() :
+	thread_cache_(&MessagePool::releaseThreadCache)
+{
+}
+
+MessagePool::~MessagePool()
+{
+	// Only the calling thread's cache can be reached; other threads have exited and released theirs by now.
+	thread_cache_.reset();
+
+	for (size_t i = 0; i < NUM_CLASSES; ++i)
+	{
+		for (size_t j = 0; j < free_lists_[i].size(); ++j)
+			destroy(free_lists_[i][j]);
+	}
+}
+
+message_buffer_ptr MessagePool::acquire(size_t size)
+{
+	uint32_t size_class = getSizeClass(size);
+	MessageBuffer * buffer = nullptr;
+
+	if (size_class < NUM_CLASSES)
+	{
+		buffer_vec & cache_list = getThreadCache().free_lists[size_class];
+		if (cache_list.empty())
+			refill(size_class, cache_list);
+		if (!cache_list.empty())
+		{
+			buffer = cache_list.back();
+			cache_list.pop_back();
+		}
+	}
+
+	if (!buffer)
+	{
+		size_t capacity = getCapacity(size);
+		buffer = new (::operator new(sizeof(MessageBuffer) + capacity)) MessageBuffer;
+		buffer->size_class = size_class;
+		buffer->capacity = capacity;
+	}
+
+	buffer->refs.store(0, boost::memory_order_relaxed);
+	return message_buffer_ptr(buffer);
+}
+
+void MessagePool::release(MessageBuffer * buffer)
+{
+	if (buffer->size_class >= NUM_CLASSES)
+	{
+		destroy(buffer);
+		return;
+	}
+
+	// A thread keeps up to two batches, so one that alternates between acquiring and releasing never goes back and
+	// forth to the shared lists.
+	buffer_vec & cache_list = getThreadCache().free_lists[buffer->size_class];
+	cache_list.push_back(buffer);
+	size_t batch = getBatchSize(buffer->size_class);
+	if (cache_list.size() > (2 * batch))
+		spill(buffer->size_class, cache_list, batch);
+}
+
+MessagePool::ThreadCache & MessagePool::getThreadCache()
+{
+	ThreadCache * cache = thread_cache_.get();
+	if (!cache)
+	{
+		cache = new ThreadCache;
+		thread_cache_.reset(cache);
+	}
+	return *cache;
+}
+
+void MessagePool::releaseThreadCache(ThreadCache * cache)
+{
+	for (uint32_t i = 0; i < NUM_CLASSES; ++i)
+		instance().spill(i, cache->free_lists[i], cache->free_lists[i].size());
+	delete cache;
+}
+
+void MessagePool::refill(uint32_t size_class, buffer_vec & cache_list)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	buffer_vec & free_list = free_lists_[size_class];
+	size_t count = std::min(getBatchSize(size_class), free_list.size());
+	cache_list.insert(cache_list.end(), free_list.end() - count, free_list.end());
+	free_list.resize(free_list.size() - count);
+}
+
+void MessagePool::spill(uint32_t size_class, buffer_vec & cache_list, size_t count)
+{
+	// The oldest buffers go, and whatever the shared list has no room for is freed outside the lock.
+	size_t capacity = static_cast<size_t>(1) << (size_class + MIN_CLASS_SHIFT);
+	size_t max_free = MAX_FREE_BYTES_PER_CLASS / capacity;
+	size_t kept = 0;
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		buffer_vec & free_list = free_lists_[size_class];
+		if (free_list.size() < max_free)
+			kept = std::min(count, max_free - free_list.size());
+		free_list.insert(free_list.end(), cache_list.begin(), cache_list.begin() + kept);
+	}
+
+	for (size_t i = kept; i < count; ++i)
+		destroy(cache_list[i]);
+	cache_list.erase(cache_list.begin(), cache_list.begin() + count);
+}
+
+void MessagePool::destroy(MessageBuffer * buffer)
+{
+	buffer->~MessageBuffer();
+	::operator delete(buffer);
+}
+
+size_t MessagePool::getCapacity(size_t size)
+{
+	uint32_t size_class = getSizeClass(size);
+	if (size_class < NUM_CLASSES)
+		return static_cast<size_t>(1) << (size_class + MIN_CLASS_SHIFT);
+	return size;
+}
+
+size_t MessagePool::getBatchSize(uint32_t size_class)
+{
+	return std::max(static_cast<size_t>(MIN_BATCH), BATCH_BYTES >> (size_class + MIN_CLASS_SHIFT));
+}
+
+uint32_t MessagePool::getSizeClass(size_t size)
+{
+	uint32_t size_class = 0;
+	while ( (size_class < NUM_CLASSES) && (size > (static_cast<size_t>(1) << (size_class + MIN_CLASS_SHIFT))) )
+		++size_class;
+	return size_class;
+}
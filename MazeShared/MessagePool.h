@@ -0,0 +1,82 @@
+#ifndef MESSAGE_POOL_H
+#define MESSAGE_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+
+// Reference-counted block holding one serialized message; the bytes follow the block header in the same allocation.
+// Copies of a GameMessage share the block, so a broadcast costs one buffer however many sessions queue it.
+struct MessageBuffer
+{
+	boost::atomic<uint32_t> refs;
+	uint32_t size_class;
+	size_t capacity;
+
+	char * data() { return reinterpret_cast<char *>(this + 1); }
+	const char * data() const { return reinterpret_cast<const char *>(this + 1); }
+};
+
+void intrusive_ptr_add_ref(MessageBuffer * buffer);
+void intrusive_ptr_release(MessageBuffer * buffer);
+
+typedef boost::intrusive_ptr<MessageBuffer> message_buffer_ptr;
+
+
+// Process-wide pool of message buffers in power-of-two size classes.
+// Released buffers go back on a free list for their class (up to a byte cap per class), so steady traffic of
+// similarly sized messages stops allocating.  Requests above the largest class are allocated and freed directly.
+// Each thread keeps its own free lists and only takes the pool's lock to move a batch of buffers to or from the
+// shared lists, so threads that acquire and release at the same time rarely meet.
+class MessagePool
+{
+public:
+	static const size_t MIN_CLASS_SHIFT = 6; // Smallest class is 64 bytes
+	static const size_t NUM_CLASSES = 10; // Largest class is 32 KB
+	static const size_t MAX_FREE_BYTES_PER_CLASS = 256 * 1024;
+	static const size_t BATCH_BYTES = 16 * 1024; // Moved between a thread's lists and the shared ones at a time
+	static const size_t MIN_BATCH = 4;
+
+	static MessagePool & instance();
+
+	message_buffer_ptr acquire(size_t size);
+	void release(MessageBuffer * buffer);
+
+	// Capacity actually reserved for a request of the given size.
+	static size_t getCapacity(size_t size);
+
+private:
+	typedef std::vector<MessageBuffer *> buffer_vec;
+
+	struct ThreadCache
+	{
+		buffer_vec free_lists[NUM_CLASSES];
+	};
+
+	MessagePool();
+	~MessagePool();
+
+	static uint32_t getSizeClass(size_t size);
+	static size_t getBatchSize(uint32_t size_class);
+	static void destroy(MessageBuffer * buffer);
+
+	ThreadCache & getThreadCache();
+	static void releaseThreadCache(ThreadCache * cache); // At thread exit, hand everything back to the shared lists
+	void refill(uint32_t size_class, buffer_vec & cache_list);
+	void spill(uint32_t size_class, buffer_vec & cache_list, size_t count);
+
+	boost::mutex mutex_; // Guards free_lists_
+	buffer_vec free_lists_[NUM_CLASSES];
+	boost::thread_specific_ptr<ThreadCache> thread_cache_;
+
+	// Non-copyable.
+	MessagePool(const MessagePool &);
+	void operator=(const MessagePool &);
+};
+
+#endif // MESSAGE_POOL_H
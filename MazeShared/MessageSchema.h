@@ -0,0 +1,251 @@
+#ifndef MESSAGE_SCHEMA_H
+#define MESSAGE_SCHEMA_H
+
+#include <algorithm>
+#include "GameMessage.h"
+
+
+// Compile-time layouts of the fixed-size messages.
+// A schema names its game code and lists its fields as WireField types, each placed at the end of the one before,
+// so every offset and the body size are worked out by the compiler.  MessageView reads a received body in place and
+// MessageBuilder writes one straight into a pooled message buffer, so these messages never go through a GameData
+// object: no heap allocation, virtual call or cast.  The wire format is the same big-endian layout the GameData
+// classes use, so either side can still decode them with GameMessage::decodeBody.
+
+// Big-endian load and store of one field type.
+template <typename T>
+struct WireType;
+
+template <>
+struct WireType<uint32_t>
+{
+	static const size_t SIZE = 4;
+
+	static uint32_t load(const char * p)
+	{
+		const uint8_t * b = reinterpret_cast<const uint8_t *>(p);
+		return (static_cast<uint32_t>(b[0]) << 24) | (static_cast<uint32_t>(b[1]) << 16) |
+			(static_cast<uint32_t>(b[2]) << 8) | static_cast<uint32_t>(b[3]);
+	}
+
+	static void store(char * p, uint32_t value)
+	{
+		p[0] = static_cast<char>(value >> 24);
+		p[1] = static_cast<char>(value >> 16);
+		p[2] = static_cast<char>(value >> 8);
+		p[3] = static_cast<char>(value);
+	}
+};
+
+template <>
+struct WireType<uint64_t>
+{
+	static const size_t SIZE = 8;
+
+	static uint64_t load(const char * p)
+	{
+		return (static_cast<uint64_t>(WireType<uint32_t>::load(p)) << 32) | WireType<uint32_t>::load(p + 4);
+	}
+
+	static void store(char * p, uint64_t value)
+	{
+		WireType<uint32_t>::store(p, static_cast<uint32_t>(value >> 32));
+		WireType<uint32_t>::store(p + 4, static_cast<uint32_t>(value));
+	}
+};
+
+
+template <typename T, size_t OFFSET>
+struct WireField
+{
+	typedef T value_type;
+
+	static const size_t END = OFFSET + WireType<T>::SIZE;
+
+	static T read(const char * body) { return WireType<T>::load(body + OFFSET); }
+	static void write(char * body, T value) { WireType<T>::store(body + OFFSET, value); }
+};
+
+
+// Schemas.  Messages whose body is not a fixed layout give VARIABLE_SIZE and check their own length.
+static const size_t VARIABLE_SIZE = ~static_cast<size_t>(0);
+
+struct PlayerIdSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_ID_NOTIFY;
+	typedef WireField<uint32_t, 0> PlayerId;
+	static const size_t SIZE = PlayerId::END;
+};
+
+struct GameConfigSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_CREATE_REQ;
+	typedef WireField<uint32_t, 0> Width;
+	typedef WireField<uint32_t, Width::END> Height;
+	typedef WireField<uint32_t, Height::END> Levels;
+	typedef WireField<uint32_t, Levels::END> Algorithm;
+	typedef WireField<uint64_t, Algorithm::END> Seed;
+	static const size_t SIZE = Seed::END;
+};
+
+struct GameSelectSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_SELECT_GAME_REQ;
+	typedef WireField<uint32_t, 0> Selection;
+	typedef WireField<uint32_t, Selection::END> NumPlayers;
+	static const size_t SIZE = NumPlayers::END;
+};
+
+struct SelectRespSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_SELECT_GAME_RESP;
+	typedef WireField<uint32_t, 0> SelectResp;
+	static const size_t SIZE = SelectResp::END;
+};
+
+struct MoveReqSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_MOVE_REQ;
+	typedef WireField<uint32_t, 0> MoveDir;
+	static const size_t SIZE = MoveDir::END;
+};
+
+struct CancelReqSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_CANCEL_REQ;
+	static const size_t SIZE = 0;
+};
+
+struct PlayerSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_UPDATE_NOTIFY;
+	typedef WireField<uint32_t, 0> PlayerId;
+	typedef WireField<uint32_t, PlayerId::END> X;
+	typedef WireField<uint32_t, X::END> Y;
+	typedef WireField<uint32_t, Y::END> Z;
+	static const size_t SIZE = Z::END;
+};
+
+struct WinnerSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_WINNER_NOTIFY;
+	typedef WireField<uint32_t, 0> WinnerId;
+	static const size_t SIZE = WinnerId::END;
+};
+
+struct CapabilitiesSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_CAPABILITIES_NOTIFY;
+	typedef WireField<uint32_t, 0> Flags;
+	static const size_t SIZE = Flags::END;
+};
+
+struct MapReqSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_MAP_REQ;
+	static const size_t SIZE = 0;
+};
+
+struct UpdateFrameSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_UPDATE_FRAME_NOTIFY;
+	static const size_t SIZE = VARIABLE_SIZE; // See UpdateFrame::readEntry
+};
+
+struct PathReqSchema
+{
+	static const GameMessage::eGameCode CODE = GameMessage::GC_PATH_REQ;
+	static const size_t SIZE = VARIABLE_SIZE; // One byte per step; see PathReq
+};
+
+
+// Typed, read-only view over the body of a received message; the message must outlive the view.
+template <typename Schema>
+class MessageView
+{
+	const char * body_;
+
+public:
+	explicit MessageView(const GameMessage & msg) :
+		body_(msg.body())
+	{}
+
+	template <typename Field>
+	typename Field::value_type get() const { return Field::read(body_); }
+};
+
+
+// Writes a message field by field straight into its send buffer.
+template <typename Schema>
+class MessageBuilder
+{
+	GameMessage msg_;
+
+public:
+	MessageBuilder() :
+		msg_(Schema::SIZE, Schema::CODE)
+	{}
+
+	template <typename Field>
+	MessageBuilder & set(typename Field::value_type value)
+	{
+		Field::write(msg_.body(), value);
+		return *this;
+	}
+
+	const GameMessage & getMessage() const { return msg_; }
+};
+
+
+// Table of member function handlers indexed by game code, filled in once for each receiving class.
+// A message is only passed to its handler if its body has the size its schema declares.
+template <typename Handler>
+class MessageDispatcher
+{
+public:
+	typedef void (Handler::*handler_fn)(const GameMessage & msg);
+
+	enum eDispatchResult
+	{
+		DR_HANDLED,
+		DR_NO_HANDLER,
+		DR_BAD_SIZE,
+		DR_MAX
+	};
+
+private:
+	static const size_t TABLE_SIZE = GameMessage::GC_MAX - GameMessage::GC_NONE;
+
+	handler_fn handlers_[TABLE_SIZE];
+	size_t sizes_[TABLE_SIZE];
+
+public:
+	MessageDispatcher()
+	{
+		std::fill(handlers_, handlers_ + TABLE_SIZE, static_cast<handler_fn>(nullptr));
+		std::fill(sizes_, sizes_ + TABLE_SIZE, static_cast<size_t>(0));
+	}
+
+	template <typename Schema>
+	MessageDispatcher & add(handler_fn handler)
+	{
+		handlers_[Schema::CODE - GameMessage::GC_NONE] = handler;
+		sizes_[Schema::CODE - GameMessage::GC_NONE] = Schema::SIZE;
+		return *this;
+	}
+
+	eDispatchResult dispatch(Handler & handler, const GameMessage & msg) const
+	{
+		size_t index = static_cast<size_t>(msg.getGameCode() - GameMessage::GC_NONE);
+		if ( (index >= TABLE_SIZE) || !handlers_[index] )
+			return DR_NO_HANDLER;
+
+		if ( (sizes_[index] != VARIABLE_SIZE) && (msg.bodyLength() != sizes_[index]) )
+			return DR_BAD_SIZE;
+
+		(handler.*handlers_[index])(msg);
+		return DR_HANDLED;
+	}
+};
+
+#endif // MESSAGE_SCHEMA_H
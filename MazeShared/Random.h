@@ -0,0 +1,79 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+
+// Small, fast xoshiro128** pseudo-random generator.
+// Every maze and agent owns its own instance, so nothing is shared between threads, and since uniform() does not
+// depend on library distributions a given seed produces the same sequence on every platform.
+class Random
+{
+	uint32_t state_[4];
+
+public:
+	explicit Random(uint64_t seed = 0)
+	{
+		setSeed(seed);
+	}
+
+	void setSeed(uint64_t seed)
+	{
+		// Expand the seed with splitmix64 so that nearby seeds still give unrelated sequences.
+		for (int i = 0; i < 4; i += 2)
+		{
+			uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			z ^= (z >> 31);
+			state_[i] = static_cast<uint32_t>(z);
+			state_[i + 1] = static_cast<uint32_t>(z >> 32);
+		}
+	}
+
+	uint32_t next()
+	{
+		uint32_t result = rotl(state_[1] * 5, 7) * 9;
+		uint32_t t = state_[1] << 9;
+
+		state_[2] ^= state_[0];
+		state_[3] ^= state_[1];
+		state_[1] ^= state_[2];
+		state_[0] ^= state_[3];
+		state_[2] ^= t;
+		state_[3] = rotl(state_[3], 11);
+
+		return result;
+	}
+
+	uint64_t next64()
+	{
+		uint64_t high = next();
+		return (high << 32) | next();
+	}
+
+	// Unbiased value in [0, n), using Lemire's multiply-shift with rejection.
+	uint32_t uniform(uint32_t n)
+	{
+		uint64_t product = static_cast<uint64_t>(next()) * n;
+		uint32_t low = static_cast<uint32_t>(product);
+		if (low < n)
+		{
+			uint32_t threshold = (0u - n) % n;
+			while (low < threshold)
+			{
+				product = static_cast<uint64_t>(next()) * n;
+				low = static_cast<uint32_t>(product);
+			}
+		}
+		return static_cast<uint32_t>(product >> 32);
+	}
+
+private:
+	static uint32_t rotl(uint32_t value, int bits)
+	{
+		return (value << bits) | (value >> (32 - bits));
+	}
+};
+
+#endif // RANDOM_H
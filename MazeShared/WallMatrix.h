@@ -0,0 +1,178 @@
+#ifndef WALL_MATRIX_H
+#define WALL_MATRIX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "GameStructs.h"
+
+
+// Maze walls packed at 3 bits per room.
+// Each room stores only the walls on its +x, +y and +z sides, one bit plane per axis; the walls on its -x, -y and
+// -z sides belong to the neighbouring room, so every interior wall is stored exactly once.  A set bit is a wall.
+// Outer walls are never removed, so they are always reported as present.
+class WallMatrix
+{
+public:
+	// Wall bits as assembled by getWalls(), matching the Maze::MAZE_* encoding.
+	static const uint8_t WALL_NONE =	0;
+	static const uint8_t WALL_LEFT =	1 << 0;
+	static const uint8_t WALL_RIGHT =	1 << 1;
+	static const uint8_t WALL_UP =		1 << 2;
+	static const uint8_t WALL_DOWN =	1 << 3;
+	static const uint8_t WALL_BOTTOM =	1 << 4;
+	static const uint8_t WALL_TOP =		1 << 5;
+	static const uint8_t ALL_WALLS =	(1 << 6) - 1;
+
+	enum eAxis
+	{
+		WA_X,
+		WA_Y,
+		WA_Z,
+		WA_MAX
+	};
+
+private:
+	uint32_t width_, height_, depth_;
+	uint32_t row_offset_, level_offset_, total_rooms_;
+	std::vector<uint64_t> planes_[WA_MAX];
+
+public:
+	WallMatrix(uint32_t width, uint32_t height, uint32_t depth) :
+		width_(width), height_(height), depth_(depth), row_offset_(width), level_offset_(width * height),
+		total_rooms_(width * height * depth)
+	{
+		for (int axis = 0; axis < WA_MAX; ++axis)
+			planes_[axis].assign((static_cast<size_t>(total_rooms_) + 63) / 64, ~static_cast<uint64_t>(0));
+	}
+
+	uint32_t getWidth() const { return width_; }
+	uint32_t getHeight() const { return height_; }
+	uint32_t getDepth() const { return depth_; }
+	uint32_t getTotalRooms() const { return total_rooms_; }
+
+	uint32_t getIndex(uint32_t x, uint32_t y, uint32_t z) const { return x + (y * row_offset_) + (z * level_offset_); }
+
+	size_t getMemorySize() const { return planes_[WA_X].size() * sizeof(uint64_t) * WA_MAX; }
+
+	// The wall on the +axis side of a room.
+	bool hasWall(uint32_t room, eAxis axis) const
+	{
+		return ((planes_[axis][room >> 6] >> (room & 63)) & 1) != 0;
+	}
+
+	void removeWall(uint32_t room, eAxis axis)
+	{
+		planes_[axis][room >> 6] &= ~(static_cast<uint64_t>(1) << (room & 63));
+	}
+
+	// Remove the wall on the given side of a room (a single WALL_* bit), whichever room stores it.
+	void removeWall(uint32_t room, uint8_t dir)
+	{
+		switch (dir)
+		{
+		case WALL_LEFT: removeWall(room - 1, WA_X); break;
+		case WALL_RIGHT: removeWall(room, WA_X); break;
+		case WALL_UP: removeWall(room - row_offset_, WA_Y); break;
+		case WALL_DOWN: removeWall(room, WA_Y); break;
+		case WALL_BOTTOM: removeWall(room - level_offset_, WA_Z); break;
+		case WALL_TOP: removeWall(room, WA_Z); break;
+		}
+	}
+
+	// Assemble all six walls of a room as WALL_* bits.
+	uint8_t getWalls(uint32_t x, uint32_t y, uint32_t z) const
+	{
+		uint32_t room = getIndex(x, y, z);
+		uint8_t walls = 0;
+		if ( (x == 0) || hasWall(room - 1, WA_X) )
+			walls |= WALL_LEFT;
+		if (hasWall(room, WA_X))
+			walls |= WALL_RIGHT;
+		if ( (y == 0) || hasWall(room - row_offset_, WA_Y) )
+			walls |= WALL_UP;
+		if (hasWall(room, WA_Y))
+			walls |= WALL_DOWN;
+		if ( (z == 0) || hasWall(room - level_offset_, WA_Z) )
+			walls |= WALL_BOTTOM;
+		if (hasWall(room, WA_Z))
+			walls |= WALL_TOP;
+		return walls;
+	}
+
+	uint8_t getWalls(const Vertex3DEx & pos) const { return getWalls(pos.x, pos.y, pos.z); }
+
+	// Store a room from the one-byte-per-room encoding; only its +x, +y and +z walls are taken.
+	void setWalls(uint32_t room, uint8_t walls)
+	{
+		static const uint8_t owned_walls[WA_MAX] = { WALL_RIGHT, WALL_DOWN, WALL_TOP };
+		for (int axis = 0; axis < WA_MAX; ++axis)
+		{
+			uint64_t bit = static_cast<uint64_t>(1) << (room & 63);
+			if (walls & owned_walls[axis])
+				planes_[axis][room >> 6] |= bit;
+			else
+				planes_[axis][room >> 6] &= ~bit;
+		}
+	}
+
+	// Portable layout of the planes for the wire: each axis in turn, one bit per room in index order, packed least
+	// significant bit first into bytes.
+	size_t getSerialSize() const { return ((static_cast<size_t>(total_rooms_) + 7) / 8) * WA_MAX; }
+
+	void serializePlanes(char * out) const
+	{
+		size_t plane_bytes = (static_cast<size_t>(total_rooms_) + 7) / 8;
+		for (int axis = 0; axis < WA_MAX; ++axis)
+		{
+			for (size_t i = 0; i < plane_bytes; ++i)
+				*out++ = static_cast<char>(planes_[axis][i >> 3] >> ((i & 7) * 8));
+		}
+	}
+
+	void deserializePlanes(const char * data)
+	{
+		size_t plane_bytes = (static_cast<size_t>(total_rooms_) + 7) / 8;
+		for (int axis = 0; axis < WA_MAX; ++axis)
+		{
+			std::vector<uint64_t> & plane = planes_[axis];
+			std::fill(plane.begin(), plane.end(), 0);
+			for (size_t i = 0; i < plane_bytes; ++i)
+				plane[i >> 3] |= static_cast<uint64_t>(static_cast<uint8_t>(*data++)) << ((i & 7) * 8);
+		}
+	}
+
+	// 64-bit hash of the wall bits, so a maze regenerated elsewhere from the same seed can be checked against this one.
+	uint64_t getChecksum() const
+	{
+		uint64_t hash = 14695981039346656037ull ^ total_rooms_;
+		size_t last = planes_[WA_X].size() - 1;
+		uint64_t last_mask = ((total_rooms_ & 63) ? ((static_cast<uint64_t>(1) << (total_rooms_ & 63)) - 1) :
+			~static_cast<uint64_t>(0));
+		for (int axis = 0; axis < WA_MAX; ++axis)
+		{
+			for (size_t i = 0; i <= last; ++i)
+			{
+				hash = (hash ^ (i == last ? (planes_[axis][i] & last_mask) : planes_[axis][i])) * 1099511628211ull;
+				hash ^= hash >> 32;
+			}
+		}
+		return hash;
+	}
+
+	size_t countBranches(const Vertex3DEx & pos) const
+	{
+		uint8_t open = static_cast<uint8_t>(~getWalls(pos) & ALL_WALLS);
+		size_t count = 0;
+		for (; open; open &= (open - 1))
+			++count;
+		return count;
+	}
+
+	bool hasStairwell(const Vertex3DEx & pos) const
+	{
+		return ( (getWalls(pos) & (WALL_BOTTOM | WALL_TOP)) != (WALL_BOTTOM | WALL_TOP) );
+	}
+};
+
+#endif // WALL_MATRIX_H
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "WorldRenderer.h"
+
+
+namespace
+{
+	// Corner characters indexed by EDGE_LEFT | EDGE_RIGHT | EDGE_UP | EDGE_DOWN.
+	const uint8_t CORNERS[16] =
+	{
+		186, 205, 205, 205,	// none, L, R, LR
+		186, 188, 200, 202,	// U, LU, RU, LRU
+		186, 187, 201, 203,	// D, LD, RD, LRD
+		186, 185, 204, 206	// UD, LUD, RUD, LRUD
+	};
+
+	// Room centre characters indexed by (stairs down) | (stairs up << 1).
+	const uint8_t STAIRS[4] = { ' ', '\\', '/', 'X' };
+}
+
+
+std::unique_ptr<matrix3d_u8> WorldRenderer::render(const WallMatrix & walls, const Vertex3DEx & goal)
+{
+	std::unique_ptr<matrix3d_u8> world(new matrix3d_u8((walls.getWidth() * 4) + 2, (walls.getHeight() * 2) + 1,
+		walls.getDepth(), ' '));
+	WorldRenderer renderer(walls, *world);
+
+	// Levels are independent, so spread them over threads when they are big enough to be worth it.
+	uint32_t level_cells = world->getWidth() * world->getHeight();
+	size_t num_threads = std::min<size_t>(std::max<size_t>(1, boost::thread::hardware_concurrency()), walls.getDepth());
+	if (level_cells < MIN_CELLS_PER_THREAD)
+		num_threads = 1;
+
+	boost::thread_group threads;
+	for (size_t i = 1; i < num_threads; ++i)
+		threads.create_thread(boost::bind(&WorldRenderer::renderLevels, &renderer, static_cast<uint32_t>(i),
+			static_cast<uint32_t>(num_threads)));
+	renderer.renderLevels(0, static_cast<uint32_t>(num_threads));
+	threads.join_all();
+
+	world->at((goal.x * 4) + 2, (goal.y * 2) + 1, goal.z) = CHAR_GOAL;
+	return world;
+}
+
+void WorldRenderer::renderLevels(uint32_t first, uint32_t step)
+{
+	RowBuffers rows(walls_.getWidth());
+	for (uint32_t z = first; z < walls_.getDepth(); z += step)
+		renderLevel(z, rows);
+}
+
+void WorldRenderer::renderLevel(uint32_t z, RowBuffers & rows)
+{
+	uint32_t width = walls_.getWidth();
+	uint32_t height = walls_.getHeight();
+	uint32_t level_offset = width * height;
+
+	for (uint32_t y = 0; y <= height; ++y)
+	{
+		// Horizontal walls above this row of rooms.
+		uint32_t room = walls_.getIndex(0, y, z);
+		for (uint32_t x = 0; x < width; ++x)
+			rows.horizontal[x + 1] = ( (y == 0) || (y == height) || walls_.hasWall(room + x - width, WallMatrix::WA_Y) );
+
+		// Vertical walls and stairwells of this row of rooms.
+		if (y < height)
+		{
+			rows.vertical[0] = 1;
+			rows.vertical[width] = 1;
+			for (uint32_t x = 1; x < width; ++x)
+				rows.vertical[x] = walls_.hasWall(room + x - 1, WallMatrix::WA_X);
+
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				uint8_t down = ( (z > 0) && !walls_.hasWall(room + x - level_offset, WallMatrix::WA_Z) );
+				uint8_t up = !walls_.hasWall(room + x, WallMatrix::WA_Z);
+				rows.stairs[x] = down | (up << 1);
+			}
+		}
+
+		renderWallRow(world_.ptr(0, y * 2, z), &rows.horizontal[0],
+			(y > 0 ? &rows.prev_vertical[0] : &rows.no_vertical[0]),
+			(y < height ? &rows.vertical[0] : &rows.no_vertical[0]));
+		world_.at((width * 4) + 1, y * 2, z) = (y < height ? '\n' : '\0');
+
+		if (y < height)
+		{
+			uint8_t * row = world_.ptr(0, (y * 2) + 1, z);
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				row[x * 4] = (rows.vertical[x] ? CHAR_VERTICAL : ' ');
+				row[(x * 4) + 2] = STAIRS[rows.stairs[x]];
+			}
+			row[width * 4] = CHAR_VERTICAL;
+			row[(width * 4) + 1] = '\n';
+
+			rows.prev_vertical.swap(rows.vertical);
+		}
+	}
+}
+
+void WorldRenderer::renderWallRow(uint8_t * row, const uint8_t * horizontal, const uint8_t * up,
+	const uint8_t * down) const
+{
+	uint32_t width = walls_.getWidth();
+	for (uint32_t x = 0; x <= width; ++x)
+		row[x * 4] = CORNERS[horizontal[x] | (horizontal[x + 1] << 1) | (up[x] << 2) | (down[x] << 3)];
+
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		uint8_t edge = (horizontal[x + 1] ? CHAR_HORIZONTAL : ' ');
+		row[(x * 4) + 1] = edge;
+		row[(x * 4) + 2] = edge;
+		row[(x * 4) + 3] = edge;
+	}
+}
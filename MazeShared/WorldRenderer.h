@@ -0,0 +1,62 @@
+#ifndef WORLD_RENDERER_H
+#define WORLD_RENDERER_H
+
+#include <memory>
+#include "GameData.h"
+#include "WallMatrix.h"
+
+
+// Renders a maze into the ASCII world matrix shown by clients.
+// Each cell row is built from per-row wall arrays with branch-free table lookups (box-drawing corners come from a
+// 16-entry table indexed by which of the four surrounding edges are present), and levels render on parallel threads.
+class WorldRenderer
+{
+	static const uint32_t MIN_CELLS_PER_THREAD = 1 << 16;
+
+	// Code page 437 box-drawing characters.
+	static const uint8_t CHAR_HORIZONTAL = 205;
+	static const uint8_t CHAR_VERTICAL = 186;
+	static const uint8_t CHAR_GOAL = 234;
+
+	// Corner neighbour mask bits.
+	static const uint8_t EDGE_LEFT = 1 << 0;
+	static const uint8_t EDGE_RIGHT = 1 << 1;
+	static const uint8_t EDGE_UP = 1 << 2;
+	static const uint8_t EDGE_DOWN = 1 << 3;
+
+	// Per-thread wall arrays for the row being rendered.
+	struct RowBuffers
+	{
+		std::vector<uint8_t> horizontal; // Walls above each room, padded with an empty entry at each end
+		std::vector<uint8_t> vertical; // Walls left of each room, plus the outer right wall
+		std::vector<uint8_t> prev_vertical; // Vertical walls of the row above
+		std::vector<uint8_t> no_vertical; // Stands in for the rows beyond the outer edges
+		std::vector<uint8_t> stairs; // STAIRS index of each room
+
+		explicit RowBuffers(uint32_t width) :
+			horizontal(width + 2, 0), vertical(width + 1, 0), prev_vertical(width + 1, 0), no_vertical(width + 1, 0),
+			stairs(width, 0)
+		{}
+	};
+
+	const WallMatrix & walls_;
+	matrix3d_u8 & world_;
+
+public:
+	static std::unique_ptr<matrix3d_u8> render(const WallMatrix & walls, const Vertex3DEx & goal);
+
+private:
+	WorldRenderer(const WallMatrix & walls, matrix3d_u8 & world) :
+		walls_(walls), world_(world)
+	{}
+
+	void renderLevels(uint32_t first, uint32_t step);
+	void renderLevel(uint32_t z, RowBuffers & rows);
+	void renderWallRow(uint8_t * row, const uint8_t * horizontal, const uint8_t * up, const uint8_t * down) const;
+
+	// Non-copyable.
+	WorldRenderer(const WorldRenderer &);
+	void operator=(const WorldRenderer &);
+};
+
+#endif // WORLD_RENDERER_H